@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#ifdef BENCHMARKS_HEADLESS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include "benchmark.h"
+#include "bindless_textures.h"
+
+benchmark::Context::Context() {
+#ifdef BENCHMARKS_HEADLESS
+	auto get_platform_display =
+		reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+	EGLDisplay display = get_platform_display
+							 ? get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr)
+							 : EGL_NO_DISPLAY;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr) || !eglBindAPI(EGL_OPENGL_API)) {
+		std::cerr << "ERROR::BENCHMARK\n" << "no surfaceless EGL display" << std::endl;
+		return;
+	}
+	m_display = display;
+
+	const EGLint attributes[] = {EGL_CONTEXT_MAJOR_VERSION,
+								 4,
+								 EGL_CONTEXT_MINOR_VERSION,
+								 3,
+								 EGL_CONTEXT_OPENGL_PROFILE_MASK,
+								 EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+								 EGL_NONE};
+	EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		std::cerr << "ERROR::BENCHMARK\n" << "failed to create a surfaceless GL 4.3 context" << std::endl;
+		return;
+	}
+	m_context = context;
+	GLADloadproc load = reinterpret_cast<GLADloadproc>(eglGetProcAddress);
+#else
+	if (!glfwInit()) {
+		std::cerr << "ERROR::BENCHMARK\n" << "failed to initialize GLFW" << std::endl;
+		return;
+	}
+
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	m_window = glfwCreateWindow(64, 64, "benchmark", nullptr, nullptr);
+	if (m_window == nullptr) {
+		std::cerr << "ERROR::BENCHMARK\n" << "failed to create a GL 4.3 context" << std::endl;
+		return;
+	}
+	glfwMakeContextCurrent(m_window);
+	GLADloadproc load = reinterpret_cast<GLADloadproc>(glfwGetProcAddress);
+#endif
+
+	if (!gladLoadGLLoader(load)) {
+		std::cerr << "ERROR::BENCHMARK\n" << "failed to initialize GLAD" << std::endl;
+		return;
+	}
+	Bindless_Textures::load(load);
+	m_ready = true;
+}
+
+benchmark::Context::~Context() {
+#ifdef BENCHMARKS_HEADLESS
+	if (m_display != nullptr) {
+		eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (m_context != nullptr) {
+			eglDestroyContext(m_display, m_context);
+		}
+		eglTerminate(m_display);
+	}
+#else
+	if (m_window != nullptr) {
+		glfwDestroyWindow(m_window);
+	}
+	glfwTerminate();
+#endif
+}
+
+std::string benchmark::Context::renderer() const {
+	return reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+}
+
+size_t benchmark::write_sphere_grid(const std::filesystem::path& path, int grid, int segments, bool separate_meshes) {
+	std::filesystem::create_directories(path.parent_path());
+	std::ofstream out(path);
+	int rings = std::max(2, segments / 2);
+	int ring_vertices = segments + 1;
+	size_t triangles = 0;
+	size_t first_vertex = 1;
+
+	for (int row = 0; row < grid; row++) {
+		for (int column = 0; column < grid; column++) {
+			if (separate_meshes || (row == 0 && column == 0)) {
+				out << "o sphere_" << row << "_" << column << "\n";
+			}
+
+			glm::vec3 center((column - (grid - 1) * 0.5f) * 3.0f, 0.0f, (row - (grid - 1) * 0.5f) * 3.0f);
+			for (int ring = 0; ring <= rings; ring++) {
+				float theta = glm::pi<float>() * ring / rings;
+				for (int segment = 0; segment <= segments; segment++) {
+					float phi = glm::two_pi<float>() * segment / segments;
+					glm::vec3 normal(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+					glm::vec3 position = center + normal;
+					out << "v " << position.x << " " << position.y << " " << position.z << "\n";
+					out << "vt " << static_cast<float>(segment) / segments << " " << static_cast<float>(ring) / rings
+						<< "\n";
+					out << "vn " << normal.x << " " << normal.y << " " << normal.z << "\n";
+				}
+			}
+
+			// counter-clockwise seen from outside, the caps are single triangles
+			auto corner = [&](int ring, int segment) {
+				size_t index = first_vertex + static_cast<size_t>(ring * ring_vertices + segment);
+				return std::to_string(index) + "/" + std::to_string(index) + "/" + std::to_string(index);
+			};
+			for (int ring = 0; ring < rings; ring++) {
+				for (int segment = 0; segment < segments; segment++) {
+					std::string a = corner(ring, segment), b = corner(ring, segment + 1);
+					std::string c = corner(ring + 1, segment), d = corner(ring + 1, segment + 1);
+					if (ring != 0) {
+						out << "f " << a << " " << b << " " << c << "\n";
+						triangles++;
+					}
+					if (ring != rings - 1) {
+						out << "f " << b << " " << d << " " << c << "\n";
+						triangles++;
+					}
+				}
+			}
+			first_vertex += static_cast<size_t>((rings + 1) * ring_vertices);
+		}
+	}
+
+	return triangles;
+}
+
+double benchmark::median(std::vector<double> values) {
+	if (values.empty()) {
+		return 0.0;
+	}
+
+	std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+	return values[values.size() / 2];
+}
+
+double benchmark::median_ms(size_t runs, const std::function<void()>& body) {
+	using Clock = std::chrono::steady_clock;
+
+	std::vector<double> times(std::max<size_t>(1, runs));
+	for (double& time : times) {
+		auto start = Clock::now();
+		body();
+		time = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	return median(std::move(times));
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct GLFWwindow;
+
+// What the benchmarks in this directory share. Each one prints its results as plain text, medians over a number of
+// runs, together with the GL renderer they were measured on.
+namespace benchmark {
+
+// A current GL 4.3 core context without a visible window: a hidden GLFW window, or with BENCHMARKS_HEADLESS a
+// surfaceless EGL one, for machines without a display such as a CI runner with Mesa's llvmpipe. There's no default
+// framebuffer in the headless case, so benchmarks that draw render into their own.
+class Context {
+   public:
+	Context();
+	Context(const Context&) = delete;
+	Context& operator=(const Context&) = delete;
+	~Context();
+
+	explicit operator bool() const { return m_ready; }
+	// GL_RENDERER, so results from different drivers can be told apart
+	std::string renderer() const;
+
+   private:
+	bool m_ready = false;
+	GLFWwindow* m_window = nullptr;
+	// EGLDisplay and EGLContext, which keeps EGL out of this header
+	void* m_display = nullptr;
+	void* m_context = nullptr;
+};
+
+// Writes `grid` x `grid` UV spheres of radius 1, 3 units apart on the XZ plane around the origin, as an OBJ file: a
+// generated stand-in for a large asset. Each sphere is its own object (and so its own mesh) with `separate_meshes`,
+// otherwise they all make up a single one. Returns the number of triangles.
+size_t write_sphere_grid(const std::filesystem::path& path, int grid, int segments, bool separate_meshes);
+
+double median(std::vector<double> values);
+// runs `body` `runs` times and returns the median wall time in milliseconds; GL work has to finish inside `body`
+double median_ms(size_t runs, const std::function<void()>& body);
+
+}
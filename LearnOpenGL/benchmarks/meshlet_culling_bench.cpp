@@ -0,0 +1,211 @@
+// Triangles submitted against triangles visible for a large single-mesh model, from a handful of fixed views. Mesh
+// culling alone submits the whole mesh whenever any of it is in view; meshlet culling only submits the clusters that
+// pass the frustum and normal cone tests, on the CPU in Model::draw or on the GPU through Gpu_Meshlet_Culler. Visible
+// means front-facing and not entirely outside the frustum, counted per triangle on the CPU. Back faces are culled
+// for every path, as the cone test needs, and every view is drawn at LOD 0.
+//
+//     meshlet_culling_bench [grid] [segments] [runs]
+//
+// The model is generated under CACHE_PATH: `grid` x `grid` spheres of `segments` segments merged into one mesh,
+// 16 x 16 spheres of 64 segments (about a million triangles) by default, timed over 5 runs.
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "benchmark.h"
+#include "camera.h"
+#include "config.h"
+#include "frame_stats.h"
+#include "fs_util.h"
+#include "gpu_meshlet_culler.h"
+#include "model.h"
+#include "shader_program.h"
+
+static constexpr const char* VERTEX_SHADER = R"(#version 430 core
+layout (location = 0) in vec3 aPos;
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+void main() {
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
+)";
+
+static constexpr const char* FRAGMENT_SHADER = R"(#version 430 core
+out vec4 FragColor;
+void main() {
+    FragColor = vec4(1.0);
+}
+)";
+
+struct View_Case {
+	const char* name;
+	glm::vec3 position;
+	glm::vec3 target;
+};
+
+// front-facing triangles of LOD 0 that aren't entirely outside one of the frustum planes
+static size_t count_visible(const Model& model, const Render_View& view) {
+	size_t visible = 0;
+	for (size_t i = 0; i < model.meshes.size(); i++) {
+		const Mesh& mesh = model.meshes[i];
+		glm::mat4 world = model.scene_graph.world(model.mesh_nodes[i]);
+		const Mesh_Lod& lod = mesh.lod(0);
+		for (size_t index = lod.first_index; index < lod.first_index + lod.index_count; index += 3) {
+			glm::vec3 corners[3];
+			for (size_t corner = 0; corner < 3; corner++) {
+				const glm::vec3& position = mesh.vertices[mesh.indices[index + corner]].position;
+				corners[corner] = glm::vec3(world * glm::vec4(position, 1.0f));
+			}
+
+			glm::vec3 normal = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+			if (glm::dot(normal, view.position - corners[0]) <= 0.0f) {
+				continue;
+			}
+			bool outside = false;
+			for (const glm::vec4& plane : view.frustum.planes) {
+				outside = outside || (glm::dot(glm::vec3(plane), corners[0]) + plane.w < 0.0f &&
+									  glm::dot(glm::vec3(plane), corners[1]) + plane.w < 0.0f &&
+									  glm::dot(glm::vec3(plane), corners[2]) + plane.w < 0.0f);
+			}
+			visible += outside ? 0 : 1;
+		}
+	}
+
+	return visible;
+}
+
+int main(int argc, char** argv) {
+	using Clock = std::chrono::steady_clock;
+	auto elapsed_ms = [](Clock::time_point since) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+	};
+
+	int grid = argc > 1 ? std::atoi(argv[1]) : 16;
+	int segments = argc > 2 ? std::atoi(argv[2]) : 64;
+	size_t runs = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 5;
+
+	benchmark::Context context;
+	if (!context) {
+		return EXIT_FAILURE;
+	}
+
+	std::filesystem::path path = constants::CACHE_PATH / "benchmarks" /
+								 ("sphere_grid_" + std::to_string(grid) + "_" + std::to_string(segments) + ".obj");
+	if (!std::filesystem::exists(path)) {
+		benchmark::write_sphere_grid(path, grid, segments, false);
+	}
+
+	// the second load comes from the mesh cache the first one wrote
+	auto load_start = Clock::now();
+	Model meshlet_model(path, {.residency = Residency::keep, .meshlet_culling = true});
+	double load_ms = elapsed_ms(load_start);
+	Model mesh_model(path, {.meshlet_culling = false});
+
+	size_t total = 0;
+	size_t meshlets = 0;
+	for (const Mesh& mesh : meshlet_model.meshes) {
+		total += mesh.lod(0).index_count / 3;
+		meshlets += mesh.meshlets().size();
+	}
+
+	Shader_Program shader(VERTEX_SHADER, FRAGMENT_SHADER);
+	Shader_Program indirect_shader(fs_util::read_file(constants::SHADER_PATH / "model_indirect.vert"),
+								   fs_util::read_file(constants::SHADER_PATH / "model_indirect.frag"));
+	Shader_Program cull_shader(fs_util::read_file(constants::SHADER_PATH / "meshlet_cull.comp"));
+	Gpu_Meshlet_Culler gpu_culler;
+
+	// there's no default framebuffer without a window
+	GLuint framebuffer, color, depth;
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glGenRenderbuffers(1, &color);
+	glBindRenderbuffer(GL_RENDERBUFFER, color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, constants::WINDOW_WIDTH, constants::WINDOW_HEIGHT);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, constants::WINDOW_WIDTH, constants::WINDOW_HEIGHT);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+	glViewport(0, 0, constants::WINDOW_WIDTH, constants::WINDOW_HEIGHT);
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_CULL_FACE);
+
+	GLuint primitives_query;
+	glGenQueries(1, &primitives_query);
+
+	std::cout << path.filename().string() << ": 1 mesh, " << total << " triangles, " << meshlets
+			  << " meshlets, loaded in " << load_ms << " ms" << std::endl;
+	std::cout << context.renderer() << ", " << constants::WINDOW_WIDTH << "x" << constants::WINDOW_HEIGHT
+			  << ", median of " << runs << " runs" << std::endl;
+	std::cout << std::left << std::setw(18) << "view" << std::right << std::setw(10) << "visible" << std::setw(12)
+			  << "mesh only" << std::setw(12) << "CPU cull" << std::setw(12) << "GPU cull" << std::setw(11)
+			  << "mesh ms" << std::setw(11) << "CPU ms" << std::setw(11) << "GPU ms" << std::endl;
+
+	float extent = grid * 1.5f;
+	const View_Case views[] = {
+		{"overview", glm::vec3(0.0f, extent, extent * 1.5f), glm::vec3(0.0f)},
+		{"from the side", glm::vec3(-extent - 4.0f, 1.5f, 0.0f), glm::vec3(0.0f, 1.5f, 0.0f)},
+		{"inside", glm::vec3(0.0f, 0.5f, 0.0f), glm::vec3(10.0f, 0.5f, 3.0f)},
+		{"close-up", glm::vec3(1.5f, 0.0f, 3.0f), glm::vec3(1.5f, 0.0f, 1.5f)},
+		{"looking away", glm::vec3(0.0f, 5.0f, extent + 10.0f), glm::vec3(0.0f, 5.0f, extent + 40.0f)},
+	};
+	for (const View_Case& view_case : views) {
+		Camera camera(view_case.position, glm::normalize(view_case.target - view_case.position),
+					  glm::vec3(0.0f, 1.0f, 0.0f));
+		Render_View view = camera.calculate_render_view();
+		view.max_error_pixels = 0.0f;
+		glm::mat4 view_matrix = camera.calculate_view_matrix();
+		glm::mat4 projection = camera.calculate_projection_matrix();
+
+		auto draw_with = [&](Model& model, Frame_Stats& stats) {
+			return benchmark::median_ms(runs, [&]() {
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				frame_stats::begin_frame();
+				model.draw(shader, view);
+				glFinish();
+				stats = frame_stats::current();
+			});
+		};
+		shader.use();
+		shader.set_mat4("view", view_matrix);
+		shader.set_mat4("projection", projection);
+		Frame_Stats mesh_stats, meshlet_stats;
+		double mesh_ms = draw_with(mesh_model, mesh_stats);
+		double cpu_ms = draw_with(meshlet_model, meshlet_stats);
+
+		indirect_shader.use();
+		indirect_shader.set_mat4("view", view_matrix);
+		indirect_shader.set_mat4("projection", projection);
+		GLuint gpu_submitted = 0;
+		double gpu_ms = benchmark::median_ms(runs, [&]() {
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glBeginQuery(GL_PRIMITIVES_GENERATED, primitives_query);
+			gpu_culler.draw(meshlet_model, cull_shader, indirect_shader, view);
+			glEndQuery(GL_PRIMITIVES_GENERATED);
+			glFinish();
+			glGetQueryObjectuiv(primitives_query, GL_QUERY_RESULT, &gpu_submitted);
+		});
+
+		std::cout << std::left << std::setw(18) << view_case.name << std::right << std::setw(10)
+				  << count_visible(meshlet_model, view) << std::setw(12) << mesh_stats.triangles << std::setw(12)
+				  << meshlet_stats.triangles << std::setw(12) << gpu_submitted << std::fixed << std::setprecision(1)
+				  << std::setw(11) << mesh_ms << std::setw(11) << cpu_ms << std::setw(11) << gpu_ms
+				  << std::defaultfloat << std::endl;
+	}
+
+	glDeleteQueries(1, &primitives_query);
+	glDeleteRenderbuffers(1, &color);
+	glDeleteRenderbuffers(1, &depth);
+	glDeleteFramebuffers(1, &framebuffer);
+
+	return EXIT_SUCCESS;
+}
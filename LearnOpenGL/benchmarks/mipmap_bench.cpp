@@ -0,0 +1,128 @@
+// Compares mipmap::generate() with glGenerateMipmap on the same image, both building the full chain from level 0.
+// Under a software rasterizer such as llvmpipe glGenerateMipmap runs on the CPU as well, which is where the two
+// compare directly; the CPU levels still have to be uploaded, which is timed on its own.
+//
+//     mipmap_bench [image] [runs]
+//
+// Defaults to the backpack's 4096x4096 ao.jpg and 5 runs.
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "benchmark.h"
+#include "config.h"
+#include "mipmap.h"
+#include "texture.h"
+#include "thread_pool.h"
+
+static GLenum pixel_format(int num_chans) {
+	switch (num_chans) {
+		case 1:
+			return GL_RED;
+		case 2:
+			return GL_RG;
+		case 3:
+			return GL_RGB;
+		default:
+			return GL_RGBA;
+	}
+}
+
+static GLenum internal_format(int num_chans) {
+	switch (num_chans) {
+		case 1:
+			return GL_R8;
+		case 2:
+			return GL_RG8;
+		case 3:
+			return GL_RGB8;
+		default:
+			return GL_RGBA8;
+	}
+}
+
+int main(int argc, char** argv) {
+	using Clock = std::chrono::steady_clock;
+
+	std::filesystem::path path =
+		argc > 1 ? std::filesystem::path(argv[1]) : constants::ASSET_PATH / "models" / "backpack" / "ao.jpg";
+	size_t runs = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 5;
+
+	benchmark::Context context;
+	if (!context) {
+		return EXIT_FAILURE;
+	}
+	Image image = Image::decode(path);
+	if (!image) {
+		return EXIT_FAILURE;
+	}
+
+	GLenum format = pixel_format(image.num_chans);
+	GLenum storage = internal_format(image.num_chans);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	// level 0 is uploaded before the clock starts, only building the rest of the chain is timed
+	std::vector<double> driver_times;
+	for (size_t run = 0; run < runs; run++) {
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, storage, image.width, image.height, 0, format, GL_UNSIGNED_BYTE,
+					 image.pixels.get());
+		glFinish();
+
+		auto start = Clock::now();
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glFinish();
+		driver_times.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+		glDeleteTextures(1, &texture);
+	}
+	double driver_ms = benchmark::median(std::move(driver_times));
+
+	struct Cpu_Case {
+		const char* name;
+		mipmap::Options options;
+	};
+	const Cpu_Case cpu_cases[] = {
+		{"mipmap::generate box, linear", {mipmap::Filter::box, mipmap::Color_Space::linear}},
+		{"mipmap::generate kaiser, linear", {mipmap::Filter::kaiser, mipmap::Color_Space::linear}},
+		{"mipmap::generate kaiser, srgb", {mipmap::Filter::kaiser, mipmap::Color_Space::srgb}},
+	};
+	std::vector<double> cpu_ms;
+	std::vector<mipmap::Level> levels;
+	for (const Cpu_Case& cpu_case : cpu_cases) {
+		cpu_ms.push_back(benchmark::median_ms(runs, [&]() { levels = mipmap::generate(image, cpu_case.options); }));
+	}
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	double upload_ms = benchmark::median_ms(runs, [&]() {
+		for (size_t i = 0; i < levels.size(); i++) {
+			const mipmap::Level& level = levels[i];
+			glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i + 1), storage, level.width, level.height, 0, format,
+						 GL_UNSIGNED_BYTE, level.pixels.data());
+		}
+		glFinish();
+	});
+	glDeleteTextures(1, &texture);
+
+	std::cout << path.filename().string() << " " << image.width << "x" << image.height << ", " << image.num_chans
+			  << " channel(s), " << levels.size() << " levels below level 0" << std::endl;
+	std::cout << context.renderer() << ", " << Thread_Pool::shared().thread_count() + 1 << " threads, median of "
+			  << runs << " runs" << std::endl;
+	std::cout << "  glGenerateMipmap                   " << driver_ms << " ms" << std::endl;
+	for (size_t i = 0; i < cpu_ms.size(); i++) {
+		std::cout << "  " << cpu_cases[i].name << std::string(35 - std::string(cpu_cases[i].name).size(), ' ')
+				  << cpu_ms[i] << " ms" << std::endl;
+	}
+	std::cout << "  upload of the CPU levels           " << upload_ms << " ms" << std::endl;
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,90 @@
+// Load time of a scene with hundreds of meshes, split into the Assimp import alone, the full CPU-side import
+// (Model::import_model: Assimp, then the per-mesh conversion, optimization and LODs on the shared Thread_Pool, then
+// writing the mesh cache) and whole Model loads with and without a mesh cache. The pool has at least one worker, so
+// parallel_for always spreads the meshes over the calling thread plus `workers`; compare 1 worker with the machine's
+// core count. The import's CPU time against its wall time shows how much of it actually ran in parallel.
+//
+//     model_load_bench [grid] [segments] [runs] [workers]
+//
+// The scene is generated under CACHE_PATH: `grid` x `grid` spheres of `segments` segments, each one its own mesh,
+// 20 x 20 spheres of 32 segments by default, timed over 3 runs with the pool's default size.
+
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <assimp/scene.h>
+#include <assimp/Importer.hpp>
+#include <glad/glad.h>
+
+#include "benchmark.h"
+#include "config.h"
+#include "mesh_cache.h"
+#include "model.h"
+#include "thread_pool.h"
+
+int main(int argc, char** argv) {
+	int grid = argc > 1 ? std::atoi(argv[1]) : 20;
+	int segments = argc > 2 ? std::atoi(argv[2]) : 32;
+	size_t runs = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 3;
+	// has to come before anything uses the pool
+	if (argc > 4) {
+		Thread_Pool::set_shared_thread_count(std::strtoul(argv[4], nullptr, 10));
+	}
+
+	benchmark::Context context;
+	if (!context) {
+		return EXIT_FAILURE;
+	}
+
+	std::string name = "sphere_grid_" + std::to_string(grid) + "_" + std::to_string(segments) + "_meshes.obj";
+	std::filesystem::path path = constants::CACHE_PATH / "benchmarks" / name;
+	size_t triangles = benchmark::write_sphere_grid(path, grid, segments, true);
+	std::filesystem::path cache_path = mesh_cache::path_for(path);
+
+	size_t meshes = 0;
+	double assimp_ms = benchmark::median_ms(runs, [&]() {
+		Assimp::Importer importer;
+		const aiScene* scene = importer.ReadFile(path.string(), Model::import_flags());
+		meshes = scene ? scene->mNumMeshes : 0;
+	});
+	if (meshes == 0) {
+		std::cerr << "ERROR::BENCHMARK\n" << "couldn't import " << path << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// process CPU time over wall time is how many threads the import kept busy on average
+	std::vector<double> import_cpu_times;
+	double import_ms = benchmark::median_ms(runs, [&]() {
+		std::filesystem::remove(cache_path);
+		std::clock_t start = std::clock();
+		Model::import_model(path);
+		import_cpu_times.push_back(1000.0 * static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC);
+	});
+	double import_cpu_ms = benchmark::median(std::move(import_cpu_times));
+	double cold_ms = benchmark::median_ms(runs, [&]() {
+		std::filesystem::remove(cache_path);
+		Model model(path);
+		glFinish();
+	});
+	double warm_ms = benchmark::median_ms(runs, [&]() {
+		Model model(path);
+		glFinish();
+	});
+
+	std::cout << path.filename().string() << ": " << meshes << " meshes, " << triangles << " triangles" << std::endl;
+	size_t workers = Thread_Pool::shared().thread_count();
+	std::cout << context.renderer() << ", " << workers << (workers == 1 ? " worker" : " workers") << ", median of "
+			  << runs << " runs" << std::endl;
+	std::cout << "  Assimp import                " << assimp_ms << " ms" << std::endl;
+	std::cout << "  Model::import_model          " << import_ms << " ms (" << import_ms - assimp_ms
+			  << " ms past the Assimp import), " << import_cpu_ms << " ms of CPU time" << std::endl;
+	std::cout << "  Model, no mesh cache         " << cold_ms << " ms" << std::endl;
+	std::cout << "  Model, from the mesh cache   " << warm_ms << " ms" << std::endl;
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,75 @@
+#include <cstring>
+
+#include "bindless_textures.h"
+
+typedef GLuint64(APIENTRYP PFNGLGETTEXTUREHANDLEARBPROC)(GLuint texture);
+typedef void(APIENTRYP PFNGLMAKETEXTUREHANDLERESIDENTARBPROC)(GLuint64 handle);
+typedef void(APIENTRYP PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC)(GLuint64 handle);
+typedef void(APIENTRYP PFNGLUNIFORMHANDLEUI64ARBPROC)(GLint location, GLuint64 value);
+
+static PFNGLGETTEXTUREHANDLEARBPROC s_get_texture_handle = nullptr;
+static PFNGLMAKETEXTUREHANDLERESIDENTARBPROC s_make_resident = nullptr;
+static PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC s_make_non_resident = nullptr;
+static PFNGLUNIFORMHANDLEUI64ARBPROC s_uniform_handle = nullptr;
+static bool s_gpu_shader5 = false;
+
+void Bindless_Textures::load(GLADloadproc loader) {
+	GLint extension_count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+	bool found = false;
+	for (GLint i = 0; i < extension_count; i++) {
+		const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+		found = found || std::strcmp(name, "GL_ARB_bindless_texture") == 0;
+		s_gpu_shader5 = s_gpu_shader5 || std::strcmp(name, "GL_NV_gpu_shader5") == 0;
+	}
+	if (!found) {
+		return;
+	}
+
+	s_get_texture_handle = reinterpret_cast<PFNGLGETTEXTUREHANDLEARBPROC>(loader("glGetTextureHandleARB"));
+	s_make_resident = reinterpret_cast<PFNGLMAKETEXTUREHANDLERESIDENTARBPROC>(loader("glMakeTextureHandleResidentARB"));
+	s_make_non_resident =
+		reinterpret_cast<PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC>(loader("glMakeTextureHandleNonResidentARB"));
+	s_uniform_handle = reinterpret_cast<PFNGLUNIFORMHANDLEUI64ARBPROC>(loader("glUniformHandleui64ARB"));
+}
+
+bool Bindless_Textures::supported() {
+	return s_get_texture_handle && s_make_resident && s_make_non_resident && s_uniform_handle;
+}
+
+bool Bindless_Textures::divergent_handles() {
+	return supported() && s_gpu_shader5;
+}
+
+Bindless_Textures& Bindless_Textures::shared() {
+	static Bindless_Textures textures;
+	return textures;
+}
+
+GLuint64 Bindless_Textures::handle(GLuint texture) {
+	if (!supported() || texture == 0) {
+		return 0;
+	}
+
+	auto [it, inserted] = m_handles.try_emplace(texture, 0);
+	if (inserted) {
+		it->second = s_get_texture_handle(texture);
+		s_make_resident(it->second);
+	}
+
+	return it->second;
+}
+
+void Bindless_Textures::release(GLuint texture) {
+	auto it = m_handles.find(texture);
+	if (it == m_handles.end()) {
+		return;
+	}
+
+	s_make_non_resident(it->second);
+	m_handles.erase(it);
+}
+
+void Bindless_Textures::set_uniform(GLint location, GLuint64 handle) {
+	s_uniform_handle(location, handle);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+
+#include <glad/glad.h>
+
+// Resident ARB_bindless_texture handles, so shaders can sample textures without them being bound to a unit.
+//
+// glad only loads core GL, so the extension's entry points are loaded separately by load(). A handle freezes the
+// texture it was made for: its storage and sampling state can't be respecified from then on, so textures the
+// Texture_Streamer moves GL_TEXTURE_BASE_LEVEL on never get one. Handles are made non-resident before their texture
+// is deleted, see Texture_Registry::delete_evicted(). Where the extension is missing, draws fall back to the
+// texture arrays of a Texture_Atlas, or to binding each mesh's textures.
+//
+// Context thread only.
+class Bindless_Textures {
+   public:
+	// looks for the extension on the current context and loads its entry points through `loader`, call once after
+	// gladLoadGLLoader
+	static void load(GLADloadproc loader);
+	static bool supported();
+	// Whether a shader may sample through a handle that isn't dynamically uniform, such as one fetched per draw of a
+	// multi-draw. ARB_bindless_texture alone leaves that undefined, NV_gpu_shader5 allows it.
+	static bool divergent_handles();
+	static Bindless_Textures& shared();
+
+	// a resident handle for `texture`, made on first use; 0 if bindless textures aren't supported
+	GLuint64 handle(GLuint texture);
+	bool contains(GLuint texture) const { return m_handles.contains(texture); }
+	// makes the handle for `texture` non-resident, ignores textures without one
+	void release(GLuint texture);
+	size_t resident_count() const { return m_handles.size(); }
+
+	// points the sampler uniform at `location` of the current program at `handle` instead of a texture unit; the
+	// shader has to declare it with layout(bindless_sampler)
+	static void set_uniform(GLint location, GLuint64 handle);
+
+   private:
+	std::unordered_map<GLuint, GLuint64> m_handles;
+};
@@ -0,0 +1,473 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <string_view>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_COMPRESSION_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#include "block_compression.h"
+#include "thread_pool.h"
+
+namespace {
+
+// 16 RGBA texels, row major
+struct Block {
+	alignas(16) uint8_t texels[16][4];
+};
+
+struct Rgba_Image {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> texels;
+};
+
+Rgba_Image expand_rgba(const unsigned char* pixels, int width, int height, int num_chans) {
+	Rgba_Image rgba;
+	rgba.width = static_cast<uint32_t>(width);
+	rgba.height = static_cast<uint32_t>(height);
+	rgba.texels.resize(size_t(rgba.width) * rgba.height * 4);
+
+	for (size_t i = 0; i < size_t(rgba.width) * rgba.height; i++) {
+		const unsigned char* texel = pixels + i * num_chans;
+		uint8_t* out = &rgba.texels[i * 4];
+		if (num_chans == 1) {
+			out[0] = out[1] = out[2] = texel[0];
+			out[3] = 255;
+		} else if (num_chans == 2) {
+			// luminance and alpha
+			out[0] = out[1] = out[2] = texel[0];
+			out[3] = texel[1];
+		} else {
+			out[0] = texel[0];
+			out[1] = texel[1];
+			out[2] = texel[2];
+			out[3] = num_chans >= 4 ? texel[3] : 255;
+		}
+	}
+
+	return rgba;
+}
+
+// blocks hanging over the right or bottom edge repeat the edge texels
+void load_block(const Rgba_Image& image, uint32_t block_x, uint32_t block_y, Block& block) {
+	for (uint32_t y = 0; y < 4; y++) {
+		uint32_t source_y = std::min(block_y * 4 + y, image.height - 1);
+		for (uint32_t x = 0; x < 4; x++) {
+			uint32_t source_x = std::min(block_x * 4 + x, image.width - 1);
+			std::memcpy(block.texels[y * 4 + x], &image.texels[(size_t(source_y) * image.width + source_x) * 4], 4);
+		}
+	}
+}
+
+void bounding_box(const Block& block, uint8_t min[4], uint8_t max[4]) {
+#ifdef BLOCK_COMPRESSION_SSE2
+	const __m128i* rows = reinterpret_cast<const __m128i*>(block.texels);
+	__m128i low = _mm_min_epu8(_mm_min_epu8(_mm_load_si128(rows), _mm_load_si128(rows + 1)),
+							   _mm_min_epu8(_mm_load_si128(rows + 2), _mm_load_si128(rows + 3)));
+	__m128i high = _mm_max_epu8(_mm_max_epu8(_mm_load_si128(rows), _mm_load_si128(rows + 1)),
+								_mm_max_epu8(_mm_load_si128(rows + 2), _mm_load_si128(rows + 3)));
+
+	// fold the four texels of each register onto the first one
+	low = _mm_min_epu8(low, _mm_shuffle_epi32(low, _MM_SHUFFLE(1, 0, 3, 2)));
+	low = _mm_min_epu8(low, _mm_shuffle_epi32(low, _MM_SHUFFLE(2, 3, 0, 1)));
+	high = _mm_max_epu8(high, _mm_shuffle_epi32(high, _MM_SHUFFLE(1, 0, 3, 2)));
+	high = _mm_max_epu8(high, _mm_shuffle_epi32(high, _MM_SHUFFLE(2, 3, 0, 1)));
+
+	int32_t low_texel = _mm_cvtsi128_si32(low);
+	int32_t high_texel = _mm_cvtsi128_si32(high);
+	std::memcpy(min, &low_texel, 4);
+	std::memcpy(max, &high_texel, 4);
+#else
+	std::memcpy(min, block.texels[0], 4);
+	std::memcpy(max, block.texels[0], 4);
+	for (int i = 1; i < 16; i++) {
+		for (int c = 0; c < 4; c++) {
+			min[c] = std::min(min[c], block.texels[i][c]);
+			max[c] = std::max(max[c], block.texels[i][c]);
+		}
+	}
+#endif
+}
+
+// Pulls both corners in by a 16th of the range, which lowers the average error because the corners themselves are
+// rarely hit exactly.
+void inset(uint8_t min[4], uint8_t max[4]) {
+	for (int c = 0; c < 4; c++) {
+		int amount = (max[c] - min[c]) >> 4;
+		min[c] = static_cast<uint8_t>(min[c] + amount);
+		max[c] = static_cast<uint8_t>(max[c] - amount);
+	}
+}
+
+// The box diagonal from min to max only fits texels whose channels rise together. Flip red, blue and alpha on
+// whichever axes run against green.
+void orient_diagonal(const Block& block, uint8_t first[4], uint8_t second[4]) {
+	int center[4];
+	for (int c = 0; c < 4; c++) {
+		center[c] = (first[c] + second[c] + 1) / 2;
+	}
+
+	for (int c : {0, 2, 3}) {
+		int covariance = 0;
+		for (int i = 0; i < 16; i++) {
+			covariance += (block.texels[i][c] - center[c]) * (block.texels[i][1] - center[1]);
+		}
+		if (covariance < 0) {
+			std::swap(first[c], second[c]);
+		}
+	}
+}
+
+// For every texel, its position along the line from `from` to `to`, quantized to [0, levels). Channels where the two
+// points match drop out.
+void project(const Block& block, const int from[4], const int to[4], int levels, uint8_t out[16]) {
+	int direction[4];
+	int length_squared = 0;
+	for (int c = 0; c < 4; c++) {
+		direction[c] = to[c] - from[c];
+		length_squared += direction[c] * direction[c];
+	}
+	if (length_squared == 0) {
+		std::memset(out, 0, 16);
+		return;
+	}
+	float scale = float(levels - 1) / float(length_squared);
+
+#ifdef BLOCK_COMPRESSION_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i origin = _mm_set_epi16(static_cast<int16_t>(from[3]), static_cast<int16_t>(from[2]),
+										 static_cast<int16_t>(from[1]), static_cast<int16_t>(from[0]),
+										 static_cast<int16_t>(from[3]), static_cast<int16_t>(from[2]),
+										 static_cast<int16_t>(from[1]), static_cast<int16_t>(from[0]));
+	const __m128i axis = _mm_set_epi16(static_cast<int16_t>(direction[3]), static_cast<int16_t>(direction[2]),
+									   static_cast<int16_t>(direction[1]), static_cast<int16_t>(direction[0]),
+									   static_cast<int16_t>(direction[3]), static_cast<int16_t>(direction[2]),
+									   static_cast<int16_t>(direction[1]), static_cast<int16_t>(direction[0]));
+	const __m128 scale_4 = _mm_set1_ps(scale);
+	const __m128i last_level = _mm_set1_epi16(static_cast<int16_t>(levels - 1));
+
+	for (int i = 0; i < 16; i += 4) {
+		__m128i texels = _mm_load_si128(reinterpret_cast<const __m128i*>(block.texels[i]));
+		// 16-bit offsets from `from`, two texels per register, multiplied with the axis and summed in pairs
+		__m128i low = _mm_madd_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(texels, zero), origin), axis);
+		__m128i high = _mm_madd_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(texels, zero), origin), axis);
+		__m128i even = _mm_castps_si128(
+			_mm_shuffle_ps(_mm_castsi128_ps(low), _mm_castsi128_ps(high), _MM_SHUFFLE(2, 0, 2, 0)));
+		__m128i odd = _mm_castps_si128(
+			_mm_shuffle_ps(_mm_castsi128_ps(low), _mm_castsi128_ps(high), _MM_SHUFFLE(3, 1, 3, 1)));
+		__m128i dots = _mm_add_epi32(even, odd);
+
+		__m128i levels_4 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(dots), scale_4));
+		levels_4 = _mm_packs_epi32(levels_4, levels_4);
+		levels_4 = _mm_min_epi16(_mm_max_epi16(levels_4, zero), last_level);
+		int32_t packed = _mm_cvtsi128_si32(_mm_packus_epi16(levels_4, levels_4));
+		std::memcpy(out + i, &packed, 4);
+	}
+#else
+	for (int i = 0; i < 16; i++) {
+		int dot = 0;
+		for (int c = 0; c < 4; c++) {
+			dot += (block.texels[i][c] - from[c]) * direction[c];
+		}
+		float level = std::nearbyint(float(dot) * scale);
+		out[i] = static_cast<uint8_t>(std::clamp(level, 0.0f, float(levels - 1)));
+	}
+#endif
+}
+
+uint16_t to_565(const uint8_t color[4]) {
+	return static_cast<uint16_t>(((color[0] * 31 + 127) / 255) << 11 | ((color[1] * 63 + 127) / 255) << 5 |
+								 ((color[2] * 31 + 127) / 255));
+}
+
+void from_565(uint16_t packed, int color[4]) {
+	int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+	color[3] = 0;
+}
+
+void store_u16(uint8_t* out, uint16_t value) {
+	out[0] = static_cast<uint8_t>(value);
+	out[1] = static_cast<uint8_t>(value >> 8);
+}
+
+// 8 bytes: two 565 endpoints and 2-bit indices, always in four color mode
+void encode_color(const Block& block, uint8_t* out) {
+	uint8_t min[4], max[4];
+	bounding_box(block, min, max);
+	inset(min, max);
+	orient_diagonal(block, max, min);
+
+	uint16_t color0 = to_565(max);
+	uint16_t color1 = to_565(min);
+	// four color mode needs color0 > color1; equal endpoints only ever use index 0
+	if (color0 < color1) {
+		std::swap(color0, color1);
+	}
+	store_u16(out, color0);
+	store_u16(out + 2, color1);
+
+	uint32_t indices = 0;
+	if (color0 != color1) {
+		int endpoint0[4], endpoint1[4];
+		from_565(color0, endpoint0);
+		from_565(color1, endpoint1);
+
+		uint8_t levels[16];
+		project(block, endpoint1, endpoint0, 4, levels);
+		// level 0 is color1, 3 is color0, the two thirds in between are indices 3 and 2
+		constexpr uint32_t LEVEL_TO_INDEX[4] = {1, 3, 2, 0};
+		for (int i = 0; i < 16; i++) {
+			indices |= LEVEL_TO_INDEX[levels[i]] << (i * 2);
+		}
+	}
+	for (int i = 0; i < 4; i++) {
+		out[4 + i] = static_cast<uint8_t>(indices >> (i * 8));
+	}
+}
+
+// 8 bytes: two 8-bit endpoints and 3-bit indices for one channel, used for BC3 alpha and both BC5 channels
+void encode_channel(const Block& block, int channel, uint8_t* out) {
+	uint8_t min[4], max[4];
+	bounding_box(block, min, max);
+	uint8_t low = min[channel];
+	uint8_t high = max[channel];
+	out[0] = high;
+	out[1] = low;
+
+	uint64_t indices = 0;
+	if (high != low) {
+		int from[4] = {}, to[4] = {};
+		from[channel] = low;
+		to[channel] = high;
+
+		uint8_t levels[16];
+		project(block, from, to, 8, levels);
+		// level 0 is the low endpoint (index 1), 7 the high one (index 0), the six in between count down from 7
+		for (int i = 0; i < 16; i++) {
+			uint64_t index = levels[i] == 7 ? 0 : levels[i] == 0 ? 1 : 8 - levels[i];
+			indices |= index << (i * 3);
+		}
+	}
+	for (int i = 0; i < 6; i++) {
+		out[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+	}
+}
+
+// least significant bit first, the way BC7 fields are laid out
+class Bit_Writer {
+   public:
+	explicit Bit_Writer(uint8_t* out) : m_out(out) { std::memset(out, 0, 16); }
+
+	void write(uint32_t value, int bits) {
+		for (int i = 0; i < bits; i++, m_position++) {
+			m_out[m_position / 8] |= static_cast<uint8_t>(((value >> i) & 1) << (m_position % 8));
+		}
+	}
+
+   private:
+	uint8_t* m_out;
+	int m_position = 0;
+};
+
+// 7-bit RGBA plus a shared low bit, whichever of the two low bits lands closer to `color`
+void quantize_bc7_endpoint(const uint8_t color[4], uint32_t quantized[4], uint32_t& p_bit, int expanded[4]) {
+	int best_error = INT_MAX;
+	for (uint32_t p = 0; p < 2; p++) {
+		int error = 0;
+		uint32_t candidate[4];
+		for (int c = 0; c < 4; c++) {
+			candidate[c] = static_cast<uint32_t>(std::clamp((color[c] - int(p) + 1) >> 1, 0, 127));
+			int value = int(candidate[c] << 1 | p);
+			error += (value - color[c]) * (value - color[c]);
+		}
+		if (error < best_error) {
+			best_error = error;
+			p_bit = p;
+			std::copy(candidate, candidate + 4, quantized);
+		}
+	}
+
+	for (int c = 0; c < 4; c++) {
+		expanded[c] = int(quantized[c] << 1 | p_bit);
+	}
+}
+
+// Mode 6: one subset, RGBA endpoints and 4-bit indices. That is the only mode here; it covers a single gradient per
+// block and needs no partition search.
+void encode_bc7(const Block& block, uint8_t* out) {
+	uint8_t min[4], max[4];
+	bounding_box(block, min, max);
+	inset(min, max);
+	orient_diagonal(block, min, max);
+
+	uint32_t quantized[2][4], p_bits[2];
+	int expanded[2][4];
+	quantize_bc7_endpoint(min, quantized[0], p_bits[0], expanded[0]);
+	quantize_bc7_endpoint(max, quantized[1], p_bits[1], expanded[1]);
+
+	// the weights are close enough to uniform that the projection is used as the index directly
+	uint8_t indices[16];
+	project(block, expanded[0], expanded[1], 16, indices);
+
+	// the first texel's index has an implicit zero top bit, so flip the block if it would need it
+	if (indices[0] >= 8) {
+		std::swap(quantized[0], quantized[1]);
+		std::swap(p_bits[0], p_bits[1]);
+		for (uint8_t& index : indices) {
+			index = static_cast<uint8_t>(15 - index);
+		}
+	}
+
+	Bit_Writer writer(out);
+	writer.write(1 << 6, 7);
+	for (int c = 0; c < 4; c++) {
+		writer.write(quantized[0][c], 7);
+		writer.write(quantized[1][c], 7);
+	}
+	writer.write(p_bits[0], 1);
+	writer.write(p_bits[1], 1);
+	writer.write(indices[0], 3);
+	for (int i = 1; i < 16; i++) {
+		writer.write(indices[i], 4);
+	}
+}
+
+void encode_block(const Block& block, block_compression::Block_Format format, uint8_t* out) {
+	using block_compression::Block_Format;
+	switch (format) {
+		case Block_Format::bc1:
+			encode_color(block, out);
+			break;
+		case Block_Format::bc3:
+			encode_channel(block, 3, out);
+			encode_color(block, out + 8);
+			break;
+		case Block_Format::bc5:
+			encode_channel(block, 0, out);
+			encode_channel(block, 1, out + 8);
+			break;
+		case Block_Format::bc7:
+			encode_bc7(block, out);
+			break;
+	}
+}
+
+}  // namespace
+
+const block_compression::Support& block_compression::query_support() {
+	static const Support support = []() {
+		Support result;
+		result.bptc = GLAD_GL_VERSION_4_2;
+
+		GLint extension_count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+		for (GLint i = 0; i < extension_count; i++) {
+			std::string_view name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+			if (name == "GL_EXT_texture_compression_s3tc") {
+				result.s3tc = true;
+			} else if (name == "GL_ARB_texture_compression_bptc") {
+				result.bptc = true;
+			}
+		}
+
+		return result;
+	}();
+
+	return support;
+}
+
+GLenum block_compression::gl_format(Block_Format format) {
+	switch (format) {
+		case Block_Format::bc1:
+			return COMPRESSED_RGB_S3TC_DXT1;
+		case Block_Format::bc3:
+			return COMPRESSED_RGBA_S3TC_DXT5;
+		case Block_Format::bc5:
+			return GL_COMPRESSED_RG_RGTC2;
+		case Block_Format::bc7:
+			return GL_COMPRESSED_RGBA_BPTC_UNORM;
+	}
+
+	return 0;
+}
+
+size_t block_compression::block_size(Block_Format format) {
+	return format == Block_Format::bc1 ? 8 : 16;
+}
+
+uint32_t block_compression::block_count(uint32_t texels) {
+	return std::max(1u, (texels + 3) / 4);
+}
+
+std::optional<block_compression::Block_Format> block_compression::choose_format(int num_chans, const Support& support) {
+	if (num_chans == 2 || num_chans == 4) {
+		if (support.bptc) {
+			return Block_Format::bc7;
+		} else if (support.s3tc) {
+			return Block_Format::bc3;
+		}
+	} else if (support.s3tc) {
+		return Block_Format::bc1;
+	}
+
+	return std::nullopt;
+}
+
+block_compression::Compressed_Image block_compression::compress(const Image& image,
+																Block_Format format,
+																const mipmap::Options& mip_options) {
+	Compressed_Image result;
+	if (!image) {
+		return result;
+	}
+	result.format = format;
+	result.num_chans = image.num_chans;
+
+	// lay out the whole chain first so the data is allocated once
+	uint32_t width = static_cast<uint32_t>(image.width);
+	uint32_t height = static_cast<uint32_t>(image.height);
+	uint64_t offset = 0;
+	while (true) {
+		uint64_t size = uint64_t(block_count(width)) * block_count(height) * block_size(format);
+		result.levels.push_back({width, height, offset, size});
+		offset += size;
+		if (width == 1 && height == 1) {
+			break;
+		}
+		width = std::max(1u, width / 2);
+		height = std::max(1u, height / 2);
+	}
+	result.data.resize(offset);
+
+	std::vector<mipmap::Level> mips = mipmap::generate(image, mip_options);
+	for (size_t level = 0; level < result.levels.size(); level++) {
+		Rgba_Image level_image;
+		if (level == 0) {
+			level_image = expand_rgba(image.pixels.get(), image.width, image.height, image.num_chans);
+		} else {
+			const mipmap::Level& source = mips[level - 1];
+			level_image = expand_rgba(source.pixels.data(), source.width, source.height, source.num_chans);
+		}
+
+		const Mip_Level& mip = result.levels[level];
+		uint32_t blocks_x = block_count(mip.width);
+		uint8_t* level_data = reinterpret_cast<uint8_t*>(result.data.data() + mip.offset);
+		Thread_Pool::shared().parallel_for(block_count(mip.height), [&](size_t block_y) {
+			Block block;
+			for (uint32_t block_x = 0; block_x < blocks_x; block_x++) {
+				load_block(level_image, block_x, static_cast<uint32_t>(block_y), block);
+				encode_block(block, format, level_data + (block_y * blocks_x + block_x) * block_size(format));
+			}
+		});
+	}
+
+	return result;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "fs_util.h"
+#include "mipmap.h"
+#include "texture.h"
+
+// CPU encoder for the BC block formats, so textures sit in VRAM at 4 or 8 bits per texel instead of 24 or 32.
+//
+// Every format here works on 4x4 texel blocks. The encoder fits endpoints to each block's bounding box and projects
+// the texels onto the line between them. That is fast enough to run at load time, spread over the shared thread
+// pool.
+namespace block_compression {
+
+// EXT_texture_compression_s3tc and EXT_texture_sRGB aren't part of the generated loader
+constexpr GLenum COMPRESSED_RGB_S3TC_DXT1 = 0x83F0;
+constexpr GLenum COMPRESSED_RGBA_S3TC_DXT1 = 0x83F1;
+constexpr GLenum COMPRESSED_RGBA_S3TC_DXT3 = 0x83F2;
+constexpr GLenum COMPRESSED_RGBA_S3TC_DXT5 = 0x83F3;
+constexpr GLenum COMPRESSED_SRGB_S3TC_DXT1 = 0x8C4C;
+constexpr GLenum COMPRESSED_SRGB_ALPHA_S3TC_DXT1 = 0x8C4D;
+constexpr GLenum COMPRESSED_SRGB_ALPHA_S3TC_DXT3 = 0x8C4E;
+constexpr GLenum COMPRESSED_SRGB_ALPHA_S3TC_DXT5 = 0x8C4F;
+
+enum class Block_Format : uint32_t {
+	bc1,  // RGB, 8 bytes per block
+	bc3,  // RGBA with separate alpha, 16 bytes per block
+	bc5,  // two channels, 16 bytes per block
+	bc7,  // RGBA, mode 6 only, 16 bytes per block
+};
+
+// the formats the current context can sample from, the first call has to happen on the context thread
+struct Support {
+	bool s3tc = false;
+	bool bptc = false;
+};
+const Support& query_support();
+
+struct Mip_Level {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint64_t offset = 0;
+	uint64_t size = 0;
+};
+
+// a full mip chain of blocks, level 0 first
+struct Compressed_Image {
+	Block_Format format = Block_Format::bc1;
+	int num_chans = 0;
+	std::vector<Mip_Level> levels;
+	// the level offsets are into `data` for freshly encoded images, and into `file` for ones read from the cache,
+	// which stay mapped (and cheap to copy) for as long as a copy of the image is around
+	std::vector<std::byte> data;
+	std::shared_ptr<const fs_util::Mapped_File> file;
+
+	explicit operator bool() const { return !levels.empty(); }
+	std::span<const std::byte> bytes() const { return file ? file->bytes() : std::span<const std::byte>(data); }
+	std::span<const std::byte> level_data(size_t level) const {
+		return bytes().subspan(levels[level].offset, levels[level].size);
+	}
+	// the size of every level from `first_level` down
+	size_t size(size_t first_level = 0) const {
+		size_t size = 0;
+		for (size_t level = first_level; level < levels.size(); level++) {
+			size += levels[level].size;
+		}
+		return size;
+	}
+};
+
+GLenum gl_format(Block_Format format);
+size_t block_size(Block_Format format);
+uint32_t block_count(uint32_t texels);
+
+// Picks the format for a texture from its channel count. Returns nothing if the context can't sample any suitable
+// format, in which case the texture stays uncompressed.
+std::optional<Block_Format> choose_format(int num_chans, const Support& support);
+
+// builds the mip chain with mipmap::generate() and encodes every level, CPU only
+Compressed_Image compress(const Image& image, Block_Format format, const mipmap::Options& mip_options);
+
+}
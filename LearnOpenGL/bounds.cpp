@@ -0,0 +1,46 @@
+#include <algorithm>
+#include <cmath>
+
+#include "bounds.h"
+
+Bounding_Volume bounds::calculate(std::span<const Vertex> vertices, std::span<const unsigned int> indices) {
+	Bounding_Volume volume;
+	if (vertices.empty()) {
+		return volume;
+	}
+
+	volume.box.min = vertices[0].position;
+	volume.box.max = vertices[0].position;
+	for (const Vertex& vertex : vertices) {
+		volume.box.min = glm::min(volume.box.min, vertex.position);
+		volume.box.max = glm::max(volume.box.max, vertex.position);
+	}
+
+	glm::vec3 center = volume.box.center();
+	float radius_squared = 0.0f;
+	for (const Vertex& vertex : vertices) {
+		glm::vec3 offset = vertex.position - center;
+		radius_squared = std::max(radius_squared, glm::dot(offset, offset));
+	}
+
+	volume.sphere.center = center;
+	volume.sphere.radius = glm::sqrt(radius_squared);
+
+	// both areas are doubled, which cancels out
+	double surface_area = 0.0;
+	double uv_area = 0.0;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		const Vertex& a = vertices[indices[i]];
+		const Vertex& b = vertices[indices[i + 1]];
+		const Vertex& c = vertices[indices[i + 2]];
+		surface_area += glm::length(glm::cross(b.position - a.position, c.position - a.position));
+		glm::vec2 ab = b.tex_coords - a.tex_coords;
+		glm::vec2 ac = c.tex_coords - a.tex_coords;
+		uv_area += std::abs(ab.x * ac.y - ab.y * ac.x);
+	}
+	if (surface_area > 0.0) {
+		volume.uv_density = static_cast<float>(std::sqrt(uv_area / surface_area));
+	}
+
+	return volume;
+}
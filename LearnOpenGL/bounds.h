@@ -0,0 +1,37 @@
+#pragma once
+
+#include <span>
+
+#include <glm/glm.hpp>
+
+#include "vertex_format.h"
+
+struct Aabb {
+	glm::vec3 min = glm::vec3(0.0f);
+	glm::vec3 max = glm::vec3(0.0f);
+
+	glm::vec3 center() const { return (min + max) * 0.5f; }
+	glm::vec3 half_extent() const { return (max - min) * 0.5f; }
+};
+
+struct Bounding_Sphere {
+	glm::vec3 center = glm::vec3(0.0f);
+	float radius = 0.0f;
+};
+
+// object-space bounds of a mesh, the box and sphere are tested together since either one can be the tighter fit
+struct Bounding_Volume {
+	Aabb box;
+	Bounding_Sphere sphere;
+	// texture coordinate units per object-space unit, averaged over the surface; what the texture streamer needs to
+	// turn a distance into a mip level
+	float uv_density = 0.0f;
+};
+
+namespace bounds {
+
+// The sphere is centered on the box and only as large as the farthest vertex, which beats the box's circumsphere. The
+// uv density is the square root of the triangles' total uv area over their total surface area.
+Bounding_Volume calculate(std::span<const Vertex> vertices, std::span<const unsigned int> indices);
+
+}
@@ -15,6 +15,18 @@ glm::mat4 Camera::calculate_projection_matrix() const {
 							0.1f, 100.0f);
 }
 
+Frustum Camera::calculate_frustum() const {
+	return Frustum::from_view_projection(calculate_projection_matrix() * calculate_view_matrix());
+}
+
+Render_View Camera::calculate_render_view(float viewport_height) const {
+	Render_View view;
+	view.frustum = calculate_frustum();
+	view.position = pos;
+	view.projection_scale = viewport_height / (2.0f * glm::tan(glm::radians(m_fov) * 0.5f));
+	return view;
+}
+
 void Camera::move(const glm::vec2& input_direction, float delta_time) {
 	pos += front * input_direction.y * speed * delta_time;
 	glm::vec3 right_direction = glm::normalize(glm::cross(front, up));
@@ -3,6 +3,17 @@
 #include <glm/glm.hpp>
 
 #include "config.h"
+#include "culling.h"
+
+// what culling and LOD selection need from the camera for one frame
+struct Render_View {
+	Frustum frustum;
+	glm::vec3 position = glm::vec3(0.0f);
+	// pixels covered by one world unit at a distance of one, viewport height / (2 tan(fov / 2))
+	float projection_scale = 1.0f;
+	// how far a LOD may deviate from the full mesh on screen, in pixels
+	float max_error_pixels = 1.0f;
+};
 
 class Camera {
    public:
@@ -17,6 +28,13 @@ class Camera {
 
 	glm::mat4 calculate_projection_matrix() const;
 
+	Frustum calculate_frustum() const;
+
+	Render_View calculate_render_view(float viewport_height = constants::WINDOW_HEIGHT) const;
+
+	// vertical, in degrees, as changed by change_zoom()
+	float fov() const { return m_fov; }
+
 	void move(const glm::vec2& input_direction, float delta_time);
 
 	void update_look_direction(float mouse_x, float mouse_y);
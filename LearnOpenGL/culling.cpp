@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <cmath>
+
+#include "culling.h"
+
+Frustum Frustum::from_view_projection(const glm::mat4& view_projection) {
+	// Gribb/Hartmann, the planes are sums and differences of the matrix rows (glm is column major)
+	glm::mat4 rows = glm::transpose(view_projection);
+
+	Frustum frustum;
+	frustum.planes[0] = rows[3] + rows[0];
+	frustum.planes[1] = rows[3] - rows[0];
+	frustum.planes[2] = rows[3] + rows[1];
+	frustum.planes[3] = rows[3] - rows[1];
+	frustum.planes[4] = rows[3] + rows[2];
+	frustum.planes[5] = rows[3] - rows[2];
+
+	for (glm::vec4& plane : frustum.planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	return frustum;
+}
+
+Frustum Frustum::to_object_space(const glm::mat4& transform) const {
+	// a point p is placed at M p, so plane . (M p) = (M^T plane) . p
+	glm::mat4 transposed = glm::transpose(transform);
+
+	Frustum frustum;
+	for (size_t i = 0; i < planes.size(); i++) {
+		glm::vec4 plane = transposed * planes[i];
+		frustum.planes[i] = plane / glm::length(glm::vec3(plane));
+	}
+
+	return frustum;
+}
+
+void Cull_Batch::clear() {
+	m_center_x.clear();
+	m_center_y.clear();
+	m_center_z.clear();
+	m_extent_x.clear();
+	m_extent_y.clear();
+	m_extent_z.clear();
+	m_radius.clear();
+	m_visible.clear();
+}
+
+size_t Cull_Batch::add(const Bounding_Volume& volume, const glm::mat4& transform) {
+	glm::mat3 linear = glm::mat3(transform);
+
+	// Arvo: the world-space half extent is the object-space one through the absolute rotation/scale
+	glm::mat3 absolute = glm::mat3(glm::abs(linear[0]), glm::abs(linear[1]), glm::abs(linear[2]));
+	glm::vec3 box_center = glm::vec3(transform * glm::vec4(volume.box.center(), 1.0f));
+	glm::vec3 extent = absolute * volume.box.half_extent();
+
+	// the sphere is centered on the box, so it only needs its radius scaled by the largest axis
+	float scale = std::max({glm::length(linear[0]), glm::length(linear[1]), glm::length(linear[2])});
+
+	m_center_x.push_back(box_center.x);
+	m_center_y.push_back(box_center.y);
+	m_center_z.push_back(box_center.z);
+	m_extent_x.push_back(extent.x);
+	m_extent_y.push_back(extent.y);
+	m_extent_z.push_back(extent.z);
+	m_radius.push_back(volume.sphere.radius * scale);
+	m_visible.push_back(1);
+
+	return m_radius.size() - 1;
+}
+
+size_t Cull_Batch::cull(const Frustum& frustum) {
+	size_t count = size();
+	std::fill(m_visible.begin(), m_visible.end(), uint8_t(1));
+
+	const float* center_x = m_center_x.data();
+	const float* center_y = m_center_y.data();
+	const float* center_z = m_center_z.data();
+	const float* extent_x = m_extent_x.data();
+	const float* extent_y = m_extent_y.data();
+	const float* extent_z = m_extent_z.data();
+	const float* radius = m_radius.data();
+	uint8_t* visible = m_visible.data();
+
+	// plane-major so the inner loop is branch free over contiguous arrays
+	for (const glm::vec4& plane : frustum.planes) {
+		glm::vec3 absolute_normal = glm::abs(glm::vec3(plane));
+
+		for (size_t i = 0; i < count; i++) {
+			float distance = plane.x * center_x[i] + plane.y * center_y[i] + plane.z * center_z[i] + plane.w;
+			float box_radius =
+				absolute_normal.x * extent_x[i] + absolute_normal.y * extent_y[i] + absolute_normal.z * extent_z[i];
+			// outside either volume means outside, so the tighter of the two decides
+			float reach = std::min(box_radius, radius[i]);
+			visible[i] &= static_cast<uint8_t>(distance >= -reach);
+		}
+	}
+
+	return static_cast<size_t>(std::count(m_visible.begin(), m_visible.end(), uint8_t(1)));
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+
+// the six planes of a view-projection matrix, normals point inwards
+struct Frustum {
+	// left, right, bottom, top, near, far as (normal, distance)
+	std::array<glm::vec4, 6> planes;
+
+	static Frustum from_view_projection(const glm::mat4& view_projection);
+	// the same frustum in the object space of something placed by `transform`
+	Frustum to_object_space(const glm::mat4& transform) const;
+};
+
+// World-space bounds stored as structure of arrays, so the plane tests run over contiguous floats and the compiler
+// can vectorize them. Keeps its storage between frames, refilling it doesn't allocate once it has grown.
+class Cull_Batch {
+   public:
+	void clear();
+	// transforms `volume` into world space, returns the entry's index
+	size_t add(const Bounding_Volume& volume, const glm::mat4& transform);
+
+	// tests every entry against the frustum, returns how many are at least partially inside
+	size_t cull(const Frustum& frustum);
+	bool is_visible(size_t index) const { return m_visible[index] != 0; }
+	glm::vec3 center(size_t index) const { return {m_center_x[index], m_center_y[index], m_center_z[index]}; }
+	float radius(size_t index) const { return m_radius[index]; }
+	size_t size() const { return m_radius.size(); }
+
+   private:
+	// the box is kept as center and half extent, the sphere shares its center
+	std::vector<float> m_center_x;
+	std::vector<float> m_center_y;
+	std::vector<float> m_center_z;
+	std::vector<float> m_extent_x;
+	std::vector<float> m_extent_y;
+	std::vector<float> m_extent_z;
+	std::vector<float> m_radius;
+	std::vector<uint8_t> m_visible;
+};
@@ -0,0 +1,577 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <numbers>
+#include <optional>
+
+#if defined(__F16C__)
+#define ENVIRONMENT_MAP_F16C 1
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ENVIRONMENT_MAP_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#include <stb_image.h>
+
+#include "config.h"
+#include "environment_map.h"
+#include "texture_cache.h"
+#include "texture_container.h"
+#include "thread_pool.h"
+
+namespace {
+
+// destination rows per thread pool task
+constexpr int BAND_ROWS = 16;
+constexpr float PI = std::numbers::pi_v<float>;
+// the largest finite half float
+constexpr float HALF_MAX = 65504.0f;
+
+// An RGBA float texel in one SSE register, so every kernel below is written once for both paths.
+#ifdef ENVIRONMENT_MAP_SSE2
+using Texel = __m128;
+
+Texel texel_zero() {
+	return _mm_setzero_ps();
+}
+Texel texel_load(const float* texel) {
+	return _mm_loadu_ps(texel);
+}
+void texel_store(float* out, Texel texel) {
+	_mm_storeu_ps(out, texel);
+}
+// sum + texel * weight
+Texel texel_madd(Texel sum, Texel texel, float weight) {
+	return _mm_add_ps(sum, _mm_mul_ps(texel, _mm_set1_ps(weight)));
+}
+#else
+struct Texel {
+	float lanes[4];
+};
+
+Texel texel_zero() {
+	return {};
+}
+Texel texel_load(const float* texel) {
+	return {texel[0], texel[1], texel[2], texel[3]};
+}
+void texel_store(float* out, Texel texel) {
+	std::copy(texel.lanes, texel.lanes + 4, out);
+}
+Texel texel_madd(Texel sum, Texel texel, float weight) {
+	for (int c = 0; c < 4; c++) {
+		sum.lanes[c] += texel.lanes[c] * weight;
+	}
+	return sum;
+}
+#endif
+
+// one level of a cube map in RGBA floats, the faces in GL order
+struct Cube_Level {
+	int size = 0;
+	std::vector<float> texels;
+
+	explicit Cube_Level(int size) : size(size), texels(size_t(6) * size * size * 4) {}
+
+	float* texel(int face, int x, int y) { return texels.data() + ((size_t(face) * size + y) * size + x) * 4; }
+	const float* texel(int face, int x, int y) const {
+		return texels.data() + ((size_t(face) * size + y) * size + x) * 4;
+	}
+};
+
+// The direction through (s, t) on `face`, both in -1..1 across the face, not normalized. This is the inverse of the
+// face selection in the GL spec (table 8.19).
+glm::vec3 face_direction(int face, float s, float t) {
+	switch (face) {
+		case 0:
+			return {1.0f, -t, -s};
+		case 1:
+			return {-1.0f, -t, s};
+		case 2:
+			return {s, 1.0f, t};
+		case 3:
+			return {s, -1.0f, -t};
+		case 4:
+			return {s, -t, 1.0f};
+		default:
+			return {-s, -t, -1.0f};
+	}
+}
+
+// the face `direction` points at and where, s and t in 0..1
+struct Face_Coords {
+	int face;
+	float s;
+	float t;
+};
+
+Face_Coords face_coords(glm::vec3 direction) {
+	glm::vec3 magnitude = glm::abs(direction);
+	int face;
+	float major, sc, tc;
+	if (magnitude.x >= magnitude.y && magnitude.x >= magnitude.z) {
+		face = direction.x > 0.0f ? 0 : 1;
+		major = magnitude.x;
+		sc = direction.x > 0.0f ? -direction.z : direction.z;
+		tc = -direction.y;
+	} else if (magnitude.y >= magnitude.z) {
+		face = direction.y > 0.0f ? 2 : 3;
+		major = magnitude.y;
+		sc = direction.x;
+		tc = direction.y > 0.0f ? direction.z : -direction.z;
+	} else {
+		face = direction.z > 0.0f ? 4 : 5;
+		major = magnitude.z;
+		sc = direction.z > 0.0f ? direction.x : -direction.x;
+		tc = -direction.y;
+	}
+
+	return {face, 0.5f * (sc / major + 1.0f), 0.5f * (tc / major + 1.0f)};
+}
+
+// Bilinear within the face `direction` points at, clamped to its edges. Seams between faces are left to
+// GL_TEXTURE_CUBE_MAP_SEAMLESS at draw time; here they only nudge a few samples of a wide lobe.
+Texel sample_cube(const Cube_Level& level, glm::vec3 direction) {
+	Face_Coords coords = face_coords(direction);
+	float x = coords.s * level.size - 0.5f;
+	float y = coords.t * level.size - 0.5f;
+	float x_floor = std::floor(x), y_floor = std::floor(y);
+	float fx = x - x_floor, fy = y - y_floor;
+	int x0 = std::clamp(static_cast<int>(x_floor), 0, level.size - 1);
+	int y0 = std::clamp(static_cast<int>(y_floor), 0, level.size - 1);
+	int x1 = std::min(x0 + 1, level.size - 1);
+	int y1 = std::min(y0 + 1, level.size - 1);
+
+	Texel sum = texel_madd(texel_zero(), texel_load(level.texel(coords.face, x0, y0)), (1.0f - fx) * (1.0f - fy));
+	sum = texel_madd(sum, texel_load(level.texel(coords.face, x1, y0)), fx * (1.0f - fy));
+	sum = texel_madd(sum, texel_load(level.texel(coords.face, x0, y1)), (1.0f - fx) * fy);
+	return texel_madd(sum, texel_load(level.texel(coords.face, x1, y1)), fx * fy);
+}
+
+// bilinear, wrapping around horizontally and clamped at the poles
+Texel sample_panorama(const environment_map::Hdr_Image& panorama, glm::vec3 direction) {
+	float u = 0.5f + std::atan2(direction.z, direction.x) / (2.0f * PI);
+	float v = std::acos(std::clamp(direction.y, -1.0f, 1.0f)) / PI;
+	float x = u * panorama.width - 0.5f;
+	float y = v * panorama.height - 0.5f;
+	float x_floor = std::floor(x), y_floor = std::floor(y);
+	float fx = x - x_floor, fy = y - y_floor;
+	int x0 = (static_cast<int>(x_floor) % panorama.width + panorama.width) % panorama.width;
+	int x1 = (x0 + 1) % panorama.width;
+	int y0 = std::clamp(static_cast<int>(y_floor), 0, panorama.height - 1);
+	int y1 = std::min(y0 + 1, panorama.height - 1);
+
+	auto texel = [&](int tx, int ty) { return panorama.pixels.data() + (size_t(ty) * panorama.width + tx) * 4; };
+	Texel sum = texel_madd(texel_zero(), texel_load(texel(x0, y0)), (1.0f - fx) * (1.0f - fy));
+	sum = texel_madd(sum, texel_load(texel(x1, y0)), fx * (1.0f - fy));
+	sum = texel_madd(sum, texel_load(texel(x0, y1)), (1.0f - fx) * fy);
+	return texel_madd(sum, texel_load(texel(x1, y1)), fx * fy);
+}
+
+// calls body(face, y) for every row of a cube level of `size`, in bands over the shared thread pool
+template <typename F>
+void for_each_row(int size, F&& body) {
+	size_t bands = static_cast<size_t>((size + BAND_ROWS - 1) / BAND_ROWS);
+	Thread_Pool::shared().parallel_for(6 * bands, [&](size_t task) {
+		int face = static_cast<int>(task / bands);
+		int first_row = static_cast<int>(task % bands) * BAND_ROWS;
+		for (int y = first_row; y < std::min(first_row + BAND_ROWS, size); y++) {
+			body(face, y);
+		}
+	});
+}
+
+// Level 0, each texel the average of 2x2 samples of the panorama, which is usually finer than the faces.
+Cube_Level project(const environment_map::Hdr_Image& panorama, int size) {
+	Cube_Level level(size);
+	for_each_row(size, [&](int face, int y) {
+		for (int x = 0; x < size; x++) {
+			Texel sum = texel_zero();
+			for (int sample = 0; sample < 4; sample++) {
+				float s = 2.0f * (x + 0.25f + 0.5f * (sample & 1)) / size - 1.0f;
+				float t = 2.0f * (y + 0.25f + 0.5f * (sample >> 1)) / size - 1.0f;
+				sum = texel_madd(sum, sample_panorama(panorama, glm::normalize(face_direction(face, s, t))), 0.25f);
+			}
+			texel_store(level.texel(face, x, y), sum);
+		}
+	});
+	return level;
+}
+
+// 2x2 average of every face
+Cube_Level downsample(const Cube_Level& source) {
+	Cube_Level level(source.size / 2);
+	for_each_row(level.size, [&](int face, int y) {
+		for (int x = 0; x < level.size; x++) {
+			Texel sum = texel_madd(texel_zero(), texel_load(source.texel(face, 2 * x, 2 * y)), 0.25f);
+			sum = texel_madd(sum, texel_load(source.texel(face, 2 * x + 1, 2 * y)), 0.25f);
+			sum = texel_madd(sum, texel_load(source.texel(face, 2 * x, 2 * y + 1)), 0.25f);
+			sum = texel_madd(sum, texel_load(source.texel(face, 2 * x + 1, 2 * y + 1)), 0.25f);
+			texel_store(level.texel(face, x, y), sum);
+		}
+	});
+	return level;
+}
+
+// the i-th of n points of the Hammersley set, both coordinates in [0, 1)
+glm::vec2 hammersley(uint32_t i, uint32_t n) {
+	uint32_t bits = i;
+	bits = (bits << 16) | (bits >> 16);
+	bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+	bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+	bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+	bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+	return {static_cast<float>(i) / n, static_cast<float>(bits) * 0x1p-32f};
+}
+
+// GGX importance samples around +z for one roughness. With the view along the normal every texel uses the same set,
+// rotated into its own frame. Structure of arrays, padded to a multiple of 4 with zero weights, so SSE transforms four
+// directions at once.
+struct Sample_Set {
+	std::vector<float> x, y, z;
+	// n.l
+	std::vector<float> weight;
+	// the source mip and the blend towards the next one
+	std::vector<int> level;
+	std::vector<float> blend;
+
+	void add(glm::vec3 direction, float sample_weight, int sample_level, float sample_blend) {
+		x.push_back(direction.x);
+		y.push_back(direction.y);
+		z.push_back(direction.z);
+		weight.push_back(sample_weight);
+		level.push_back(sample_level);
+		blend.push_back(sample_blend);
+	}
+	size_t size() const { return weight.size(); }
+};
+
+Sample_Set ggx_samples(float roughness, uint32_t sample_count, int source_size, int source_levels) {
+	Sample_Set samples;
+	float alpha = roughness * roughness;
+	float alpha2 = alpha * alpha;
+	float texel_solid_angle = 4.0f * PI / (6.0f * source_size * source_size);
+	for (uint32_t i = 0; i < sample_count; i++) {
+		glm::vec2 xi = hammersley(i, sample_count);
+		float phi = 2.0f * PI * xi.x;
+		float cos_theta = std::sqrt((1.0f - xi.y) / (1.0f + (alpha2 - 1.0f) * xi.y));
+		float sin_theta = std::sqrt(1.0f - cos_theta * cos_theta);
+		glm::vec3 half_vector(sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta);
+		glm::vec3 light = 2.0f * cos_theta * half_vector - glm::vec3(0.0f, 0.0f, 1.0f);
+		if (light.z <= 0.0f) {
+			continue;
+		}
+
+		// Sample the mip whose texels cover about the solid angle this sample stands for (GPU Gems 3, chapter 20),
+		// one finer than that: pdf = D(h) (n.h) / (4 (v.h)) = D(h) / 4 with v = n.
+		float denominator = cos_theta * cos_theta * (alpha2 - 1.0f) + 1.0f;
+		float pdf = alpha2 / (PI * denominator * denominator) / 4.0f;
+		float sample_solid_angle = 1.0f / (sample_count * pdf);
+		float lod = std::clamp(0.5f * std::log2(sample_solid_angle / texel_solid_angle), 0.0f,
+							   static_cast<float>(source_levels - 1));
+		int level = std::min(static_cast<int>(lod), source_levels - 2);
+		samples.add(light, light.z, std::max(level, 0), source_levels > 1 ? lod - level : 0.0f);
+	}
+
+	while (samples.size() % 4 != 0) {
+		samples.add(glm::vec3(0.0f, 0.0f, 1.0f), 0.0f, 0, 0.0f);
+	}
+	return samples;
+}
+
+// One level of the output, the radiance around each texel's direction weighted by the GGX lobe.
+Cube_Level prefilter(const std::vector<Cube_Level>& source, int size, const Sample_Set& samples) {
+	Cube_Level level(size);
+	for_each_row(size, [&](int face, int y) {
+		alignas(16) float directions[3][4];
+		for (int x = 0; x < size; x++) {
+			glm::vec3 normal = glm::normalize(
+				face_direction(face, 2.0f * (x + 0.5f) / size - 1.0f, 2.0f * (y + 0.5f) / size - 1.0f));
+			glm::vec3 up = std::abs(normal.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+			glm::vec3 tangent = glm::normalize(glm::cross(up, normal));
+			glm::vec3 bitangent = glm::cross(normal, tangent);
+
+			Texel sum = texel_zero();
+			for (size_t k = 0; k < samples.size(); k += 4) {
+				// tangent * x + bitangent * y + normal * z for four samples
+#ifdef ENVIRONMENT_MAP_SSE2
+				__m128 sx = _mm_loadu_ps(&samples.x[k]);
+				__m128 sy = _mm_loadu_ps(&samples.y[k]);
+				__m128 sz = _mm_loadu_ps(&samples.z[k]);
+				for (int axis = 0; axis < 3; axis++) {
+					__m128 value = _mm_add_ps(_mm_mul_ps(sx, _mm_set1_ps(tangent[axis])),
+											  _mm_mul_ps(sy, _mm_set1_ps(bitangent[axis])));
+					value = _mm_add_ps(value, _mm_mul_ps(sz, _mm_set1_ps(normal[axis])));
+					_mm_store_ps(directions[axis], value);
+				}
+#else
+				for (int lane = 0; lane < 4; lane++) {
+					glm::vec3 direction =
+						tangent * samples.x[k + lane] + bitangent * samples.y[k + lane] + normal * samples.z[k + lane];
+					for (int axis = 0; axis < 3; axis++) {
+						directions[axis][lane] = direction[axis];
+					}
+				}
+#endif
+				for (int lane = 0; lane < 4; lane++) {
+					float weight = samples.weight[k + lane];
+					if (weight == 0.0f) {
+						continue;
+					}
+					glm::vec3 direction(directions[0][lane], directions[1][lane], directions[2][lane]);
+					int mip = samples.level[k + lane];
+					float blend = samples.blend[k + lane];
+					sum = texel_madd(sum, sample_cube(source[mip], direction), weight * (1.0f - blend));
+					if (blend > 0.0f) {
+						sum = texel_madd(sum, sample_cube(source[mip + 1], direction), weight * blend);
+					}
+				}
+			}
+
+			// the source's alpha is 1 everywhere, so the sum's alpha is the total weight
+			alignas(16) float result[4];
+			texel_store(result, sum);
+			float total = result[3] > 0.0f ? result[3] : 1.0f;
+			float* out = level.texel(face, x, y);
+			out[0] = result[0] / total;
+			out[1] = result[1] / total;
+			out[2] = result[2] / total;
+			out[3] = 1.0f;
+		}
+	});
+	return level;
+}
+
+// the real spherical harmonics basis up to band 2, in the order of environment_map::Irradiance
+void sh_basis(glm::vec3 n, float basis[9]) {
+	basis[0] = 0.282095f;
+	basis[1] = 0.488603f * n.y;
+	basis[2] = 0.488603f * n.z;
+	basis[3] = 0.488603f * n.x;
+	basis[4] = 1.092548f * n.x * n.y;
+	basis[5] = 1.092548f * n.y * n.z;
+	basis[6] = 0.315392f * (3.0f * n.z * n.z - 1.0f);
+	basis[7] = 1.092548f * n.x * n.z;
+	basis[8] = 0.546274f * (n.x * n.x - n.y * n.y);
+}
+
+// one band's share of the projection
+struct Sh_Sums {
+	Texel coefficients[9];
+};
+
+// Projects the radiance onto the basis, weighting every texel by the solid angle it covers, then convolves it with
+// the clamped cosine (Ramamoorthi and Hanrahan, "An Efficient Representation for Irradiance Environment Maps").
+environment_map::Irradiance project_irradiance(const Cube_Level& level) {
+	int size = level.size;
+	size_t bands = static_cast<size_t>((size + BAND_ROWS - 1) / BAND_ROWS);
+	// summed per band and then in a fixed order, so the result doesn't depend on the thread count
+	std::vector<Sh_Sums> partial_sums(6 * bands);
+	Thread_Pool::shared().parallel_for(6 * bands, [&](size_t task) {
+		int face = static_cast<int>(task / bands);
+		int first_row = static_cast<int>(task % bands) * BAND_ROWS;
+		Sh_Sums sums;
+		std::fill(std::begin(sums.coefficients), std::end(sums.coefficients), texel_zero());
+		for (int y = first_row; y < std::min(first_row + BAND_ROWS, size); y++) {
+			for (int x = 0; x < size; x++) {
+				float s = 2.0f * (x + 0.5f) / size - 1.0f;
+				float t = 2.0f * (y + 0.5f) / size - 1.0f;
+				float distance2 = 1.0f + s * s + t * t;
+				float solid_angle = 4.0f / (size * size * distance2 * std::sqrt(distance2));
+
+				float basis[9];
+				sh_basis(glm::normalize(face_direction(face, s, t)), basis);
+				Texel radiance = texel_load(level.texel(face, x, y));
+				for (int i = 0; i < 9; i++) {
+					sums.coefficients[i] = texel_madd(sums.coefficients[i], radiance, basis[i] * solid_angle);
+				}
+			}
+		}
+		partial_sums[task] = sums;
+	});
+
+	constexpr float BAND_SCALE[9] = {PI,
+									 2.0f * PI / 3.0f,
+									 2.0f * PI / 3.0f,
+									 2.0f * PI / 3.0f,
+									 PI / 4.0f,
+									 PI / 4.0f,
+									 PI / 4.0f,
+									 PI / 4.0f,
+									 PI / 4.0f};
+	environment_map::Irradiance irradiance;
+	for (int i = 0; i < 9; i++) {
+		double total[3] = {};
+		for (const Sh_Sums& sums : partial_sums) {
+			alignas(16) float values[4];
+			texel_store(values, sums.coefficients[i]);
+			for (int c = 0; c < 3; c++) {
+				total[c] += values[c];
+			}
+		}
+		irradiance[i] = glm::vec3(total[0], total[1], total[2]) * BAND_SCALE[i];
+	}
+	return irradiance;
+}
+
+// round to nearest; `value` must be in 0..HALF_MAX
+uint16_t to_half(float value) {
+	uint32_t bits = std::bit_cast<uint32_t>(value);
+	uint32_t exponent = (bits >> 23) & 0xFF;
+	uint32_t mantissa = bits & 0x7FFFFF;
+	// under half the smallest subnormal half
+	if (exponent < 102) {
+		return 0;
+	}
+	if (exponent < 113) {
+		uint32_t shift = 126 - exponent;
+		mantissa |= 0x800000;
+		return static_cast<uint16_t>((mantissa >> shift) + ((mantissa >> (shift - 1)) & 1));
+	}
+	uint32_t half = ((exponent - 112) << 10) | (mantissa >> 13);
+	return static_cast<uint16_t>(half + ((mantissa >> 12) & 1));
+}
+
+// clamped to the half float range, HDR suns easily exceed it
+std::vector<uint16_t> to_half_floats(const Cube_Level& level) {
+	std::vector<uint16_t> halves(level.texels.size());
+	for_each_row(level.size, [&](int face, int y) {
+		size_t first = (size_t(face) * level.size + y) * level.size * 4;
+		for (size_t i = first; i < first + size_t(level.size) * 4; i += 4) {
+#ifdef ENVIRONMENT_MAP_F16C
+			__m128 value =
+				_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&level.texels[i]), _mm_setzero_ps()), _mm_set1_ps(HALF_MAX));
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(&halves[i]), _mm_cvtps_ph(value, _MM_FROUND_TO_NEAREST_INT));
+#else
+			for (size_t c = i; c < i + 4; c++) {
+				halves[c] = to_half(std::clamp(level.texels[c], 0.0f, HALF_MAX));
+			}
+#endif
+		}
+	});
+	return halves;
+}
+
+// straight from memory, when the bake couldn't be cached
+Cubemap upload(const environment_map::Baked& baked) {
+	Cubemap cubemap;
+	glGenTextures(1, &cubemap.id);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap.id);
+	for (size_t level = 0; level < baked.levels.size(); level++) {
+		GLsizei size = static_cast<GLsizei>(std::max(1u, baked.face_size >> level));
+		size_t face_size = size_t(size) * size * 4;
+		for (size_t face = 0; face < 6; face++) {
+			const uint16_t* pixels = baked.levels[level].data() + face * face_size;
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + static_cast<GLenum>(face), static_cast<GLint>(level),
+						 GL_RGBA16F, size, size, 0, GL_RGBA, GL_HALF_FLOAT, pixels);
+		}
+	}
+
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(baked.levels.size() - 1));
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	return cubemap;
+}
+
+}  // namespace
+
+environment_map::Hdr_Image environment_map::Hdr_Image::decode(const std::filesystem::path& image_path) {
+	Hdr_Image image;
+	int num_chans = 0;
+	float* pixels = stbi_loadf(image_path.string().c_str(), &image.width, &image.height, &num_chans, 4);
+	if (!pixels) {
+		std::cerr << "ERROR::ENVIRONMENT_MAP\n" << "failed to load image '" << image_path << "'" << std::endl;
+		return image;
+	}
+
+	image.pixels.assign(pixels, pixels + size_t(image.width) * image.height * 4);
+	stbi_image_free(pixels);
+	return image;
+}
+
+environment_map::Baked environment_map::bake(const Hdr_Image& panorama, const Options& options) {
+	Baked baked;
+	if (!panorama || !std::has_single_bit(options.face_size) || options.face_size < (1u << (LEVELS - 1)) ||
+		options.sample_count == 0) {
+		std::cerr << "ERROR::ENVIRONMENT_MAP\n" << "invalid face size or sample count" << std::endl;
+		return baked;
+	}
+
+	// the projection and its box filtered mips down to 1x1, what the prefiltered levels sample from
+	std::vector<Cube_Level> source;
+	source.push_back(project(panorama, static_cast<int>(options.face_size)));
+	while (source.back().size > 1) {
+		source.push_back(downsample(source.back()));
+	}
+
+	baked.face_size = options.face_size;
+	baked.levels.push_back(to_half_floats(source[0]));
+	for (uint32_t level = 1; level < LEVELS; level++) {
+		float roughness = static_cast<float>(level) / (LEVELS - 1);
+		uint32_t sample_count = options.sample_count << (level - 1);
+		Sample_Set samples = ggx_samples(roughness, sample_count, source[0].size, static_cast<int>(source.size()));
+		baked.levels.push_back(to_half_floats(prefilter(source, source[level].size, samples)));
+	}
+	baked.irradiance = project_irradiance(source[0]);
+
+	return baked;
+}
+
+glm::vec3 environment_map::irradiance(const Irradiance& coefficients, glm::vec3 normal) {
+	float basis[9];
+	sh_basis(normal, basis);
+	glm::vec3 result(0.0f);
+	for (int i = 0; i < 9; i++) {
+		result += coefficients[i] * basis[i];
+	}
+	return result;
+}
+
+environment_map::Environment_Map environment_map::load(const std::filesystem::path& panorama_path,
+													   const Options& options) {
+	using Clock = std::chrono::steady_clock;
+	auto elapsed_ms = [](Clock::time_point since) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+	};
+
+	Environment_Map environment;
+	auto start = Clock::now();
+	std::optional<texture_cache::Environment_File> cached = texture_cache::read_environment(panorama_path, options);
+	if (cached) {
+		environment.cubemap = Cubemap(cached->container);
+		environment.irradiance = cached->irradiance;
+		if constexpr (constants::DEBUG) {
+			std::cout << "ENVIRONMENT_MAP from cache in " << elapsed_ms(start) << " ms" << std::endl;
+		}
+		return environment;
+	}
+
+	Hdr_Image panorama = Hdr_Image::decode(panorama_path);
+	if (!panorama) {
+		return environment;
+	}
+	double decode_ms = elapsed_ms(start);
+
+	auto bake_start = Clock::now();
+	Baked baked = bake(panorama, options);
+	if (baked.levels.empty()) {
+		return environment;
+	}
+	double bake_ms = elapsed_ms(bake_start);
+
+	texture_cache::write_environment(panorama_path, options, baked);
+	environment.cubemap = upload(baked);
+	environment.irradiance = baked.irradiance;
+	if constexpr (constants::DEBUG) {
+		std::cout << "ENVIRONMENT_MAP decode " << decode_ms << " ms, bake " << bake_ms << " ms" << std::endl;
+	}
+	return environment;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "texture.h"
+
+// Image-based lighting baked on the CPU from an equirectangular HDR panorama.
+//
+// The panorama is resampled into a cube map. Level 0 is the plain projection, and every coarser level is the radiance
+// convolved with the GGX lobe for roughness level / (LEVELS - 1), so a lookup for roughness r samples lod
+// r * (LEVELS - 1). Each level is importance sampled from a box-filtered copy of the projection, at the mip whose
+// texels match the solid angle a sample stands for. Next to the cube map comes the irradiance as nine spherical
+// harmonics coefficients, for diffuse lighting without a texture fetch.
+//
+// The faces are split into bands of rows over the shared thread pool and texels are filtered in SSE registers where
+// available. The bake is cached under CACHE_PATH as a half float KTX2 cube map, so later runs only map and upload it.
+namespace environment_map {
+
+// the roughest level is 1/32 of level 0, GGX at roughness 1 has nothing finer to keep
+constexpr uint32_t LEVELS = 6;
+
+struct Options {
+	// of level 0, a power of two no smaller than 1 << (LEVELS - 1)
+	uint32_t face_size = 512;
+	// GGX samples per texel of level 1, doubling with every coarser level: wider lobes need more of them to converge,
+	// and the levels have a quarter of the texels each
+	uint32_t sample_count = 64;
+};
+
+// linear RGB radiance as RGBA floats with alpha 1, row 0 at the top
+struct Hdr_Image {
+	int width = 0;
+	int height = 0;
+	std::vector<float> pixels;
+
+	// returns an empty image (and reports the error) if the file can't be decoded
+	static Hdr_Image decode(const std::filesystem::path& image_path);
+
+	explicit operator bool() const { return !pixels.empty(); }
+};
+
+// irradiance(n) = sum of coefficient i * basis function i at n, in the order of shaders/object.frag
+using Irradiance = std::array<glm::vec3, 9>;
+
+struct Baked {
+	uint32_t face_size = 0;
+	// level 0 first, each the six faces in GL face order as RGBA half floats with alpha 1
+	std::vector<std::vector<uint16_t>> levels;
+	Irradiance irradiance{};
+};
+
+// CPU only, returns nothing usable if `options.face_size` isn't valid
+Baked bake(const Hdr_Image& panorama, const Options& options);
+// the irradiance arriving at a surface facing `normal`, as the shaders evaluate it
+glm::vec3 irradiance(const Irradiance& coefficients, glm::vec3 normal);
+
+struct Environment_Map {
+	Cubemap cubemap;
+	Irradiance irradiance{};
+
+	explicit operator bool() const { return cubemap.id != 0; }
+};
+
+// Maps the cached bake of `panorama_path` if it is current, otherwise bakes and caches it, then uploads the cube map.
+// Context thread only. Returns an empty map if the panorama can't be decoded.
+Environment_Map load(const std::filesystem::path& panorama_path, const Options& options = {});
+
+}
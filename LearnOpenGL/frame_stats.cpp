@@ -0,0 +1,80 @@
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#include "config.h"
+#include "frame_stats.h"
+
+static thread_local uint64_t t_allocations = 0;
+
+// Counting replacements for the global operator new/delete. The array and nothrow forms forward to these by
+// default; over-aligned allocations keep the default implementation and aren't counted.
+void* operator new(size_t size) {
+	t_allocations++;
+	if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+		return memory;
+	}
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+	std::free(memory);
+}
+
+static Frame_Stats s_current;
+static Frame_Stats s_accumulated;
+static uint64_t s_accumulated_frames = 0;
+static float s_accumulated_time = 0.0f;
+
+Frame_Stats& frame_stats::current() {
+	return s_current;
+}
+
+void frame_stats::begin_frame() {
+	s_current = {};
+}
+
+void frame_stats::end_frame(float delta_time) {
+	s_accumulated.draw_allocations += s_current.draw_allocations;
+	s_accumulated.draw_calls += s_current.draw_calls;
+	s_accumulated.triangles += s_current.triangles;
+	s_accumulated.triangles_culled += s_current.triangles_culled;
+	s_accumulated.texture_binds += s_current.texture_binds;
+	s_accumulated.bindless_textures += s_current.bindless_textures;
+	s_accumulated.upload_bytes += s_current.upload_bytes;
+	s_accumulated.upload_stall_ns += s_current.upload_stall_ns;
+	s_accumulated.meshes_drawn += s_current.meshes_drawn;
+	s_accumulated.meshes_culled += s_current.meshes_culled;
+	s_accumulated_frames++;
+	s_accumulated_time += delta_time;
+
+	if (s_accumulated_time < 1.0f) {
+		return;
+	}
+
+	if constexpr (constants::DEBUG) {
+		double frames = static_cast<double>(s_accumulated_frames);
+		std::cout << "FRAME_STATS " << 1000.0 * s_accumulated_time / frames << " ms/frame, "
+				  << s_accumulated.draw_calls / frames << " draw calls, " << s_accumulated.triangles / frames
+				  << " triangles (" << s_accumulated.triangles_culled / frames << " culled), "
+				  << s_accumulated.texture_binds / frames << " texture binds, "
+				  << s_accumulated.bindless_textures / frames << " bindless textures, "
+				  << s_accumulated.meshes_drawn / frames << " meshes drawn, " << s_accumulated.meshes_culled / frames
+				  << " culled, " << s_accumulated.draw_allocations << " draw allocations, "
+				  << s_accumulated.upload_bytes / (1024.0 * 1024.0) / s_accumulated_time << " MB/s uploaded with "
+				  << s_accumulated.upload_stall_ns / 1e6 / frames << " ms/frame stalled" << std::endl;
+	}
+
+	s_accumulated = {};
+	s_accumulated_frames = 0;
+	s_accumulated_time = 0.0f;
+}
+
+uint64_t frame_stats::thread_allocations() {
+	return t_allocations;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+// per-frame renderer counters, reset by begin_frame() and reported by end_frame() in debug builds
+struct Frame_Stats {
+	// heap allocations made by the render thread while drawing models, should stay at 0
+	uint64_t draw_allocations = 0;
+	uint64_t draw_calls = 0;
+	uint64_t triangles = 0;
+	// triangles skipped by mesh or meshlet culling
+	uint64_t triangles_culled = 0;
+	uint64_t texture_binds = 0;
+	// draws that sampled a texture through a resident handle instead of a bind
+	uint64_t bindless_textures = 0;
+	// texture data handed to the GL, and how long the render thread spent staging and issuing it
+	uint64_t upload_bytes = 0;
+	uint64_t upload_stall_ns = 0;
+	// meshes that passed or failed frustum culling
+	uint64_t meshes_drawn = 0;
+	uint64_t meshes_culled = 0;
+};
+
+namespace frame_stats {
+
+Frame_Stats& current();
+
+void begin_frame();
+// prints the averages over the last second in debug builds
+void end_frame(float delta_time);
+
+// heap allocations made by the calling thread since it started, counted by the global operator new
+uint64_t thread_allocations();
+
+}
@@ -4,6 +4,18 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "fs_util.h"
 
@@ -18,3 +30,129 @@ std::string fs_util::read_file(const std::filesystem::path& filename) {
 	buffer << file.rdbuf();
 	return buffer.str();
 }
+
+uint64_t fs_util::hash_bytes(std::span<const std::byte> bytes, uint64_t seed) {
+	uint64_t hash = seed;
+	for (std::byte byte : bytes) {
+		hash ^= static_cast<uint64_t>(byte);
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+uint64_t fs_util::hash_file(const std::filesystem::path& filename) {
+	Mapped_File file;
+	if (!file.open(filename)) {
+		return 0;
+	}
+
+	return hash_bytes(file.bytes());
+}
+
+fs_util::Mapped_File::Mapped_File(Mapped_File&& other) noexcept {
+	*this = std::move(other);
+}
+
+fs_util::Mapped_File& fs_util::Mapped_File::operator=(Mapped_File&& other) noexcept {
+	if (this != &other) {
+		close();
+		m_data = std::exchange(other.m_data, nullptr);
+		m_size = std::exchange(other.m_size, 0);
+#ifdef _WIN32
+		m_file_handle = std::exchange(other.m_file_handle, nullptr);
+		m_mapping_handle = std::exchange(other.m_mapping_handle, nullptr);
+#endif
+	}
+
+	return *this;
+}
+
+fs_util::Mapped_File::~Mapped_File() {
+	close();
+}
+
+#ifdef _WIN32
+bool fs_util::Mapped_File::open(const std::filesystem::path& filename) {
+	close();
+
+	HANDLE file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+							  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping) {
+		CloseHandle(file);
+		return false;
+	}
+
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_file_handle = file;
+	m_mapping_handle = mapping;
+	m_data = static_cast<const std::byte*>(data);
+	m_size = static_cast<size_t>(size.QuadPart);
+	return true;
+}
+
+void fs_util::Mapped_File::close() {
+	if (m_data) {
+		UnmapViewOfFile(m_data);
+		CloseHandle(m_mapping_handle);
+		CloseHandle(m_file_handle);
+	}
+
+	m_data = nullptr;
+	m_size = 0;
+	m_file_handle = nullptr;
+	m_mapping_handle = nullptr;
+}
+#else
+bool fs_util::Mapped_File::open(const std::filesystem::path& filename) {
+	close();
+
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd == -1) {
+		return false;
+	}
+
+	struct stat info {};
+	if (fstat(fd, &info) == -1 || info.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps its own reference to the file
+	::close(fd);
+	if (data == MAP_FAILED) {
+		return false;
+	}
+
+	m_data = static_cast<const std::byte*>(data);
+	m_size = static_cast<size_t>(info.st_size);
+	return true;
+}
+
+void fs_util::Mapped_File::close() {
+	if (m_data) {
+		munmap(const_cast<std::byte*>(m_data), m_size);
+	}
+
+	m_data = nullptr;
+	m_size = 0;
+}
+#endif
@@ -1,10 +1,45 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <span>
 #include <string>
 
 namespace fs_util {
 
 std::string read_file(const std::filesystem::path& filename);
 
-}
\ No newline at end of file
+// 64-bit FNV-1a over an arbitrary byte range
+uint64_t hash_bytes(std::span<const std::byte> bytes, uint64_t seed = 0xcbf29ce484222325ull);
+
+// hashes the whole contents of a file, returns 0 if the file can't be read
+uint64_t hash_file(const std::filesystem::path& filename);
+
+// read-only memory mapping of a whole file
+class Mapped_File {
+   public:
+	Mapped_File() = default;
+	Mapped_File(const Mapped_File&) = delete;
+	Mapped_File& operator=(const Mapped_File&) = delete;
+	Mapped_File(Mapped_File&& other) noexcept;
+	Mapped_File& operator=(Mapped_File&& other) noexcept;
+	~Mapped_File();
+
+	// returns false if the file doesn't exist or can't be mapped
+	bool open(const std::filesystem::path& filename);
+	void close();
+
+	bool is_open() const { return m_data != nullptr; }
+	std::span<const std::byte> bytes() const { return {m_data, m_size}; }
+
+   private:
+	const std::byte* m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	void* m_file_handle = nullptr;
+	void* m_mapping_handle = nullptr;
+#endif
+};
+
+}
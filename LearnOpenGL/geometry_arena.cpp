@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <iostream>
+
+#include "config.h"
+#include "geometry_arena.h"
+
+static constexpr size_t INITIAL_VERTEX_CAPACITY = 1 << 16;
+static constexpr size_t INITIAL_INDEX_CAPACITY = 3 << 16;
+
+Range_Allocator::Range_Allocator(size_t capacity) {
+	reset(capacity, 0);
+}
+
+std::optional<size_t> Range_Allocator::allocate(size_t count) {
+	if (count == 0) {
+		return 0;
+	}
+
+	for (auto it = m_free_blocks.begin(); it != m_free_blocks.end(); ++it) {
+		auto [offset, size] = *it;
+		if (size < count) {
+			continue;
+		}
+
+		m_free_blocks.erase(it);
+		if (size > count) {
+			m_free_blocks.emplace(offset + count, size - count);
+		}
+		m_free_count -= count;
+		return offset;
+	}
+
+	return std::nullopt;
+}
+
+void Range_Allocator::release(size_t offset, size_t count) {
+	if (count == 0) {
+		return;
+	}
+
+	m_free_count += count;
+	auto next = m_free_blocks.lower_bound(offset);
+	if (next != m_free_blocks.end() && offset + count == next->first) {
+		count += next->second;
+		next = m_free_blocks.erase(next);
+	}
+
+	if (next != m_free_blocks.begin()) {
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset) {
+			previous->second += count;
+			return;
+		}
+	}
+
+	m_free_blocks.emplace(offset, count);
+}
+
+void Range_Allocator::reset(size_t capacity, size_t used) {
+	m_free_blocks.clear();
+	m_capacity = capacity;
+	m_free_count = capacity - used;
+	if (m_free_count > 0) {
+		m_free_blocks.emplace(used, m_free_count);
+	}
+}
+
+Geometry_Arena::Geometry_Arena(Vertex_Format format) : m_format(format) {
+	glGenVertexArrays(1, &m_vao);
+	relocate(INITIAL_VERTEX_CAPACITY, INITIAL_INDEX_CAPACITY);
+}
+
+Geometry_Arena& Geometry_Arena::get(Vertex_Format format) {
+	// intentionally never destroyed: static destructors run after the GL context is gone
+	static Geometry_Arena* full = nullptr;
+	static Geometry_Arena* packed = nullptr;
+
+	Geometry_Arena*& arena = format == Vertex_Format::packed ? packed : full;
+	if (!arena) {
+		arena = new Geometry_Arena(format);
+	}
+	return *arena;
+}
+
+Geometry_Arena::Handle Geometry_Arena::allocate(size_t vertex_count, size_t index_count) {
+	std::optional<Range> range = try_allocate(vertex_count, index_count);
+	if (!range) {
+		bool fits_after_compaction =
+			m_vertex_ranges.free_count() >= vertex_count && m_index_ranges.free_count() >= index_count;
+		if (fits_after_compaction) {
+			compact();
+		} else {
+			size_t vertices_used = vertex_capacity() - m_vertex_ranges.free_count();
+			size_t indices_used = index_capacity() - m_index_ranges.free_count();
+			relocate(std::max(vertex_capacity() * 2, vertices_used + vertex_count),
+					 std::max(index_capacity() * 2, indices_used + index_count));
+		}
+		range = try_allocate(vertex_count, index_count);
+	}
+
+	Handle handle;
+	if (!m_free_handles.empty()) {
+		handle = m_free_handles.back();
+		m_free_handles.pop_back();
+		m_allocations[handle] = *range;
+		m_live[handle] = true;
+	} else {
+		handle = static_cast<Handle>(m_allocations.size());
+		m_allocations.push_back(*range);
+		m_live.push_back(true);
+	}
+
+	return handle;
+}
+
+void Geometry_Arena::free(Handle handle) {
+	if (handle == INVALID_HANDLE || !m_live[handle]) {
+		return;
+	}
+
+	const Range& range = m_allocations[handle];
+	m_vertex_ranges.release(range.first_vertex, range.vertex_count);
+	m_index_ranges.release(range.first_index, range.index_count);
+	m_live[handle] = false;
+	m_free_handles.push_back(handle);
+}
+
+void Geometry_Arena::compact() {
+	relocate(vertex_capacity(), index_capacity());
+}
+
+void Geometry_Arena::upload_vertices(Handle handle, std::span<const std::byte> vertices, size_t first) {
+	const Range& range = m_allocations[handle];
+	size_t stride = vertex_format::stride(m_format);
+	if (first >= range.vertex_count) {
+		return;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glBufferSubData(GL_ARRAY_BUFFER, (range.first_vertex + first) * stride,
+					std::min(vertices.size(), (range.vertex_count - first) * stride), vertices.data());
+}
+
+void Geometry_Arena::upload_indices(Handle handle, std::span<const unsigned int> indices, size_t first) {
+	const Range& range = m_allocations[handle];
+	if (first >= range.index_count) {
+		return;
+	}
+
+	// GL_ELEMENT_ARRAY_BUFFER is VAO state, so go through a generic binding point instead
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_ebo);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (range.first_index + first) * sizeof(unsigned int),
+					std::min(indices.size(), size_t(range.index_count) - first) * sizeof(unsigned int), indices.data());
+}
+
+void Geometry_Arena::bind() const {
+	glBindVertexArray(m_vao);
+}
+
+std::optional<Geometry_Arena::Range> Geometry_Arena::try_allocate(size_t vertex_count, size_t index_count) {
+	std::optional<size_t> first_vertex = m_vertex_ranges.allocate(vertex_count);
+	if (!first_vertex) {
+		return std::nullopt;
+	}
+
+	std::optional<size_t> first_index = m_index_ranges.allocate(index_count);
+	if (!first_index) {
+		m_vertex_ranges.release(*first_vertex, vertex_count);
+		return std::nullopt;
+	}
+
+	return Range{static_cast<uint32_t>(*first_vertex), static_cast<uint32_t>(vertex_count),
+				 static_cast<uint32_t>(*first_index), static_cast<uint32_t>(index_count)};
+}
+
+void Geometry_Arena::relocate(size_t vertex_capacity, size_t index_capacity) {
+	size_t stride = vertex_format::stride(m_format);
+
+	GLuint vbo, ebo;
+	glGenBuffers(1, &vbo);
+	glGenBuffers(1, &ebo);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+	glBufferData(GL_COPY_WRITE_BUFFER, vertex_capacity * stride, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+	glBufferData(GL_COPY_WRITE_BUFFER, index_capacity * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+
+	std::vector<Handle> live;
+	for (Handle handle = 0; handle < m_allocations.size(); handle++) {
+		if (m_live[handle]) {
+			live.push_back(handle);
+		}
+	}
+
+	// keep the existing order so compaction moves each range towards the front, never past another
+	size_t vertices_used = 0;
+	std::sort(live.begin(), live.end(),
+			  [&](Handle a, Handle b) { return m_allocations[a].first_vertex < m_allocations[b].first_vertex; });
+	glBindBuffer(GL_COPY_READ_BUFFER, m_vbo);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+	for (Handle handle : live) {
+		Range& range = m_allocations[handle];
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, range.first_vertex * stride,
+							vertices_used * stride, range.vertex_count * stride);
+		range.first_vertex = static_cast<uint32_t>(vertices_used);
+		vertices_used += range.vertex_count;
+	}
+
+	size_t indices_used = 0;
+	std::sort(live.begin(), live.end(),
+			  [&](Handle a, Handle b) { return m_allocations[a].first_index < m_allocations[b].first_index; });
+	glBindBuffer(GL_COPY_READ_BUFFER, m_ebo);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+	for (Handle handle : live) {
+		Range& range = m_allocations[handle];
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, range.first_index * sizeof(unsigned int),
+							indices_used * sizeof(unsigned int), range.index_count * sizeof(unsigned int));
+		range.first_index = static_cast<uint32_t>(indices_used);
+		indices_used += range.index_count;
+	}
+
+	glDeleteBuffers(1, &m_vbo);
+	glDeleteBuffers(1, &m_ebo);
+	m_vbo = vbo;
+	m_ebo = ebo;
+	m_vertex_ranges.reset(vertex_capacity, vertices_used);
+	m_index_ranges.reset(index_capacity, indices_used);
+	m_generation++;
+
+	glBindVertexArray(m_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+	vertex_format::setup_attributes(m_format);
+	glBindVertexArray(0);
+
+	if constexpr (constants::DEBUG) {
+		std::cout << "GEOMETRY_ARENA::RELOCATE " << vertices_used << "/" << vertex_capacity << " vertices, "
+				  << indices_used << "/" << index_capacity << " indices" << std::endl;
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "vertex_format.h"
+
+// First-fit allocator over a range of elements, adjacent free blocks are merged on release.
+class Range_Allocator {
+   public:
+	explicit Range_Allocator(size_t capacity = 0);
+
+	std::optional<size_t> allocate(size_t count);
+	void release(size_t offset, size_t count);
+
+	// everything in [0, used) is allocated, everything after is free
+	void reset(size_t capacity, size_t used);
+
+	size_t capacity() const { return m_capacity; }
+	size_t free_count() const { return m_free_count; }
+
+   private:
+	// offset -> size of each free block
+	std::map<size_t, size_t> m_free_blocks;
+	size_t m_capacity = 0;
+	size_t m_free_count = 0;
+};
+
+// One VAO with one big VBO and EBO shared by every mesh of a vertex format, so a whole model draws with a single VAO
+// bind and glDrawElementsBaseVertex. Indices stay relative to their mesh's first vertex, which lets allocations move
+// when the buffers grow or are compacted without touching the index data.
+class Geometry_Arena {
+   public:
+	using Handle = uint32_t;
+	static constexpr Handle INVALID_HANDLE = UINT32_MAX;
+
+	struct Range {
+		uint32_t first_vertex = 0;
+		uint32_t vertex_count = 0;
+		uint32_t first_index = 0;
+		uint32_t index_count = 0;
+	};
+
+	explicit Geometry_Arena(Vertex_Format format);
+	Geometry_Arena(const Geometry_Arena&) = delete;
+	Geometry_Arena& operator=(const Geometry_Arena&) = delete;
+
+	// the shared arena for a vertex format, created on first use; must be called on the context thread
+	static Geometry_Arena& get(Vertex_Format format);
+
+	Handle allocate(size_t vertex_count, size_t index_count);
+	// only touches bookkeeping, so it's fine to call after the context is gone
+	void free(Handle handle);
+	// moves every live allocation to the front of the buffers, merging all free space into one block at the end
+	void compact();
+
+	// `vertices` must be laid out in this arena's vertex format
+	// `first` offsets into the allocation so large meshes can be uploaded in slices, writes are clamped to its size
+	void upload_vertices(Handle handle, std::span<const std::byte> vertices, size_t first = 0);
+	void upload_indices(Handle handle, std::span<const unsigned int> indices, size_t first = 0);
+
+	const Range& range(Handle handle) const { return m_allocations[handle]; }
+	void bind() const;
+
+	// bumped whenever allocations move, anything caching ranges (e.g. indirect commands) must rebuild when it changes
+	uint64_t generation() const { return m_generation; }
+
+	size_t vertex_capacity() const { return m_vertex_ranges.capacity(); }
+	size_t index_capacity() const { return m_index_ranges.capacity(); }
+
+   private:
+	Vertex_Format m_format;
+	GLuint m_vao = 0, m_vbo = 0, m_ebo = 0;
+	Range_Allocator m_vertex_ranges;
+	Range_Allocator m_index_ranges;
+	std::vector<Range> m_allocations;
+	std::vector<bool> m_live;
+	std::vector<Handle> m_free_handles;
+	uint64_t m_generation = 0;
+
+	std::optional<Range> try_allocate(size_t vertex_count, size_t index_count);
+	// copies every live allocation, packed, into freshly created buffers of the given capacities
+	void relocate(size_t vertex_capacity, size_t index_capacity);
+};
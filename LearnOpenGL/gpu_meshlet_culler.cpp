@@ -0,0 +1,202 @@
+#include <iostream>
+#include <numeric>
+
+#include "bindless_textures.h"
+#include "frame_stats.h"
+#include "gpu_meshlet_culler.h"
+#include "texture_streamer.h"
+
+// the same slots Indirect_Draw_List and shaders/model_indirect.vert use
+static constexpr GLuint DRAW_ID_ATTRIBUTE = 3;
+static constexpr GLuint DRAW_DATA_BINDING = 0;
+static constexpr GLint ATLAS_UNIT = 15;
+// shaders/meshlet_cull.comp
+static constexpr GLuint MESHLET_BINDING = 1;
+static constexpr GLuint COMMAND_BINDING = 2;
+static constexpr GLuint MESH_CULL_BINDING = 3;
+static constexpr GLuint CULL_GROUP_SIZE = 64;
+
+Gpu_Meshlet_Culler::~Gpu_Meshlet_Culler() {
+	glDeleteBuffers(1, &m_meshlet_buffer);
+	glDeleteBuffers(1, &m_command_buffer);
+	glDeleteBuffers(1, &m_mesh_cull_buffer);
+	glDeleteBuffers(1, &m_draw_data_buffer);
+	glDeleteBuffers(1, &m_draw_id_buffer);
+}
+
+bool Gpu_Meshlet_Culler::supported() {
+	return GLAD_GL_VERSION_4_3;
+}
+
+void Gpu_Meshlet_Culler::draw(Model& model,
+							  Shader_Program& cull_shader,
+							  Shader_Program& shader,
+							  const Render_View& view,
+							  const glm::mat4& transform) {
+	if (!supported()) {
+		std::cerr << "ERROR::MESHLET_CULLING\n" << "compute culling needs OpenGL 4.3" << std::endl;
+		return;
+	}
+	if (model.meshes.empty()) {
+		return;
+	}
+
+	uint64_t allocations_before = frame_stats::thread_allocations();
+	model.update_transforms();
+
+	Vertex_Format format = model.meshes.front().format();
+	uint64_t generation = Geometry_Arena::get(format).generation();
+	if (&model != m_built_model || model.meshes.size() != m_built_mesh_count || generation != m_built_generation) {
+		rebuild(model);
+	}
+
+	bool culls_backfaces = meshlet::culls_backfaces();
+	m_cull_batch.clear();
+	for (size_t i = 0; i < model.meshes.size(); i++) {
+		const Mesh& mesh = model.meshes[i];
+		glm::mat4 world = transform * model.scene_graph.world(model.mesh_nodes[i]);
+		m_cull_batch.add(mesh.bounding_volume(), world);
+
+		Frustum frustum = view.frustum.to_object_space(world);
+		Mesh_Cull& cull = m_mesh_culls[i];
+		std::copy(frustum.planes.begin(), frustum.planes.end(), cull.planes);
+		cull.camera = glm::vec4(glm::vec3(glm::inverse(world) * glm::vec4(view.position, 1.0f)), 0.0f);
+		if (culls_backfaces && !mesh.two_sided() && !meshlet::mirrors(world)) {
+			cull.camera.w = 1.0f;
+		}
+
+		const Quantization_Bounds& bounds = mesh.quantization_bounds();
+		glm::uvec2 diffuse_handle(static_cast<uint32_t>(m_diffuse_handles[i]),
+								  static_cast<uint32_t>(m_diffuse_handles[i] >> 32));
+		m_draw_data[i] = {world,
+						  glm::vec4(bounds.min, 0.0f),
+						  glm::vec4(bounds.extent, 0.0f),
+						  Texture_Atlas::NO_LAYER,
+						  0,
+						  diffuse_handle,
+						  glm::vec4(0.0f, 0.0f, 1.0f, 1.0f)};
+	}
+	size_t visible = m_cull_batch.cull(view.frustum);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_mesh_cull_buffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_mesh_culls.size() * sizeof(Mesh_Cull), m_mesh_culls.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_draw_data_buffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_draw_data.size() * sizeof(Draw_Data), m_draw_data.data());
+
+	cull_shader.use();
+	cull_shader.set_int("meshletCount", static_cast<GLint>(m_meshlet_count));
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESHLET_BINDING, m_meshlet_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, m_command_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESH_CULL_BINDING, m_mesh_cull_buffer);
+	glDispatchCompute(static_cast<GLuint>((m_meshlet_count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE), 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+
+	shader.use();
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, m_draw_data_buffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_command_buffer);
+	Geometry_Arena::get(format).bind();
+	glBindBuffer(GL_ARRAY_BUFFER, m_draw_id_buffer);
+	glEnableVertexAttribArray(DRAW_ID_ATTRIBUTE);
+	glVertexAttribIPointer(DRAW_ID_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)0);
+	glVertexAttribDivisor(DRAW_ID_ATTRIBUTE, 1);
+	if (shader.id != m_program) {
+		// nothing is packed into an atlas here, but left at unit 0 the array sampler clashes with
+		// material.texture_diffuse1 and every draw fails; uniforms keep their values, so once per program is enough
+		shader.set_int(shader.uniform<GLint>("material.texture_diffuse_array"), ATLAS_UNIT);
+		m_packed_vertices = shader.uniform<bool>("packedVertices");
+		m_batch_diffuse = {shader.find_uniform_location("batchDiffuse")};
+		m_program = shader.id;
+	}
+	shader.set_bool(m_packed_vertices, format == Vertex_Format::packed);
+
+	Frame_Stats& stats = frame_stats::current();
+	stats.meshes_drawn += visible;
+	stats.meshes_culled += model.meshes.size() - visible;
+	for (size_t i = 0; i < model.meshes.size(); i++) {
+		if (!m_cull_batch.is_visible(i) || m_command_count[i] == 0) {
+			continue;
+		}
+
+		const Mesh& mesh = model.meshes[i];
+		if (m_diffuse_handles[i] != 0) {
+			// each mesh is a call of its own, so its handle is uniform across the call even where it has to be set on
+			// the shader's batch sampler
+			if (m_batch_diffuse) {
+				Bindless_Textures::set_uniform(m_batch_diffuse.location, m_diffuse_handles[i]);
+			}
+			stats.bindless_textures++;
+		} else {
+			mesh.request_texture_detail(Texture_Streamer::uv_per_pixel(mesh.bounding_volume(), m_cull_batch.center(i),
+																	   m_cull_batch.radius(i), view));
+			mesh.bind_textures(shader);
+		}
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+									(void*)(m_first_command[i] * sizeof(Draw_Elements_Indirect_Command)),
+									static_cast<GLsizei>(m_command_count[i]), 0);
+		stats.draw_calls++;
+	}
+
+	// the arena's VAO is shared, instanced draws would otherwise keep fetching draw ids past the end of the buffer
+	glDisableVertexAttribArray(DRAW_ID_ATTRIBUTE);
+	glVertexAttribDivisor(DRAW_ID_ATTRIBUTE, 0);
+	glBindVertexArray(0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	stats.draw_allocations += frame_stats::thread_allocations() - allocations_before;
+}
+
+void Gpu_Meshlet_Culler::rebuild(const Model& model) {
+	if (m_meshlet_buffer == 0) {
+		glGenBuffers(1, &m_meshlet_buffer);
+		glGenBuffers(1, &m_command_buffer);
+		glGenBuffers(1, &m_mesh_cull_buffer);
+		glGenBuffers(1, &m_draw_data_buffer);
+		glGenBuffers(1, &m_draw_id_buffer);
+	}
+
+	size_t mesh_count = model.meshes.size();
+	std::vector<Meshlet> meshlets;
+	std::vector<Draw_Elements_Indirect_Command> commands;
+	m_first_command.resize(mesh_count);
+	m_command_count.resize(mesh_count);
+	m_diffuse_handles.resize(mesh_count);
+	for (size_t i = 0; i < mesh_count; i++) {
+		const Mesh& mesh = model.meshes[i];
+		m_diffuse_handles[i] = mesh.diffuse_texture_handle();
+		const Geometry_Arena::Range& range = mesh.geometry();
+		m_first_command[i] = commands.size();
+		m_command_count[i] = mesh.meshlets().size();
+
+		for (Meshlet meshlet : mesh.meshlets()) {
+			commands.push_back({meshlet.index_count, 1, range.first_index + meshlet.first_index,
+								static_cast<int32_t>(range.first_vertex), static_cast<uint32_t>(i)});
+			// the shader reads the owning mesh from the first padding slot
+			meshlet.padding[0] = static_cast<uint32_t>(i);
+			meshlets.push_back(meshlet);
+		}
+	}
+	m_meshlet_count = meshlets.size();
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_meshlet_buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, meshlets.size() * sizeof(Meshlet), meshlets.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_command_buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, commands.size() * sizeof(Draw_Elements_Indirect_Command), commands.data(),
+				 GL_DYNAMIC_DRAW);
+
+	m_mesh_culls.resize(mesh_count);
+	m_draw_data.resize(mesh_count);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_mesh_cull_buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, mesh_count * sizeof(Mesh_Cull), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_draw_data_buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, mesh_count * sizeof(Draw_Data), nullptr, GL_DYNAMIC_DRAW);
+
+	// base_instance is the mesh index, which reaches the vertex shader through this 0..n-1 attribute
+	std::vector<uint32_t> draw_ids(mesh_count);
+	std::iota(draw_ids.begin(), draw_ids.end(), 0u);
+	glBindBuffer(GL_ARRAY_BUFFER, m_draw_id_buffer);
+	glBufferData(GL_ARRAY_BUFFER, draw_ids.size() * sizeof(uint32_t), draw_ids.data(), GL_STATIC_DRAW);
+
+	m_built_model = &model;
+	m_built_mesh_count = mesh_count;
+	m_built_generation = Geometry_Arena::get(model.meshes.front().format()).generation();
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "culling.h"
+#include "indirect_draw.h"
+#include "model.h"
+#include "shader_program.h"
+
+// Compute shader alternative to the CPU meshlet culling in Model::draw(shader, view), needs GL 4.3.
+//
+// Every meshlet of the model gets a fixed indirect command. Each frame shaders/meshlet_cull.comp switches the
+// commands on or off by setting their instance count. Each mesh then goes out as one glMultiDrawElementsIndirect
+// call through shaders/model_indirect.vert, so culled clusters never reach the CPU. Whole meshes are still
+// frustum culled on the CPU first. The GPU decides the per-meshlet results, so they don't show up in Frame_Stats
+// without a readback.
+class Gpu_Meshlet_Culler {
+   public:
+	Gpu_Meshlet_Culler() = default;
+	Gpu_Meshlet_Culler(const Gpu_Meshlet_Culler&) = delete;
+	Gpu_Meshlet_Culler& operator=(const Gpu_Meshlet_Culler&) = delete;
+	~Gpu_Meshlet_Culler();
+
+	static bool supported();
+
+	// `cull_shader` is built from shaders/meshlet_cull.comp, `shader` must use shaders/model_indirect.vert and
+	// already have its view and projection set; meshes without meshlets are skipped
+	void draw(Model& model,
+			  Shader_Program& cull_shader,
+			  Shader_Program& shader,
+			  const Render_View& view,
+			  const glm::mat4& transform = glm::mat4(1.0f));
+
+   private:
+	// the view in one mesh's object space, std430 layout of MeshCull; camera.w is 1 where the normal cones are tested
+	struct Mesh_Cull {
+		glm::vec4 planes[6];
+		glm::vec4 camera;
+	};
+
+	const Model* m_built_model = nullptr;
+	size_t m_built_mesh_count = 0;
+	uint64_t m_built_generation = UINT64_MAX;
+	size_t m_meshlet_count = 0;
+	// per mesh, into the command buffer
+	std::vector<size_t> m_first_command;
+	std::vector<size_t> m_command_count;
+	// see Mesh::diffuse_texture_handle(), meshes with one skip binding their textures
+	std::vector<GLuint64> m_diffuse_handles;
+
+	std::vector<Mesh_Cull> m_mesh_culls;
+	std::vector<Draw_Data> m_draw_data;
+	Cull_Batch m_cull_batch;
+
+	// the program draw() resolved its uniforms against last
+	GLuint m_program = 0;
+	Uniform<bool> m_packed_vertices;
+	// see Indirect_Draw_List, only there without divergent bindless handles
+	Uniform<GLint> m_batch_diffuse;
+
+	GLuint m_meshlet_buffer = 0;
+	GLuint m_command_buffer = 0;
+	GLuint m_mesh_cull_buffer = 0;
+	GLuint m_draw_data_buffer = 0;
+	GLuint m_draw_id_buffer = 0;
+
+	void rebuild(const Model& model);
+};
@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <numeric>
+
+#include "bindless_textures.h"
+#include "frame_stats.h"
+#include "indirect_draw.h"
+#include "texture_streamer.h"
+
+static constexpr GLuint DRAW_ID_ATTRIBUTE = 3;
+static constexpr GLuint DRAW_DATA_BINDING = 0;
+// past the units Material_Bindings hands out, one per mesh texture
+static constexpr GLint ATLAS_UNIT = 15;
+
+// how a mesh's first diffuse texture reaches the shader without being bound, if it does
+struct Diffuse_Source {
+	GLuint64 handle = 0;
+	const Texture_Atlas::Placement* placement = nullptr;
+};
+
+static Diffuse_Source diffuse_source(const Mesh& mesh, const Texture_Atlas* atlas) {
+	if (GLuint64 handle = mesh.diffuse_texture_handle()) {
+		return {handle, nullptr};
+	}
+	if (!atlas) {
+		return {};
+	}
+
+	for (const Material_Texture& texture : mesh.textures) {
+		if (texture.type == "texture_diffuse") {
+			return {0, atlas->find(texture.handle)};
+		}
+	}
+
+	return {};
+}
+
+// Textures identify a material until materials exist as their own thing. A packed diffuse texture is keyed by the
+// array it is in, above the range of handles, since the shader finds its layer per draw. Meshes with a bindless
+// diffuse texture bind nothing; they all share one key where the shader can use the handle of each draw, and are keyed
+// by their handle otherwise, as the shader gets it through a uniform per multi-draw.
+static std::vector<uint64_t> material_key(const Mesh& mesh, const Diffuse_Source& diffuse) {
+	if (diffuse.handle != 0) {
+		if (Bindless_Textures::divergent_handles()) {
+			return {uint64_t{2} << 32};
+		}
+		return {uint64_t{2} << 32, diffuse.handle};
+	}
+
+	std::vector<uint64_t> key;
+	key.reserve(mesh.textures.size());
+	bool packed = diffuse.placement != nullptr;
+	for (const Material_Texture& texture : mesh.textures) {
+		if (packed && texture.type == "texture_diffuse") {
+			key.push_back((uint64_t{1} << 32) | diffuse.placement->array);
+			packed = false;
+		} else {
+			key.push_back(texture.handle);
+		}
+	}
+
+	return key;
+}
+
+Indirect_Draw_List::~Indirect_Draw_List() {
+	glDeleteBuffers(1, &m_command_buffer);
+	glDeleteBuffers(1, &m_draw_data_buffer);
+	glDeleteBuffers(1, &m_draw_id_buffer);
+}
+
+bool Indirect_Draw_List::supported() {
+	return GLAD_GL_VERSION_4_3;
+}
+
+void Indirect_Draw_List::clear() {
+	m_entries.clear();
+}
+
+void Indirect_Draw_List::add(const Mesh& mesh, const glm::mat4& transform) {
+	m_entries.push_back({&mesh, transform});
+}
+
+void Indirect_Draw_List::add(const Model& model, const glm::mat4& transform) {
+	for (size_t i = 0; i < model.meshes.size(); i++) {
+		add(model.meshes[i], transform * model.scene_graph.world(model.mesh_nodes[i]));
+	}
+}
+
+void Indirect_Draw_List::set_atlas(const Texture_Atlas* atlas) {
+	m_atlas = atlas;
+	// forces a rebuild even if the new atlas happens to be at the old one's generation
+	m_built_entries.clear();
+}
+
+void Indirect_Draw_List::submit(Shader_Program& shader) {
+	if (!supported()) {
+		std::cerr << "ERROR::INDIRECT_DRAW\n" << "multi-draw indirect needs OpenGL 4.3" << std::endl;
+		return;
+	}
+
+	if (is_stale()) {
+		rebuild();
+	}
+
+	uint64_t allocations_before = frame_stats::thread_allocations();
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_command_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, m_draw_data_buffer);
+	if (shader.id != m_program) {
+		// uniforms keep their values, so this is set once per program; even without an atlas, as left at unit 0 the
+		// array sampler would clash with material.texture_diffuse1
+		shader.set_int(shader.uniform<GLint>("material.texture_diffuse_array"), ATLAS_UNIT);
+		m_packed_vertices = shader.uniform<bool>("packedVertices");
+		m_batch_diffuse = {shader.find_uniform_location("batchDiffuse")};
+		m_program = shader.id;
+	}
+
+	for (size_t i = 0; i < m_batches.size(); i++) {
+		const Batch& batch = m_batches[i];
+		// batches are sorted by format, so each arena is bound once
+		if (i == 0 || m_batches[i - 1].format != batch.format) {
+			Geometry_Arena::get(batch.format).bind();
+			glBindBuffer(GL_ARRAY_BUFFER, m_draw_id_buffer);
+			glEnableVertexAttribArray(DRAW_ID_ATTRIBUTE);
+			glVertexAttribIPointer(DRAW_ID_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)0);
+			glVertexAttribDivisor(DRAW_ID_ATTRIBUTE, 1);
+			shader.set_bool(m_packed_vertices, batch.format == Vertex_Format::packed);
+		}
+
+		if (batch.diffuse_handle != 0) {
+			if (m_batch_diffuse) {
+				Bindless_Textures::set_uniform(m_batch_diffuse.location, batch.diffuse_handle);
+			}
+			frame_stats::current().bindless_textures += batch.command_count;
+		} else {
+			// the batch spans meshes at any distance, so its textures are asked for in full
+			batch.material_source->request_texture_detail(0.0f);
+			batch.material_source->bind_textures(shader);
+		}
+		if (batch.atlas_array != NO_ARRAY) {
+			glActiveTexture(GL_TEXTURE0 + ATLAS_UNIT);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, m_atlas->array(batch.atlas_array));
+			glActiveTexture(GL_TEXTURE0);
+			frame_stats::current().texture_binds++;
+		}
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+									(void*)(batch.first_command * sizeof(Draw_Elements_Indirect_Command)),
+									static_cast<GLsizei>(batch.command_count), 0);
+		frame_stats::current().draw_calls++;
+
+		// The arena's vertex array is shared with every other draw path. Left enabled, an instanced draw with more
+		// instances than this list has draws would fetch the draw id past the end of its buffer.
+		if (i + 1 == m_batches.size() || m_batches[i + 1].format != batch.format) {
+			glDisableVertexAttribArray(DRAW_ID_ATTRIBUTE);
+			glVertexAttribDivisor(DRAW_ID_ATTRIBUTE, 0);
+		}
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	frame_stats::current().draw_allocations += frame_stats::thread_allocations() - allocations_before;
+}
+
+bool Indirect_Draw_List::is_stale() const {
+	if (m_entries != m_built_entries || (m_atlas && m_atlas->generation() != m_built_atlas_generation)) {
+		return true;
+	}
+
+	for (const Batch& batch : m_batches) {
+		if (m_built_generations[static_cast<size_t>(batch.format)] != Geometry_Arena::get(batch.format).generation()) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void Indirect_Draw_List::rebuild() {
+	if (m_command_buffer == 0) {
+		glGenBuffers(1, &m_command_buffer);
+		glGenBuffers(1, &m_draw_data_buffer);
+		glGenBuffers(1, &m_draw_id_buffer);
+	}
+
+	// group draws by vertex format and material so each group is one multi-draw call
+	std::map<std::vector<uint64_t>, uint32_t> material_indices;
+	std::vector<uint32_t> entry_materials(m_entries.size());
+	std::vector<Diffuse_Source> entry_diffuse(m_entries.size());
+	for (size_t i = 0; i < m_entries.size(); i++) {
+		entry_diffuse[i] = diffuse_source(*m_entries[i].mesh, m_atlas);
+		auto [it, inserted] = material_indices.try_emplace(material_key(*m_entries[i].mesh, entry_diffuse[i]),
+														   static_cast<uint32_t>(material_indices.size()));
+		entry_materials[i] = it->second;
+	}
+
+	std::vector<size_t> order(m_entries.size());
+	std::iota(order.begin(), order.end(), size_t(0));
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		Vertex_Format format_a = m_entries[a].mesh->format();
+		Vertex_Format format_b = m_entries[b].mesh->format();
+		return format_a != format_b ? format_a < format_b : entry_materials[a] < entry_materials[b];
+	});
+
+	std::vector<Draw_Elements_Indirect_Command> commands(m_entries.size());
+	std::vector<Draw_Data> draw_data(m_entries.size());
+	m_batches.clear();
+	for (size_t i = 0; i < order.size(); i++) {
+		const Entry& entry = m_entries[order[i]];
+		const Geometry_Arena::Range& range = entry.mesh->geometry();
+		const Quantization_Bounds& bounds = entry.mesh->quantization_bounds();
+		uint32_t material = entry_materials[order[i]];
+		const Diffuse_Source& diffuse = entry_diffuse[order[i]];
+		const Texture_Atlas::Placement* placement = diffuse.placement;
+
+		const Mesh_Lod& lod = entry.mesh->lod(0);
+		commands[i] = {lod.index_count, 1, range.first_index + lod.first_index,
+					   static_cast<int32_t>(range.first_vertex), static_cast<uint32_t>(i)};
+		draw_data[i] = {entry.transform,
+						glm::vec4(bounds.min, 0.0f),
+						glm::vec4(bounds.extent, 0.0f),
+						placement ? placement->layer : Texture_Atlas::NO_LAYER,
+						0,
+						glm::uvec2(static_cast<uint32_t>(diffuse.handle), static_cast<uint32_t>(diffuse.handle >> 32)),
+						placement ? glm::vec4(placement->offset, placement->scale) : glm::vec4(0.0f, 0.0f, 1.0f, 1.0f)};
+
+		bool same_batch = !m_batches.empty() && m_batches.back().format == entry.mesh->format() &&
+						  entry_materials[order[i - 1]] == material;
+		if (same_batch) {
+			m_batches.back().command_count++;
+		} else {
+			m_batches.push_back({entry.mesh->format(), entry.mesh, placement ? placement->array : NO_ARRAY,
+								 diffuse.handle, i, 1});
+		}
+	}
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_command_buffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(Draw_Elements_Indirect_Command), commands.data(),
+				 GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_draw_data_buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, draw_data.size() * sizeof(Draw_Data), draw_data.data(), GL_DYNAMIC_DRAW);
+
+	// the draw id buffer is just 0..n-1 and only ever grows
+	if (m_draw_id_capacity < m_entries.size()) {
+		m_draw_id_capacity = std::max(m_entries.size(), m_draw_id_capacity * 2);
+		std::vector<uint32_t> draw_ids(m_draw_id_capacity);
+		std::iota(draw_ids.begin(), draw_ids.end(), 0u);
+		glBindBuffer(GL_ARRAY_BUFFER, m_draw_id_buffer);
+		glBufferData(GL_ARRAY_BUFFER, draw_ids.size() * sizeof(uint32_t), draw_ids.data(), GL_STATIC_DRAW);
+	}
+
+	m_built_entries = m_entries;
+	m_built_atlas_generation = m_atlas ? m_atlas->generation() : 0;
+	for (const Batch& batch : m_batches) {
+		m_built_generations[static_cast<size_t>(batch.format)] = Geometry_Arena::get(batch.format).generation();
+	}
+}
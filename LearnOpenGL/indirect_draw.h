@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "model.h"
+#include "shader_program.h"
+#include "texture_atlas.h"
+
+// layout mandated by glMultiDrawElementsIndirect
+struct Draw_Elements_Indirect_Command {
+	uint32_t count;
+	uint32_t instance_count;
+	uint32_t first_index;
+	int32_t base_vertex;
+	uint32_t base_instance;
+};
+
+// per-draw data as read by shaders/model_indirect.vert (std430)
+struct Draw_Data {
+	glm::mat4 model;
+	glm::vec4 bounds_min;
+	glm::vec4 bounds_extent;
+	// the layer of the first diffuse texture in the list's Texture_Atlas, Texture_Atlas::NO_LAYER if it isn't packed
+	uint32_t diffuse_layer;
+	// std430 aligns the uvec2 to 8 bytes
+	uint32_t padding;
+	// its bindless handle split into low and high bits, 0 if it is sampled from the atlas or bound
+	glm::uvec2 diffuse_handle;
+	// offset in .xy, scale in .zw
+	glm::vec4 diffuse_uv_transform;
+};
+static_assert(sizeof(Draw_Data) == 128);
+
+// Submits whole models or scenes with one glMultiDrawElementsIndirect per vertex format and material.
+//
+// The command and per-draw buffers are only rebuilt when the set of meshes or their transforms change, or the
+// geometry arena moved them. Each command's base_instance is its draw index, which reaches the shader through an
+// instanced uint attribute at location 3 (gl_DrawID would need GL 4.6), and the shader reads its transform, vertex
+// quantization bounds and diffuse texture source from a storage buffer at binding 0.
+//
+// Nothing the shader fetches per draw is dynamically uniform before GL 4.6, so it can't pick a texture with it: not by
+// indexing a sampler array, and not by turning a bindless handle into a sampler either, unless NV_gpu_shader5 allows
+// that (see Bindless_Textures::divergent_handles()). So draws are grouped so each group shares a material and only
+// one set of textures is bound per glMultiDrawElementsIndirect call; a model with a single material is one call. Where
+// bindless textures are supported, meshes with a diffuse texture handle (see Mesh::diffuse_texture_handle()) bind
+// nothing, which is all shaders/model_indirect.frag samples. With divergent handles they all share one call and the
+// shader reads each draw's handle out of the draw data; otherwise they are grouped by handle, which is set on a
+// bindless sampler uniform per call. Without bindless textures but with a Texture_Atlas set, meshes whose first
+// diffuse texture was packed are grouped by the array it went to, and the shader picks the layer and uv transform
+// out of the draw data. Layer and transform only feed texture coordinates, which don't have to be uniform.
+class Indirect_Draw_List {
+   public:
+	Indirect_Draw_List() = default;
+	Indirect_Draw_List(const Indirect_Draw_List&) = delete;
+	Indirect_Draw_List& operator=(const Indirect_Draw_List&) = delete;
+	~Indirect_Draw_List();
+
+	// needs GL 4.3 for multi-draw indirect and storage buffers
+	static bool supported();
+
+	// the list is meant to be refilled every frame, submit() works out whether anything actually changed
+	void clear();
+	void add(const Mesh& mesh, const glm::mat4& transform);
+	// uses the node transforms as of the model's last update_transforms() or draw()
+	void add(const Model& model, const glm::mat4& transform);
+	// Samples packed diffuse textures out of `atlas`, which has to outlive the list or be replaced first. The list is
+	// rebuilt whenever the atlas is. nullptr binds every mesh's own textures again.
+	void set_atlas(const Texture_Atlas* atlas);
+
+	void submit(Shader_Program& shader);
+
+	size_t draw_count() const { return m_entries.size(); }
+	// glMultiDrawElementsIndirect calls made by the last submit
+	size_t batch_count() const { return m_batches.size(); }
+
+   private:
+	static constexpr uint32_t NO_ARRAY = UINT32_MAX;
+
+	struct Entry {
+		const Mesh* mesh;
+		glm::mat4 transform;
+
+		bool operator==(const Entry& other) const = default;
+	};
+
+	struct Batch {
+		Vertex_Format format;
+		const Mesh* material_source;
+		// index into the atlas' arrays, NO_ARRAY if the batch samples its own diffuse texture
+		uint32_t atlas_array;
+		// if not 0 the diffuse textures are reached through handles and nothing is bound; without
+		// Bindless_Textures::divergent_handles() it is the one handle every draw of the batch uses
+		GLuint64 diffuse_handle;
+		size_t first_command;
+		size_t command_count;
+	};
+
+	std::vector<Entry> m_entries;
+	std::vector<Entry> m_built_entries;
+	// indexed by Vertex_Format
+	uint64_t m_built_generations[2] = {UINT64_MAX, UINT64_MAX};
+	std::vector<Batch> m_batches;
+	const Texture_Atlas* m_atlas = nullptr;
+	uint64_t m_built_atlas_generation = 0;
+
+	// the program submit() resolved its uniforms against last
+	GLuint m_program = 0;
+	Uniform<bool> m_packed_vertices;
+	// shaders/model_indirect.frag only declares it without divergent handles
+	Uniform<GLint> m_batch_diffuse;
+
+	GLuint m_command_buffer = 0;
+	GLuint m_draw_data_buffer = 0;
+	GLuint m_draw_id_buffer = 0;
+	size_t m_draw_id_capacity = 0;
+
+	bool is_stale() const;
+	void rebuild();
+};
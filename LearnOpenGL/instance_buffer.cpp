@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+
+#include "instance_buffer.h"
+
+// the model matrix takes 4-7 and the normal matrix 8-10, clear of the per-vertex and draw id attributes
+static constexpr GLuint MODEL_ATTRIBUTE = 4;
+static constexpr GLuint NORMAL_ATTRIBUTE = 8;
+
+Instance_Buffer::Instance_Buffer(Instance_Buffer&& other) noexcept {
+	*this = std::move(other);
+}
+
+Instance_Buffer& Instance_Buffer::operator=(Instance_Buffer&& other) noexcept {
+	if (this != &other) {
+		if (m_buffer != 0) {
+			glDeleteBuffers(1, &m_buffer);
+		}
+		m_buffer = std::exchange(other.m_buffer, 0);
+		m_capacity = std::exchange(other.m_capacity, 0);
+		m_size = std::exchange(other.m_size, 0);
+		m_staging = std::move(other.m_staging);
+	}
+
+	return *this;
+}
+
+Instance_Buffer::~Instance_Buffer() {
+	if (m_buffer != 0) {
+		glDeleteBuffers(1, &m_buffer);
+	}
+}
+
+void Instance_Buffer::update(std::span<const glm::mat4> transforms) {
+	if (m_buffer == 0) {
+		glGenBuffers(1, &m_buffer);
+	}
+
+	m_staging.resize(transforms.size());
+	for (size_t i = 0; i < transforms.size(); i++) {
+		glm::mat3 normal = glm::transpose(glm::inverse(glm::mat3(transforms[i])));
+		m_staging[i].model = transforms[i];
+		m_staging[i].normal[0] = glm::vec4(normal[0], 0.0f);
+		m_staging[i].normal[1] = glm::vec4(normal[1], 0.0f);
+		m_staging[i].normal[2] = glm::vec4(normal[2], 0.0f);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+	if (transforms.size() > m_capacity) {
+		m_capacity = std::max(transforms.size(), m_capacity * 2);
+	}
+	// orphan, then fill, so the driver can hand out fresh storage while earlier draws still read the old one
+	glBufferData(GL_ARRAY_BUFFER, m_capacity * sizeof(Instance_Data), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, m_staging.size() * sizeof(Instance_Data), m_staging.data());
+	m_size = transforms.size();
+}
+
+void Instance_Buffer::enable_attributes() const {
+	glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+	GLsizei stride = sizeof(Instance_Data);
+
+	for (GLuint column = 0; column < 4; column++) {
+		GLuint attribute = MODEL_ATTRIBUTE + column;
+		glEnableVertexAttribArray(attribute);
+		glVertexAttribPointer(attribute, 4, GL_FLOAT, GL_FALSE, stride,
+							  (void*)(offsetof(Instance_Data, model) + column * sizeof(glm::vec4)));
+		glVertexAttribDivisor(attribute, 1);
+	}
+
+	for (GLuint column = 0; column < 3; column++) {
+		GLuint attribute = NORMAL_ATTRIBUTE + column;
+		glEnableVertexAttribArray(attribute);
+		glVertexAttribPointer(attribute, 3, GL_FLOAT, GL_FALSE, stride,
+							  (void*)(offsetof(Instance_Data, normal) + column * sizeof(glm::vec4)));
+		glVertexAttribDivisor(attribute, 1);
+	}
+}
+
+void Instance_Buffer::disable_attributes() {
+	for (GLuint attribute = MODEL_ATTRIBUTE; attribute < NORMAL_ATTRIBUTE + 3; attribute++) {
+		glDisableVertexAttribArray(attribute);
+	}
+}
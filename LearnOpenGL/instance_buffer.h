@@ -0,0 +1,41 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// per-instance vertex attributes as read by shaders/model_instanced.vert
+struct Instance_Data {
+	glm::mat4 model;
+	// columns of the normal matrix, padded to vec4 to keep the attributes aligned
+	glm::vec4 normal[3];
+};
+
+// Streams per-instance transforms into a vertex buffer that is read with a divisor of 1, which works on the base
+// GL 3.3 context (an SSBO would need 4.3). The buffer is orphaned on every update and only grows, so refilling it
+// each frame neither stalls on the previous frame's draws nor allocates.
+class Instance_Buffer {
+   public:
+	Instance_Buffer() = default;
+	Instance_Buffer(const Instance_Buffer&) = delete;
+	Instance_Buffer& operator=(const Instance_Buffer&) = delete;
+	Instance_Buffer(Instance_Buffer&& other) noexcept;
+	Instance_Buffer& operator=(Instance_Buffer&& other) noexcept;
+	~Instance_Buffer();
+
+	// computes the normal matrices and uploads everything
+	void update(std::span<const glm::mat4> transforms);
+	size_t size() const { return m_size; }
+
+	// points attributes 4-10 of the currently bound VAO at this buffer, and turns them off again
+	void enable_attributes() const;
+	static void disable_attributes();
+
+   private:
+	GLuint m_buffer = 0;
+	size_t m_capacity = 0;
+	size_t m_size = 0;
+	std::vector<Instance_Data> m_staging;
+};
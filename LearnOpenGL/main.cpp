@@ -1,6 +1,7 @@
 ﻿#include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <glm/glm.hpp>
@@ -9,14 +10,19 @@
 #include <iostream>
 #include <string>
 
+#include "bindless_textures.h"
 #include "camera.h"
 #include "config.h"
+#include "environment_map.h"
+#include "frame_stats.h"
 #include "fs_util.h"
 #include "model.h"
+#include "pixel_buffer_ring.h"
 #include "shader_program.h"
+#include "texture_registry.h"
+#include "texture_streamer.h"
+#include "upload_queue.h"
 
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
 #include <map>
 
 static auto camera = Camera(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
@@ -85,6 +91,12 @@ static void scroll_callback(GLFWwindow* window, double x_offset, double y_offset
 }
 
 int main() {
+	using Clock = std::chrono::steady_clock;
+	auto elapsed_ms = [](Clock::time_point since) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+	};
+	auto startup = Clock::now();
+
 #pragma region init
 	if (!glfwInit()) {
 		std::cerr << "failed to initialize GLFW" << std::endl;
@@ -120,6 +132,7 @@ int main() {
 		std::cout << "failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	Bindless_Textures::load((GLADloadproc)glfwGetProcAddress);
 
 	if constexpr (constants::DEBUG) {
 		glfwSetErrorCallback(glfw_error_callback);
@@ -130,6 +143,8 @@ int main() {
 	}
 
 	glEnable(GL_DEPTH_TEST);
+	// the prefiltered levels of the environment map are small enough that per-face filtering would show the seams
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
 	if (constants::WIREFRAME) {
 		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -137,24 +152,62 @@ int main() {
 
 	glViewport(0, 0, constants::WINDOW_WIDTH, constants::WINDOW_HEIGHT);
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+	double init_ms = elapsed_ms(startup);
 #pragma endregion
 
 #pragma region shader
+	auto shader_start = Clock::now();
 	std::string object_vertex_shader = fs_util::read_file(constants::SHADER_PATH / "object.vert");
 	std::string object_fragment_shader = fs_util::read_file(constants::SHADER_PATH / "object.frag");
 	Shader_Program object_shader = Shader_Program(object_vertex_shader, object_fragment_shader);
 	std::string skybox_vertex_shader = fs_util::read_file(constants::SHADER_PATH / "skybox.vert");
 	std::string skybox_fragment_shader = fs_util::read_file(constants::SHADER_PATH / "skybox.frag");
 	Shader_Program skybox_shader = Shader_Program(skybox_vertex_shader, skybox_fragment_shader);
+	double shader_ms = elapsed_ms(shader_start);
 #pragma endregion
 
 #pragma region models
-	Cubemap skybox_cubemap = Cubemap({constants::ASSET_PATH / "textures" / "skybox" / "right.jpg",
-									  constants::ASSET_PATH / "textures" / "skybox" / "left.jpg",
-									  constants::ASSET_PATH / "textures" / "skybox" / "top.jpg",
-									  constants::ASSET_PATH / "textures" / "skybox" / "bottom.jpg",
-									  constants::ASSET_PATH / "textures" / "skybox" / "front.jpg",
-									  constants::ASSET_PATH / "textures" / "skybox" / "back.jpg"});
+	auto models_start = Clock::now();
+	environment_map::Environment_Map environment;
+	if (std::filesystem::exists(constants::ENVIRONMENT_MAP_PATH)) {
+		environment = environment_map::load(constants::ENVIRONMENT_MAP_PATH);
+	}
+	Cubemap skybox_cubemap = environment ? environment.cubemap
+										 : Cubemap({constants::ASSET_PATH / "textures" / "skybox" / "right.jpg",
+													constants::ASSET_PATH / "textures" / "skybox" / "left.jpg",
+													constants::ASSET_PATH / "textures" / "skybox" / "top.jpg",
+													constants::ASSET_PATH / "textures" / "skybox" / "bottom.jpg",
+													constants::ASSET_PATH / "textures" / "skybox" / "front.jpg",
+													constants::ASSET_PATH / "textures" / "skybox" / "back.jpg"});
+	// the glass cube is only frosted when there are prefiltered levels and an irradiance to scatter
+	object_shader.use();
+	object_shader.set_float("roughness", environment ? 0.25f : 0.0f);
+	object_shader.set_float("maxLod", environment ? static_cast<float>(environment_map::LEVELS - 1) : 0.0f);
+	object_shader.set_float("exposure", environment ? 1.0f : 0.0f);
+	for (size_t i = 0; i < environment.irradiance.size(); i++) {
+		object_shader.set_vec3("irradianceSH[" + std::to_string(i) + "]", environment.irradiance[i]);
+	}
+	skybox_shader.use();
+	skybox_shader.set_float("exposure", environment ? 1.0f : 0.0f);
+	// with bindless textures the skybox samplers are set once here instead of bound every frame
+	bool bindless = Bindless_Textures::supported();
+	if (bindless) {
+		GLuint64 skybox_handle = skybox_cubemap.resident_handle();
+		object_shader.use();
+		object_shader.set_texture_handle("skybox", skybox_handle);
+		skybox_shader.use();
+		skybox_shader.set_texture_handle("skybox", skybox_handle);
+	}
+	// resolved once, so the render loop sets them without a lookup
+	Uniform<glm::mat4> object_model = object_shader.uniform<glm::mat4>("model");
+	Uniform<glm::mat4> object_view = object_shader.uniform<glm::mat4>("view");
+	Uniform<glm::mat4> object_projection = object_shader.uniform<glm::mat4>("projection");
+	Uniform<glm::vec3> object_camera_pos = object_shader.uniform<glm::vec3>("cameraPos");
+	Uniform<GLint> object_skybox = object_shader.uniform<GLint>("skybox");
+	Uniform<glm::mat4> skybox_view = skybox_shader.uniform<glm::mat4>("view");
+	Uniform<glm::mat4> skybox_projection = skybox_shader.uniform<glm::mat4>("projection");
+	Uniform<GLint> skybox_skybox = skybox_shader.uniform<GLint>("skybox");
+	double models_ms = elapsed_ms(models_start);
 #pragma endregion
 
 #pragma region static_data
@@ -272,6 +325,12 @@ int main() {
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 	glBindVertexArray(0);
+
+	// texture decode/upload splits are logged by the loaders themselves
+	if constexpr (constants::DEBUG) {
+		std::cout << "STARTUP init " << init_ms << " ms, shaders " << shader_ms << " ms, models " << models_ms
+				  << " ms, total " << elapsed_ms(startup) << " ms" << std::endl;
+	}
 #pragma endregion
 
 #pragma region loop
@@ -281,9 +340,17 @@ int main() {
 		float time = static_cast<float>(glfwGetTime());
 		float delta_time = time - last_frame;
 		last_frame = time;
+		frame_stats::begin_frame();
 
 		process_input(window, delta_time);
 
+		// finish whatever background loads have handed over, without letting them eat the frame
+		Upload_Queue::shared().drain(std::chrono::duration<double, std::milli>(constants::UPLOAD_BUDGET_MS));
+		Pixel_Buffer_Ring::shared().retire();
+		// last frame's draws said which mips they need
+		Texture_Streamer::shared().update();
+		Texture_Registry::shared().delete_evicted();
+
 		glm::mat4 view = camera.calculate_view_matrix();
 		glm::mat4 projection = camera.calculate_projection_matrix();
 
@@ -293,12 +360,16 @@ int main() {
 		// cube
 		object_shader.use();
 		glm::mat4 model = glm::mat4(1.0f);
-		object_shader.set_mat4("model", model);
-		object_shader.set_mat4("view", view);
-		object_shader.set_mat4("projection", projection);
+		object_shader.set_mat4(object_model, model);
+		object_shader.set_mat4(object_view, view);
+		object_shader.set_mat4(object_projection, projection);
 
-		object_shader.set_vec3("cameraPos", camera.pos);
-		object_shader.set_cubemap("skybox", skybox_cubemap, 0);
+		object_shader.set_vec3(object_camera_pos, camera.pos);
+		if (bindless) {
+			frame_stats::current().bindless_textures++;
+		} else {
+			object_shader.set_cubemap(object_skybox, skybox_cubemap, 0);
+		}
 
 		glBindVertexArray(cube_vao);
 		glDrawArrays(GL_TRIANGLES, 0, 36);
@@ -306,10 +377,14 @@ int main() {
 		// skybox
 		glDepthFunc(GL_LEQUAL);
 		skybox_shader.use();
-		skybox_shader.set_mat4("view", glm::mat4(glm::mat3(view)));
-		skybox_shader.set_mat4("projection", projection);
+		skybox_shader.set_mat4(skybox_view, glm::mat4(glm::mat3(view)));
+		skybox_shader.set_mat4(skybox_projection, projection);
 
-		skybox_shader.set_cubemap("skybox", skybox_cubemap, 0);
+		if (bindless) {
+			frame_stats::current().bindless_textures++;
+		} else {
+			skybox_shader.set_cubemap(skybox_skybox, skybox_cubemap, 0);
+		}
 
 		glBindVertexArray(skybox_vao);
 		glDrawArrays(GL_TRIANGLES, 0, 36);
@@ -317,6 +392,8 @@ int main() {
 
 		glBindVertexArray(0);
 
+		frame_stats::end_frame(delta_time);
+
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
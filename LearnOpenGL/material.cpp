@@ -0,0 +1,54 @@
+#include <string>
+
+#include "frame_stats.h"
+#include "material.h"
+
+void Material_Bindings::apply(const Shader_Program& shader, std::span<const Material_Texture> textures) const {
+	const Program_Table* table = nullptr;
+	for (const Program_Table& candidate : m_tables) {
+		if (candidate.program == shader.id) {
+			table = &candidate;
+			break;
+		}
+	}
+	if (!table) {
+		table = &resolve(shader, textures);
+	}
+
+	for (const Texture_Binding& binding : table->bindings) {
+		glActiveTexture(GL_TEXTURE0 + binding.unit);
+		glBindTexture(GL_TEXTURE_2D, binding.texture);
+		glUniform1i(binding.location, binding.unit);
+	}
+	glActiveTexture(GL_TEXTURE0);
+
+	frame_stats::current().texture_binds += table->bindings.size();
+}
+
+const Material_Bindings::Program_Table& Material_Bindings::resolve(const Shader_Program& shader,
+																	 std::span<const Material_Texture> textures) const {
+	Program_Table& table = m_tables.emplace_back();
+	table.program = shader.id;
+
+	Texture_Registry& registry = Texture_Registry::shared();
+	unsigned int curr_diffuse = 1;
+	for (size_t i = 0; i < textures.size(); i++) {
+		const Material_Texture& texture = textures[i];
+
+		std::string number;
+		if (texture.type == "texture_diffuse") {
+			number = std::to_string(curr_diffuse++);
+		} else if (texture.type == "texture_specular") {
+			continue;
+		}
+
+		// samplers the shader doesn't use are simply left out
+		std::string uniform_name = "material." + texture.type + number;
+		GLint location = shader.find_uniform_location(uniform_name);
+		if (location != -1) {
+			table.bindings.push_back({location, static_cast<GLint>(i), registry.get(texture.handle).id});
+		}
+	}
+
+	return table;
+}
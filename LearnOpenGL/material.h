@@ -0,0 +1,42 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "shader_program.h"
+#include "texture_registry.h"
+
+// a registry texture in one of a mesh's material slots (`type`, e.g. "texture_diffuse"); the mesh holds the reference
+struct Material_Texture {
+	Texture_Registry::Handle handle = Texture_Registry::INVALID_HANDLE;
+	std::string type;
+};
+
+struct Texture_Binding {
+	GLint location;
+	GLint unit;
+	GLuint texture;
+};
+
+// A mesh's textures resolved against a shader program into (location, unit, texture) triples.
+//
+// The table for a program is built the first time the material is bound with it, after which binding it does no
+// uniform name building, no glGetUniformLocation and no heap allocation.
+class Material_Bindings {
+   public:
+	void apply(const Shader_Program& shader, std::span<const Material_Texture> textures) const;
+
+   private:
+	struct Program_Table {
+		GLuint program;
+		std::vector<Texture_Binding> bindings;
+	};
+
+	// a mesh is rarely drawn with more than a couple of programs, so a linear search beats a map
+	mutable std::vector<Program_Table> m_tables;
+
+	const Program_Table& resolve(const Shader_Program& shader, std::span<const Material_Texture> textures) const;
+};
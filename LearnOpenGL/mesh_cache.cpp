@@ -0,0 +1,324 @@
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+#include "config.h"
+#include "mesh_cache.h"
+
+namespace {
+
+constexpr char MAGIC[8] = {'L', 'O', 'G', 'L', 'M', 'E', 'S', 'H'};
+constexpr uint64_t SECTION_ALIGNMENT = 16;
+
+struct File_Header {
+	char magic[8];
+	uint32_t version;
+	uint32_t import_flags;
+	uint64_t source_hash;
+	uint64_t source_size;
+	int64_t source_write_time;
+	uint64_t mesh_count;
+	uint64_t node_offset;
+	uint64_t node_count;
+};
+
+struct Mesh_Record {
+	uint64_t vertex_offset;
+	uint64_t vertex_count;
+	uint64_t index_offset;
+	uint64_t index_count;
+	uint64_t lod_offset;
+	uint64_t lod_count;
+	uint64_t meshlet_offset;
+	uint64_t meshlet_count;
+	uint64_t texture_offset;
+	uint64_t texture_count;
+	uint64_t node;
+	uint64_t two_sided;
+};
+
+// nodes are stored parent first, each record is followed by the node's name
+struct Node_Record {
+	uint32_t parent;
+	uint32_t name_length;
+	float local[16];
+};
+
+// texture references are stored as a pair of lengths followed by the path and type characters
+struct Texture_Record {
+	uint32_t path_length;
+	uint32_t type_length;
+};
+
+uint64_t align_up(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+// `count` elements of `element_size` bytes each, divided rather than multiplied so a corrupt count can't wrap around
+bool in_bounds(std::span<const std::byte> file, uint64_t offset, uint64_t count, uint64_t element_size = 1) {
+	return offset <= file.size() && count <= (file.size() - offset) / element_size;
+}
+
+int64_t write_time(const std::filesystem::path& path, std::error_code& error) {
+	return std::filesystem::last_write_time(path, error).time_since_epoch().count();
+}
+
+}
+
+std::filesystem::path mesh_cache::path_for(const std::filesystem::path& source) {
+	std::string key = std::filesystem::absolute(source).generic_string();
+	uint64_t key_hash = fs_util::hash_bytes(std::as_bytes(std::span(key)));
+
+	std::stringstream name;
+	name << source.stem().string() << "-" << std::hex << std::setw(16) << std::setfill('0') << key_hash << ".mesh";
+	return constants::CACHE_PATH / "meshes" / name.str();
+}
+
+std::optional<mesh_cache::Cache_File> mesh_cache::Cache_File::open(const std::filesystem::path& source,
+																	 uint32_t import_flags) {
+	Cache_File cache;
+	if (!cache.m_file.open(path_for(source))) {
+		return std::nullopt;
+	}
+
+	std::span<const std::byte> file = cache.m_file.bytes();
+	if (file.size() < sizeof(File_Header)) {
+		return std::nullopt;
+	}
+
+	File_Header header;
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+		header.import_flags != import_flags) {
+		return std::nullopt;
+	}
+
+	// an untouched source keeps its size and write time, only a touched one is hashed to tell an edit from a copy
+	std::error_code error;
+	uint64_t source_size = std::filesystem::file_size(source, error);
+	if (error || source_size != header.source_size) {
+		return std::nullopt;
+	}
+	int64_t source_write_time = write_time(source, error);
+	if (error ||
+		(source_write_time != header.source_write_time && fs_util::hash_file(source) != header.source_hash)) {
+		return std::nullopt;
+	}
+
+	// both counts are checked before anything is reserved for them
+	if (!in_bounds(file, sizeof(File_Header), header.mesh_count, sizeof(Mesh_Record)) ||
+		!in_bounds(file, header.node_offset, header.node_count, sizeof(Node_Record))) {
+		return std::nullopt;
+	}
+
+	cache.meshes.reserve(header.mesh_count);
+	for (uint64_t i = 0; i < header.mesh_count; i++) {
+		Mesh_Record record;
+		std::memcpy(&record, file.data() + sizeof(File_Header) + i * sizeof(Mesh_Record), sizeof(record));
+
+		if (!in_bounds(file, record.vertex_offset, record.vertex_count, sizeof(Vertex)) ||
+			!in_bounds(file, record.index_offset, record.index_count, sizeof(unsigned int)) ||
+			!in_bounds(file, record.lod_offset, record.lod_count, sizeof(Mesh_Lod)) ||
+			record.lod_offset % alignof(Mesh_Lod) != 0 ||
+			!in_bounds(file, record.meshlet_offset, record.meshlet_count, sizeof(Meshlet)) ||
+			record.meshlet_offset % alignof(Meshlet) != 0 ||
+			record.vertex_offset % alignof(Vertex) != 0 || record.index_offset % alignof(unsigned int) != 0 ||
+			record.node >= header.node_count) {
+			return std::nullopt;
+		}
+
+		Mesh_View view;
+		view.vertices = {reinterpret_cast<const Vertex*>(file.data() + record.vertex_offset), record.vertex_count};
+		view.indices = {reinterpret_cast<const unsigned int*>(file.data() + record.index_offset), record.index_count};
+		view.lods = {reinterpret_cast<const Mesh_Lod*>(file.data() + record.lod_offset), record.lod_count};
+		view.meshlets = {reinterpret_cast<const Meshlet*>(file.data() + record.meshlet_offset), record.meshlet_count};
+		view.node = static_cast<Scene_Graph::Node>(record.node);
+		view.two_sided = record.two_sided != 0;
+		for (const Mesh_Lod& lod : view.lods) {
+			if (uint64_t(lod.first_index) + lod.index_count > record.index_count) {
+				return std::nullopt;
+			}
+		}
+		for (const Meshlet& meshlet : view.meshlets) {
+			if (uint64_t(meshlet.first_index) + meshlet.index_count > record.index_count) {
+				return std::nullopt;
+			}
+		}
+
+		uint64_t offset = record.texture_offset;
+		// every texture takes at least its record, which bounds the count before anything is pushed for it
+		if (!in_bounds(file, offset, record.texture_count, sizeof(Texture_Record))) {
+			return std::nullopt;
+		}
+		for (uint64_t j = 0; j < record.texture_count; j++) {
+			Texture_Record texture;
+			if (!in_bounds(file, offset, sizeof(texture))) {
+				return std::nullopt;
+			}
+			std::memcpy(&texture, file.data() + offset, sizeof(texture));
+			offset += sizeof(texture);
+
+			if (!in_bounds(file, offset, uint64_t(texture.path_length) + texture.type_length)) {
+				return std::nullopt;
+			}
+			const char* chars = reinterpret_cast<const char*>(file.data() + offset);
+			view.textures.push_back({std::string(chars, texture.path_length),
+									 std::string(chars + texture.path_length, texture.type_length)});
+			offset += texture.path_length + texture.type_length;
+		}
+
+		cache.meshes.push_back(std::move(view));
+	}
+
+	cache.scene_graph.reserve(header.node_count);
+	uint64_t offset = header.node_offset;
+	for (uint64_t i = 0; i < header.node_count; i++) {
+		Node_Record node;
+		if (!in_bounds(file, offset, sizeof(node))) {
+			return std::nullopt;
+		}
+		std::memcpy(&node, file.data() + offset, sizeof(node));
+		offset += sizeof(node);
+
+		bool parent_first = node.parent == Scene_Graph::INVALID_NODE || node.parent < i;
+		if (!in_bounds(file, offset, node.name_length) || !parent_first) {
+			return std::nullopt;
+		}
+		glm::mat4 local;
+		std::memcpy(&local[0][0], node.local, sizeof(node.local));
+		cache.scene_graph.add_node(node.parent, local,
+								   std::string(reinterpret_cast<const char*>(file.data() + offset), node.name_length));
+		offset += node.name_length;
+	}
+	cache.scene_graph.update();
+
+	return cache;
+}
+
+bool mesh_cache::write(const std::filesystem::path& source,
+					   uint32_t import_flags,
+					   std::span<const Mesh_Data> meshes,
+					   const Scene_Graph& scene_graph) {
+	std::error_code error;
+	File_Header header{};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.import_flags = import_flags;
+	header.source_size = std::filesystem::file_size(source, error);
+	if (error) {
+		return false;
+	}
+	header.source_write_time = write_time(source, error);
+	if (error) {
+		return false;
+	}
+	header.source_hash = fs_util::hash_file(source);
+	header.mesh_count = meshes.size();
+	header.node_count = scene_graph.size();
+
+	// lay out every section up front so the mesh table can be written in one go
+	std::vector<Mesh_Record> records(meshes.size());
+	uint64_t offset = sizeof(File_Header) + meshes.size() * sizeof(Mesh_Record);
+	for (size_t i = 0; i < meshes.size(); i++) {
+		const Mesh_Data& mesh = meshes[i];
+		Mesh_Record& record = records[i];
+
+		record.vertex_offset = offset = align_up(offset, SECTION_ALIGNMENT);
+		record.vertex_count = mesh.vertices.size();
+		offset += mesh.vertices.size() * sizeof(Vertex);
+
+		record.index_offset = offset = align_up(offset, SECTION_ALIGNMENT);
+		record.index_count = mesh.indices.size();
+		offset += mesh.indices.size() * sizeof(unsigned int);
+
+		record.lod_offset = offset = align_up(offset, SECTION_ALIGNMENT);
+		record.lod_count = mesh.lods.size();
+		offset += mesh.lods.size() * sizeof(Mesh_Lod);
+
+		record.meshlet_offset = offset = align_up(offset, SECTION_ALIGNMENT);
+		record.meshlet_count = mesh.meshlets.size();
+		offset += mesh.meshlets.size() * sizeof(Meshlet);
+
+		record.texture_offset = offset;
+		record.texture_count = mesh.textures.size();
+		for (const Texture_Ref& texture : mesh.textures) {
+			offset += sizeof(Texture_Record) + texture.path.size() + texture.type.size();
+		}
+
+		record.node = mesh.node;
+		record.two_sided = mesh.two_sided;
+	}
+	header.node_offset = offset;
+
+	std::filesystem::path path = path_for(source);
+	std::filesystem::create_directories(path.parent_path(), error);
+	std::filesystem::path temp_path = path;
+	temp_path += ".tmp";
+
+	{
+		std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			std::cerr << "WARNING: could not write mesh cache '" << temp_path << "'" << std::endl;
+			return false;
+		}
+
+		auto write_bytes = [&file](const void* data, size_t size) {
+			file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+		};
+		auto pad_to = [&file](uint64_t target) {
+			while (static_cast<uint64_t>(file.tellp()) < target) {
+				file.put('\0');
+			}
+		};
+
+		write_bytes(&header, sizeof(header));
+		write_bytes(records.data(), records.size() * sizeof(Mesh_Record));
+		for (size_t i = 0; i < meshes.size(); i++) {
+			const Mesh_Data& mesh = meshes[i];
+
+			pad_to(records[i].vertex_offset);
+			write_bytes(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+			pad_to(records[i].index_offset);
+			write_bytes(mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+			pad_to(records[i].lod_offset);
+			write_bytes(mesh.lods.data(), mesh.lods.size() * sizeof(Mesh_Lod));
+			pad_to(records[i].meshlet_offset);
+			write_bytes(mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet));
+
+			for (const Texture_Ref& texture : mesh.textures) {
+				Texture_Record texture_record{static_cast<uint32_t>(texture.path.size()),
+											  static_cast<uint32_t>(texture.type.size())};
+				write_bytes(&texture_record, sizeof(texture_record));
+				write_bytes(texture.path.data(), texture.path.size());
+				write_bytes(texture.type.data(), texture.type.size());
+			}
+		}
+
+		for (Scene_Graph::Node node = 0; node < scene_graph.size(); node++) {
+			Node_Record node_record{};
+			node_record.parent = scene_graph.parent(node);
+			node_record.name_length = static_cast<uint32_t>(scene_graph.name(node).size());
+			std::memcpy(node_record.local, &scene_graph.local(node)[0][0], sizeof(node_record.local));
+			write_bytes(&node_record, sizeof(node_record));
+			write_bytes(scene_graph.name(node).data(), scene_graph.name(node).size());
+		}
+
+		if (!file) {
+			std::cerr << "WARNING: could not write mesh cache '" << temp_path << "'" << std::endl;
+			return false;
+		}
+	}
+
+	// rename last so a crash mid-write never leaves a truncated cache behind
+	std::filesystem::rename(temp_path, path, error);
+	if (error) {
+		std::filesystem::remove(temp_path, error);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "fs_util.h"
+#include "model.h"
+#include "scene_graph.h"
+
+// On-disk cache of imported meshes so warm loads can skip Assimp entirely.
+//
+// A cache file is keyed by the hash of the source file's contents plus the import flags it was built with, and
+// stores every mesh's vertex and index arrays in a layout that can be used directly from a memory mapping, followed
+// by the node hierarchy. All values are in native byte order; the cache is a local build artifact and is never
+// shipped. The source's size and write time are stored too, so a warm open only hashes a source that was touched.
+namespace mesh_cache {
+
+// bump whenever the layout of the file, the contents of Vertex or the import pipeline's output change
+constexpr uint32_t VERSION = 8;
+
+struct Mesh_View {
+	std::span<const Vertex> vertices;
+	std::span<const unsigned int> indices;
+	std::span<const Mesh_Lod> lods;
+	std::span<const Meshlet> meshlets;
+	std::vector<Texture_Ref> textures;
+	bool two_sided = false;
+	Scene_Graph::Node node = 0;
+};
+
+// a validated, mapped cache file; the views stay valid for as long as the Cache_File is alive
+class Cache_File {
+   public:
+	std::vector<Mesh_View> meshes;
+	Scene_Graph scene_graph;
+
+	// returns nothing if there is no cache for `source`, or it is stale or corrupt
+	static std::optional<Cache_File> open(const std::filesystem::path& source, uint32_t import_flags);
+
+   private:
+	fs_util::Mapped_File m_file;
+};
+
+// where the cache for `source` is written, whether or not it exists yet
+std::filesystem::path path_for(const std::filesystem::path& source);
+
+// returns false if the cache couldn't be written, which is never fatal
+bool write(const std::filesystem::path& source,
+		   uint32_t import_flags,
+		   std::span<const Mesh_Data> meshes,
+		   const Scene_Graph& scene_graph);
+
+}
@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+#include "fs_util.h"
+#include "mesh_optimizer.h"
+
+namespace {
+
+constexpr unsigned int UNUSED = std::numeric_limits<unsigned int>::max();
+
+// FIFO post-transform cache simulation: a vertex is a hit if it was transformed less than `cache_size` misses ago
+class Fifo_Cache {
+   public:
+	Fifo_Cache(size_t vertex_count, size_t cache_size)
+		: m_timestamps(vertex_count, 0), m_cache_size(cache_size), m_time(cache_size + 1) {}
+
+	// returns true on a miss
+	bool access(unsigned int vertex) {
+		if (m_time - m_timestamps[vertex] > m_cache_size) {
+			m_timestamps[vertex] = m_time++;
+			return true;
+		}
+
+		return false;
+	}
+
+   private:
+	std::vector<size_t> m_timestamps;
+	size_t m_cache_size;
+	size_t m_time;
+};
+
+struct Vertex_Hash {
+	size_t operator()(const Vertex& vertex) const {
+		return static_cast<size_t>(fs_util::hash_bytes(std::as_bytes(std::span(&vertex, 1))));
+	}
+};
+
+struct Vertex_Equal {
+	bool operator()(const Vertex& a, const Vertex& b) const { return std::memcmp(&a, &b, sizeof(Vertex)) == 0; }
+};
+
+// tuning constants from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+constexpr size_t FORSYTH_CACHE_SIZE = 32;
+constexpr float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+constexpr float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+constexpr float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+constexpr float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+float forsyth_vertex_score(int cache_position, unsigned int remaining_triangles) {
+	if (remaining_triangles == 0) {
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+	if (cache_position >= 0) {
+		if (cache_position < 3) {
+			// the vertices of the last triangle get a fixed score so the next one doesn't just reuse the same edge
+			score = FORSYTH_LAST_TRIANGLE_SCORE;
+		} else {
+			float scaler = 1.0f / static_cast<float>(FORSYTH_CACHE_SIZE - 3);
+			score = std::pow(1.0f - static_cast<float>(cache_position - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+		}
+	}
+
+	// boost vertices with few triangles left so lone triangles don't get stranded
+	score += FORSYTH_VALENCE_BOOST_SCALE *
+			 std::pow(static_cast<float>(remaining_triangles), -FORSYTH_VALENCE_BOOST_POWER);
+	return score;
+}
+
+}
+
+mesh_opt::Cache_Stats mesh_opt::analyze_vertex_cache(std::span<const unsigned int> indices,
+													 size_t vertex_count,
+													 size_t cache_size) {
+	Cache_Stats stats;
+	if (indices.empty() || vertex_count == 0) {
+		return stats;
+	}
+
+	Fifo_Cache cache(vertex_count, cache_size);
+	std::vector<bool> referenced(vertex_count, false);
+	size_t misses = 0;
+	size_t unique_vertices = 0;
+	for (unsigned int index : indices) {
+		misses += cache.access(index);
+		if (!referenced[index]) {
+			referenced[index] = true;
+			unique_vertices++;
+		}
+	}
+
+	stats.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+	stats.atvr = static_cast<float>(misses) / static_cast<float>(unique_vertices);
+	return stats;
+}
+
+size_t mesh_opt::weld_vertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+	std::unordered_map<Vertex, unsigned int, Vertex_Hash, Vertex_Equal> unique;
+	unique.reserve(vertices.size());
+
+	std::vector<unsigned int> remap(vertices.size());
+	std::vector<Vertex> welded;
+	welded.reserve(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++) {
+		auto [it, inserted] = unique.try_emplace(vertices[i], static_cast<unsigned int>(welded.size()));
+		if (inserted) {
+			welded.push_back(vertices[i]);
+		}
+		remap[i] = it->second;
+	}
+
+	for (unsigned int& index : indices) {
+		index = remap[index];
+	}
+
+	size_t removed = vertices.size() - welded.size();
+	vertices = std::move(welded);
+	return removed;
+}
+
+void mesh_opt::optimize_vertex_cache(std::vector<unsigned int>& indices, size_t vertex_count) {
+	size_t triangle_count = indices.size() / 3;
+	if (triangle_count == 0) {
+		return;
+	}
+
+	// vertex -> triangle adjacency, the first `remaining[v]` entries of a vertex's range are the unemitted triangles
+	std::vector<unsigned int> remaining(vertex_count, 0);
+	for (unsigned int index : indices) {
+		remaining[index]++;
+	}
+
+	std::vector<unsigned int> adjacency_offsets(vertex_count + 1, 0);
+	std::partial_sum(remaining.begin(), remaining.end(), adjacency_offsets.begin() + 1);
+
+	std::vector<unsigned int> adjacency(indices.size());
+	std::vector<unsigned int> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++) {
+		adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+	}
+
+	std::vector<int> cache_position(vertex_count, -1);
+	std::vector<float> vertex_score(vertex_count);
+	for (size_t v = 0; v < vertex_count; v++) {
+		vertex_score[v] = forsyth_vertex_score(-1, remaining[v]);
+	}
+
+	std::vector<float> triangle_score(triangle_count);
+	std::vector<bool> emitted(triangle_count, false);
+	for (size_t t = 0; t < triangle_count; t++) {
+		triangle_score[t] =
+			vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+	}
+
+	std::vector<unsigned int> output;
+	output.reserve(indices.size());
+	std::vector<unsigned int> cache, new_cache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	new_cache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+	size_t best_triangle = std::max_element(triangle_score.begin(), triangle_score.end()) - triangle_score.begin();
+	size_t next_unemitted = 0;
+	while (output.size() < indices.size()) {
+		if (best_triangle == UNUSED) {
+			// nothing in the cache has triangles left, fall back to the next triangle in input order
+			while (emitted[next_unemitted]) {
+				next_unemitted++;
+			}
+			best_triangle = next_unemitted;
+		}
+
+		emitted[best_triangle] = true;
+		const unsigned int* triangle = &indices[best_triangle * 3];
+		new_cache.assign(triangle, triangle + 3);
+		for (int corner = 0; corner < 3; corner++) {
+			unsigned int v = triangle[corner];
+			output.push_back(v);
+
+			unsigned int* begin = &adjacency[adjacency_offsets[v]];
+			unsigned int* end = begin + remaining[v];
+			std::iter_swap(std::find(begin, end, static_cast<unsigned int>(best_triangle)), end - 1);
+			remaining[v]--;
+		}
+
+		for (unsigned int v : cache) {
+			if (std::find(triangle, triangle + 3, v) == triangle + 3) {
+				new_cache.push_back(v);
+			}
+		}
+
+		// everything pushed out of the cache loses its position score
+		for (size_t i = FORSYTH_CACHE_SIZE; i < new_cache.size(); i++) {
+			cache_position[new_cache[i]] = -1;
+			vertex_score[new_cache[i]] = forsyth_vertex_score(-1, remaining[new_cache[i]]);
+		}
+		if (new_cache.size() > FORSYTH_CACHE_SIZE) {
+			new_cache.resize(FORSYTH_CACHE_SIZE);
+		}
+		std::swap(cache, new_cache);
+
+		for (size_t i = 0; i < cache.size(); i++) {
+			cache_position[cache[i]] = static_cast<int>(i);
+			vertex_score[cache[i]] = forsyth_vertex_score(static_cast<int>(i), remaining[cache[i]]);
+		}
+
+		// only triangles touching the cache changed score, and only those are candidates for the next pick
+		best_triangle = UNUSED;
+		float best_score = -std::numeric_limits<float>::infinity();
+		for (unsigned int v : cache) {
+			for (unsigned int i = 0; i < remaining[v]; i++) {
+				unsigned int t = adjacency[adjacency_offsets[v] + i];
+				triangle_score[t] = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] +
+									vertex_score[indices[t * 3 + 2]];
+				if (triangle_score[t] > best_score) {
+					best_score = triangle_score[t];
+					best_triangle = t;
+				}
+			}
+		}
+	}
+
+	indices = std::move(output);
+}
+
+void mesh_opt::optimize_overdraw(std::vector<unsigned int>& indices,
+								 std::span<const Vertex> vertices,
+								 std::vector<Meshlet>& meshlets) {
+	if (meshlets.size() < 2) {
+		return;
+	}
+
+	// sort meshlets so the ones facing away from the mesh centre (likely occluders) are drawn first
+	glm::vec3 mesh_centroid(0.0f);
+	float mesh_area = 0.0f;
+	std::vector<glm::vec3> meshlet_centroids(meshlets.size(), glm::vec3(0.0f));
+	std::vector<glm::vec3> meshlet_normals(meshlets.size(), glm::vec3(0.0f));
+	for (size_t m = 0; m < meshlets.size(); m++) {
+		float meshlet_area = 0.0f;
+		for (uint32_t i = meshlets[m].first_index; i < meshlets[m].first_index + meshlets[m].index_count; i += 3) {
+			const glm::vec3& a = vertices[indices[i]].position;
+			const glm::vec3& b = vertices[indices[i + 1]].position;
+			const glm::vec3& d = vertices[indices[i + 2]].position;
+			glm::vec3 normal = glm::cross(b - a, d - a);
+			float area = glm::length(normal);
+			glm::vec3 centroid = (a + b + d) / 3.0f;
+
+			meshlet_centroids[m] += centroid * area;
+			meshlet_normals[m] += normal;
+			meshlet_area += area;
+		}
+
+		mesh_centroid += meshlet_centroids[m];
+		mesh_area += meshlet_area;
+		meshlet_centroids[m] = meshlet_area > 0.0f ? meshlet_centroids[m] / meshlet_area : meshlet_centroids[m];
+		float normal_length = glm::length(meshlet_normals[m]);
+		meshlet_normals[m] = normal_length > 0.0f ? meshlet_normals[m] / normal_length : meshlet_normals[m];
+	}
+	mesh_centroid = mesh_area > 0.0f ? mesh_centroid / mesh_area : mesh_centroid;
+
+	std::vector<float> sort_keys(meshlets.size());
+	for (size_t m = 0; m < sort_keys.size(); m++) {
+		sort_keys[m] = glm::dot(meshlet_centroids[m] - mesh_centroid, meshlet_normals[m]);
+	}
+
+	std::vector<size_t> order(sort_keys.size());
+	std::iota(order.begin(), order.end(), size_t(0));
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sort_keys[a] > sort_keys[b]; });
+
+	std::vector<unsigned int> output;
+	output.reserve(indices.size());
+	std::vector<Meshlet> reordered;
+	reordered.reserve(meshlets.size());
+	for (size_t m : order) {
+		const Meshlet& meshlet = meshlets[m];
+		reordered.push_back(meshlet);
+		reordered.back().first_index = static_cast<uint32_t>(output.size());
+		output.insert(output.end(), indices.begin() + meshlet.first_index,
+					  indices.begin() + meshlet.first_index + meshlet.index_count);
+	}
+	indices = std::move(output);
+	meshlets = std::move(reordered);
+}
+
+void mesh_opt::optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+	std::vector<unsigned int> remap(vertices.size(), UNUSED);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertices.size());
+
+	for (unsigned int& index : indices) {
+		if (remap[index] == UNUSED) {
+			remap[index] = static_cast<unsigned int>(reordered.size());
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	vertices = std::move(reordered);
+}
+
+mesh_opt::Optimize_Report mesh_opt::optimize(Mesh_Data& mesh) {
+	Optimize_Report report;
+	report.before = analyze_vertex_cache(mesh.indices, mesh.vertices.size());
+
+	report.welded_vertices = weld_vertices(mesh.vertices, mesh.indices);
+	optimize_vertex_cache(mesh.indices, mesh.vertices.size());
+	// the cache order walks neighbouring triangles, so meshlets cut from it stay compact; sorting its smaller clusters
+	// across the whole mesh instead would leave every meshlet with triangles from all over the mesh
+	mesh.meshlets = meshlet::build(mesh.vertices, mesh.indices);
+	optimize_overdraw(mesh.indices, mesh.vertices, mesh.meshlets);
+	optimize_vertex_fetch(mesh.vertices, mesh.indices);
+
+	report.after = analyze_vertex_cache(mesh.indices, mesh.vertices.size());
+	return report;
+}
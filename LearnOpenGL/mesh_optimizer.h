@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include "model.h"
+
+// Import-time index/vertex optimization, run on the CPU-side Mesh_Data before anything is uploaded.
+namespace mesh_opt {
+
+// post-transform cache efficiency of an index buffer, as simulated with a FIFO cache
+struct Cache_Stats {
+	// average cache miss ratio: vertex shader invocations per triangle, 0.5 is the theoretical best
+	float acmr = 0.0f;
+	// average transform to vertex ratio: vertex shader invocations per unique vertex, 1.0 is the best possible
+	float atvr = 0.0f;
+};
+
+Cache_Stats analyze_vertex_cache(std::span<const unsigned int> indices, size_t vertex_count, size_t cache_size = 16);
+
+// merges bitwise identical vertices and remaps the indices, returns the number of vertices removed
+size_t weld_vertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+// reorders triangles for post-transform cache reuse (Forsyth's linear-speed vertex cache optimization)
+void optimize_vertex_cache(std::vector<unsigned int>& indices, size_t vertex_count);
+
+// reorders `meshlets`, which cover the cache-optimized `indices` in order as meshlet::build leaves them, so outward
+// facing ones come first to reduce overdraw; each keeps its triangles contiguous and in cache order
+void optimize_overdraw(std::vector<unsigned int>& indices,
+					   std::span<const Vertex> vertices,
+					   std::vector<Meshlet>& meshlets);
+
+// reorders vertices by first use in the index buffer so vertex fetch is as linear as possible, drops unused vertices
+void optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+struct Optimize_Report {
+	size_t welded_vertices = 0;
+	Cache_Stats before;
+	Cache_Stats after;
+};
+
+// runs the whole pipeline above in order, building the mesh's meshlets before the overdraw pass sorts them
+Optimize_Report optimize(Mesh_Data& mesh);
+
+}
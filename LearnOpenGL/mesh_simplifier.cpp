@@ -0,0 +1,326 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+
+namespace {
+
+// symmetric 4x4 matrix of a sum of squared plane distances, evaluated as v^T Q v with v = (p, 1)
+struct Quadric {
+	double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+	double a11 = 0, a12 = 0, a13 = 0;
+	double a22 = 0, a23 = 0;
+	double a33 = 0;
+
+	static Quadric from_plane(const glm::dvec3& normal, double distance) {
+		Quadric q;
+		q.a00 = normal.x * normal.x;
+		q.a01 = normal.x * normal.y;
+		q.a02 = normal.x * normal.z;
+		q.a03 = normal.x * distance;
+		q.a11 = normal.y * normal.y;
+		q.a12 = normal.y * normal.z;
+		q.a13 = normal.y * distance;
+		q.a22 = normal.z * normal.z;
+		q.a23 = normal.z * distance;
+		q.a33 = distance * distance;
+		return q;
+	}
+
+	Quadric& operator+=(const Quadric& other) {
+		a00 += other.a00, a01 += other.a01, a02 += other.a02, a03 += other.a03;
+		a11 += other.a11, a12 += other.a12, a13 += other.a13;
+		a22 += other.a22, a23 += other.a23;
+		a33 += other.a33;
+		return *this;
+	}
+
+	double error(const glm::vec3& p) const {
+		double x = p.x, y = p.y, z = p.z;
+		double result = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x + a11 * y * y +
+						2 * a12 * y * z + 2 * a13 * y + a22 * z * z + 2 * a23 * z + a33;
+		return std::max(result, 0.0);
+	}
+};
+
+struct Collapse {
+	unsigned int from;
+	unsigned int to;
+	double cost;
+};
+
+// vertex to triangle adjacency in compressed rows, rebuilt once per pass
+struct Adjacency {
+	std::vector<unsigned int> offsets;
+	std::vector<unsigned int> triangles;
+
+	void build(std::span<const unsigned int> indices, size_t vertex_count) {
+		offsets.assign(vertex_count + 1, 0);
+		for (unsigned int index : indices) {
+			offsets[index + 1]++;
+		}
+		for (size_t i = 0; i < vertex_count; i++) {
+			offsets[i + 1] += offsets[i];
+		}
+
+		triangles.resize(indices.size());
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++) {
+			triangles[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+		}
+	}
+
+	std::span<const unsigned int> of(unsigned int vertex) const {
+		return std::span(triangles).subspan(offsets[vertex], offsets[vertex + 1] - offsets[vertex]);
+	}
+};
+
+// every vertex is mapped to the first vertex sharing its position, so wedges (split by UVs or normals) are seen as
+// one point of the surface
+std::vector<unsigned int> position_remap(std::span<const Vertex> vertices) {
+	struct Position_Hash {
+		size_t operator()(const glm::vec3& p) const {
+			uint32_t bits[3];
+			std::memcpy(bits, &p, sizeof(bits));
+			return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+		}
+	};
+
+	std::unordered_map<glm::vec3, unsigned int, Position_Hash> first_vertex;
+	first_vertex.reserve(vertices.size());
+	std::vector<unsigned int> remap(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++) {
+		remap[i] = first_vertex.try_emplace(vertices[i].position, static_cast<unsigned int>(i)).first->second;
+	}
+
+	return remap;
+}
+
+// Vertices that mustn't move: wedges (their position is shared with another vertex, i.e. a UV seam or normal
+// crease) and anything on an open border.
+std::vector<uint8_t> find_locked_vertices(std::span<const unsigned int> indices, std::span<const unsigned int> remap) {
+	std::vector<uint8_t> locked(remap.size(), 0);
+	std::vector<unsigned int> wedge_count(remap.size(), 0);
+	for (size_t i = 0; i < remap.size(); i++) {
+		wedge_count[remap[i]]++;
+	}
+	for (size_t i = 0; i < remap.size(); i++) {
+		locked[i] = wedge_count[remap[i]] > 1;
+	}
+
+	// a border edge has no twin running the other way, compared on positions so seams don't count as borders
+	std::unordered_map<uint64_t, int> edges;
+	edges.reserve(indices.size());
+	auto key = [](unsigned int a, unsigned int b) { return (uint64_t(a) << 32) | b; };
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		for (size_t e = 0; e < 3; e++) {
+			unsigned int a = remap[indices[i + e]];
+			unsigned int b = remap[indices[i + (e + 1) % 3]];
+			edges[key(a, b)]++;
+		}
+	}
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		for (size_t e = 0; e < 3; e++) {
+			unsigned int a = indices[i + e];
+			unsigned int b = indices[i + (e + 1) % 3];
+			if (edges.find(key(remap[b], remap[a])) == edges.end()) {
+				locked[a] = 1;
+				locked[b] = 1;
+			}
+		}
+	}
+
+	return locked;
+}
+
+glm::vec3 triangle_normal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+	return glm::cross(b - a, c - a);
+}
+
+// moving `from` onto `to` must not flip or collapse any triangle that survives the collapse
+bool flips_triangles(std::span<const Vertex> vertices,
+					 std::span<const unsigned int> indices,
+					 const Adjacency& adjacency,
+					 unsigned int from,
+					 unsigned int to) {
+	const glm::vec3& target = vertices[to].position;
+	for (unsigned int triangle : adjacency.of(from)) {
+		const unsigned int* corners = &indices[triangle * 3];
+		if (corners[0] == to || corners[1] == to || corners[2] == to) {
+			continue;
+		}
+
+		glm::vec3 before[3];
+		glm::vec3 after[3];
+		for (int i = 0; i < 3; i++) {
+			before[i] = vertices[corners[i]].position;
+			after[i] = corners[i] == from ? target : before[i];
+		}
+
+		glm::vec3 normal_before = triangle_normal(before[0], before[1], before[2]);
+		glm::vec3 normal_after = triangle_normal(after[0], after[1], after[2]);
+		if (glm::dot(normal_before, normal_after) <= 0.0f) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+}
+
+std::vector<unsigned int> mesh_opt::simplify(std::span<const Vertex> vertices,
+											 std::span<const unsigned int> indices,
+											 size_t target_index_count,
+											 float max_error,
+											 float* result_error) {
+	std::vector<unsigned int> result(indices.begin(), indices.end());
+	double worst_cost = 0.0;
+	double max_cost = double(max_error) * double(max_error);
+
+	std::vector<unsigned int> remap = position_remap(vertices);
+	std::vector<uint8_t> locked = find_locked_vertices(indices, remap);
+
+	// one quadric per position, built from the planes of every triangle touching it
+	std::vector<Quadric> quadrics(vertices.size());
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		glm::dvec3 a = vertices[indices[i]].position;
+		glm::dvec3 b = vertices[indices[i + 1]].position;
+		glm::dvec3 c = vertices[indices[i + 2]].position;
+		glm::dvec3 normal = glm::cross(b - a, c - a);
+		double length = glm::length(normal);
+		if (length == 0.0) {
+			continue;
+		}
+
+		normal /= length;
+		Quadric plane = Quadric::from_plane(normal, -glm::dot(normal, a));
+		for (size_t corner = 0; corner < 3; corner++) {
+			quadrics[remap[indices[i + corner]]] += plane;
+		}
+	}
+
+	Adjacency adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<uint8_t> touched(vertices.size());
+	std::vector<unsigned int> collapse_remap(vertices.size());
+
+	while (result.size() > target_index_count) {
+		adjacency.build(result, vertices.size());
+
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (size_t e = 0; e < 3; e++) {
+				unsigned int a = result[i + e];
+				unsigned int b = result[i + (e + 1) % 3];
+				for (auto [from, to] : {std::pair(a, b), std::pair(b, a)}) {
+					if (locked[from] || remap[from] == remap[to]) {
+						continue;
+					}
+
+					Quadric combined = quadrics[remap[from]];
+					combined += quadrics[remap[to]];
+					// penalize folding across differing normals, scaled like the squared distance
+					glm::vec3 offset = vertices[to].position - vertices[from].position;
+					float normal_change = 1.0f - glm::dot(vertices[from].normal, vertices[to].normal);
+					double cost = combined.error(vertices[to].position) +
+								  0.5 * double(normal_change) * double(glm::dot(offset, offset));
+					collapses.push_back({from, to, cost});
+				}
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(),
+				  [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		// each collapse removes about two triangles; vertices next to a collapse wait for the next pass so every
+		// flip check in this one sees final positions
+		size_t triangles_to_remove = (result.size() - target_index_count) / 3;
+		size_t triangles_removed = 0;
+		std::fill(touched.begin(), touched.end(), uint8_t(0));
+		for (unsigned int i = 0; i < collapse_remap.size(); i++) {
+			collapse_remap[i] = i;
+		}
+
+		for (const Collapse& collapse : collapses) {
+			if (collapse.cost > max_cost || triangles_removed >= triangles_to_remove) {
+				break;
+			}
+			if (touched[collapse.from] || touched[collapse.to] ||
+				flips_triangles(vertices, result, adjacency, collapse.from, collapse.to)) {
+				continue;
+			}
+
+			collapse_remap[collapse.from] = collapse.to;
+			quadrics[remap[collapse.to]] += quadrics[remap[collapse.from]];
+			worst_cost = std::max(worst_cost, collapse.cost);
+
+			for (unsigned int triangle : adjacency.of(collapse.from)) {
+				const unsigned int* corners = &result[triangle * 3];
+				bool removed = corners[0] == collapse.to || corners[1] == collapse.to || corners[2] == collapse.to;
+				triangles_removed += removed;
+				for (int corner = 0; corner < 3; corner++) {
+					touched[corners[corner]] = 1;
+				}
+			}
+		}
+
+		if (triangles_removed == 0) {
+			break;
+		}
+
+		size_t write = 0;
+		for (size_t i = 0; i < result.size(); i += 3) {
+			unsigned int a = collapse_remap[result[i]];
+			unsigned int b = collapse_remap[result[i + 1]];
+			unsigned int c = collapse_remap[result[i + 2]];
+			if (a != b && b != c && a != c) {
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+		}
+		result.resize(write);
+	}
+
+	if (result_error) {
+		*result_error = static_cast<float>(std::sqrt(worst_cost));
+	}
+	return result;
+}
+
+void mesh_opt::generate_lods(Mesh_Data& mesh) {
+	size_t full_count = mesh.indices.size();
+	mesh.lods.clear();
+	mesh.lods.push_back({0, static_cast<uint32_t>(full_count), 0.0f});
+
+	// every LOD is simplified from the full mesh, so its error is measured against what LOD 0 shows
+	std::span<const unsigned int> source(mesh.indices.data(), full_count);
+	std::vector<unsigned int> all_lods;
+	size_t previous_count = full_count;
+	for (float ratio : LOD_RATIOS) {
+		size_t target = static_cast<size_t>(full_count * ratio) / 3 * 3;
+		float error = 0.0f;
+		std::vector<unsigned int> lod =
+			simplify(mesh.vertices, source, target, std::numeric_limits<float>::max(), &error);
+
+		// seams and borders can stop simplification well before the target, there's no point in a LOD that
+		// barely differs from the previous one
+		if (lod.empty() || lod.size() > previous_count * 9 / 10) {
+			break;
+		}
+
+		optimize_vertex_cache(lod, mesh.vertices.size());
+		mesh.lods.push_back({static_cast<uint32_t>(full_count + all_lods.size()), static_cast<uint32_t>(lod.size()),
+							 std::max(error, mesh.lods.back().error)});
+		all_lods.insert(all_lods.end(), lod.begin(), lod.end());
+		previous_count = lod.size();
+	}
+
+	mesh.indices.insert(mesh.indices.end(), all_lods.begin(), all_lods.end());
+}
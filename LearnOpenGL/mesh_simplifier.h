@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include "model.h"
+
+// Import-time LOD generation: quadric error metric edge collapse over the index buffer only, so every LOD keeps
+// referencing the original vertices and all of them can share one vertex buffer.
+namespace mesh_opt {
+
+// fraction of the full triangle count kept by each LOD after LOD 0
+constexpr float LOD_RATIOS[] = {0.5f, 0.25f, 0.1f};
+
+// Collapses edges until at most `target_index_count` indices are left or the next collapse would move the surface
+// by more than `max_error` (object-space units). Vertices on UV seams, normal creases and open borders are never
+// moved, so seams and silhouettes stay intact. Writes the largest error introduced to `result_error`.
+std::vector<unsigned int> simplify(std::span<const Vertex> vertices,
+								   std::span<const unsigned int> indices,
+								   size_t target_index_count,
+								   float max_error,
+								   float* result_error = nullptr);
+
+// appends the LOD_RATIOS chain to mesh.indices and fills mesh.lods, LOD 0 being the indices as they were; stops
+// early once simplification stops making progress
+void generate_lods(Mesh_Data& mesh);
+
+}
@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <cmath>
+
+#include "meshlet.h"
+
+static Meshlet finish_meshlet(std::span<const Vertex> vertices,
+							  std::span<const unsigned int> indices,
+							  uint32_t first_index,
+							  uint32_t index_count) {
+	Meshlet meshlet;
+	meshlet.first_index = first_index;
+	meshlet.index_count = index_count;
+	std::span<const unsigned int> triangles = indices.subspan(first_index, index_count);
+
+	glm::vec3 min = vertices[triangles[0]].position;
+	glm::vec3 max = min;
+	for (unsigned int index : triangles) {
+		min = glm::min(min, vertices[index].position);
+		max = glm::max(max, vertices[index].position);
+	}
+	meshlet.center = (min + max) * 0.5f;
+	for (unsigned int index : triangles) {
+		meshlet.radius = std::max(meshlet.radius, glm::length(vertices[index].position - meshlet.center));
+	}
+
+	// the axis is the average face normal, the cone is as wide as the normal furthest from it
+	glm::vec3 axis = glm::vec3(0.0f);
+	std::vector<glm::vec3> normals;
+	normals.reserve(index_count / 3);
+	for (size_t i = 0; i < triangles.size(); i += 3) {
+		const glm::vec3& a = vertices[triangles[i]].position;
+		const glm::vec3& b = vertices[triangles[i + 1]].position;
+		const glm::vec3& c = vertices[triangles[i + 2]].position;
+		glm::vec3 normal = glm::cross(b - a, c - a);
+		float length = glm::length(normal);
+		if (length > 0.0f) {
+			normals.push_back(normal / length);
+			axis += normal / length;
+		}
+	}
+
+	float axis_length = glm::length(axis);
+	if (normals.empty() || axis_length == 0.0f) {
+		return meshlet;
+	}
+	meshlet.cone_axis = axis / axis_length;
+
+	float min_dot = 1.0f;
+	for (const glm::vec3& normal : normals) {
+		min_dot = std::min(min_dot, glm::dot(normal, meshlet.cone_axis));
+	}
+	// wider than a hemisphere means it can always be seen from somewhere
+	meshlet.cone_cutoff = min_dot <= 0.0f ? 1.0f : std::sqrt(1.0f - min_dot * min_dot);
+	return meshlet;
+}
+
+std::vector<Meshlet> meshlet::build(std::span<const Vertex> vertices, std::span<const unsigned int> indices) {
+	std::vector<Meshlet> meshlets;
+	// stamp of the meshlet each vertex was last counted in, so the unique vertex count needs no clearing
+	std::vector<uint32_t> last_meshlet(vertices.size(), UINT32_MAX);
+
+	uint32_t first_index = 0;
+	size_t vertex_count = 0;
+	uint32_t meshlet_id = 0;
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		size_t new_vertices = 0;
+		for (size_t corner = 0; corner < 3; corner++) {
+			unsigned int index = indices[i + corner];
+			bool repeated = (corner > 0 && indices[i] == index) || (corner > 1 && indices[i + 1] == index);
+			new_vertices += last_meshlet[index] != meshlet_id && !repeated;
+		}
+
+		size_t triangle_count = (i - first_index) / 3;
+		if (vertex_count + new_vertices > MAX_VERTICES || triangle_count + 1 > MAX_TRIANGLES) {
+			meshlets.push_back(finish_meshlet(vertices, indices, first_index, static_cast<uint32_t>(i) - first_index));
+			first_index = static_cast<uint32_t>(i);
+			vertex_count = 0;
+			meshlet_id++;
+		}
+
+		for (size_t corner = 0; corner < 3; corner++) {
+			unsigned int index = indices[i + corner];
+			if (last_meshlet[index] != meshlet_id) {
+				last_meshlet[index] = meshlet_id;
+				vertex_count++;
+			}
+		}
+	}
+
+	if (first_index < indices.size()) {
+		meshlets.push_back(
+			finish_meshlet(vertices, indices, first_index, static_cast<uint32_t>(indices.size()) - first_index));
+	}
+
+	return meshlets;
+}
+
+bool meshlet::is_visible(const Meshlet& meshlet,
+						 const Frustum& frustum,
+						 const glm::vec3& camera,
+						 bool cull_backfacing) {
+	for (const glm::vec4& plane : frustum.planes) {
+		if (glm::dot(glm::vec3(plane), meshlet.center) + plane.w < -meshlet.radius) {
+			return false;
+		}
+	}
+
+	if (!cull_backfacing) {
+		return true;
+	}
+
+	glm::vec3 to_center = meshlet.center - camera;
+	return glm::dot(to_center, meshlet.cone_axis) < meshlet.cone_cutoff * glm::length(to_center) + meshlet.radius;
+}
+
+bool meshlet::culls_backfaces() {
+	if (!glIsEnabled(GL_CULL_FACE)) {
+		return false;
+	}
+
+	GLint mode = 0;
+	GLint front_face = 0;
+	glGetIntegerv(GL_CULL_FACE_MODE, &mode);
+	glGetIntegerv(GL_FRONT_FACE, &front_face);
+	return mode == GL_BACK && front_face == GL_CCW;
+}
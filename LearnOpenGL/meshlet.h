@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "culling.h"
+#include "vertex_format.h"
+
+// A cluster of consecutive triangles in a mesh's LOD 0 index buffer, with bounds for culling it on its own.
+//
+// Clusters stay contiguous index ranges instead of getting their own local vertex and micro-index lists: without
+// mesh shaders GL draws them straight out of the shared index buffer, and neighbouring visible clusters merge into
+// one range. Laid out to match the std430 struct in shaders/meshlet_cull.comp.
+struct Meshlet {
+	glm::vec3 center = glm::vec3(0.0f);
+	float radius = 0.0f;
+	// every triangle normal is within the cone around the axis; the cluster is backfacing from anywhere with
+	// dot(center - camera, axis) >= cone_cutoff * |center - camera| + radius, a cutoff of 1 means never
+	glm::vec3 cone_axis = glm::vec3(0.0f, 0.0f, 1.0f);
+	float cone_cutoff = 1.0f;
+	// relative to the mesh's index range
+	uint32_t first_index = 0;
+	uint32_t index_count = 0;
+	uint32_t padding[2] = {};
+};
+
+namespace meshlet {
+
+constexpr size_t MAX_VERTICES = 64;
+constexpr size_t MAX_TRIANGLES = 124;
+
+// splits the (ideally vertex cache optimized) index buffer into runs that stay within both limits
+std::vector<Meshlet> build(std::span<const Vertex> vertices, std::span<const unsigned int> indices);
+
+// `frustum` and `camera` in the mesh's object space; the normal cone is only tested with `cull_backfacing`, as the
+// cluster's triangles are still drawn from behind otherwise
+bool is_visible(const Meshlet& meshlet, const Frustum& frustum, const glm::vec3& camera, bool cull_backfacing);
+
+// whether GL currently culls the back faces of counter-clockwise triangles, which is what the normal cones assume
+bool culls_backfaces();
+
+// a transform with a negative determinant flips the winding, so the cones point the wrong way under it
+inline bool mirrors(const glm::mat4& transform) {
+	return glm::determinant(glm::mat3(transform)) < 0.0f;
+}
+
+}
+
+// draw ranges collected from the visible meshlets of one mesh, for glMultiDrawElementsBaseVertex; reused between
+// frames so culling doesn't allocate
+struct Meshlet_Batch {
+	std::vector<GLsizei> counts;
+	std::vector<const void*> offsets;
+	std::vector<GLint> base_vertices;
+
+	void clear() {
+		counts.clear();
+		offsets.clear();
+		base_vertices.clear();
+	}
+};
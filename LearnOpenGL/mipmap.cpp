@@ -0,0 +1,378 @@
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+#if defined(__AVX__)
+#define MIPMAP_AVX 1
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIPMAP_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#include "mipmap.h"
+#include "thread_pool.h"
+
+namespace {
+
+// destination rows per thread pool task
+constexpr int BAND_ROWS = 32;
+constexpr int MAX_TAPS = 8;
+// resolution of the linear -> sRGB table, fine enough that even the darkest values round correctly
+constexpr int LINEAR_STEPS = 65535;
+
+struct Srgb_Tables {
+	float to_linear[256];
+	uint8_t from_linear[LINEAR_STEPS + 1];
+
+	Srgb_Tables() {
+		for (int i = 0; i < 256; i++) {
+			float value = i / 255.0f;
+			to_linear[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i <= LINEAR_STEPS; i++) {
+			float value = static_cast<float>(i) / LINEAR_STEPS;
+			float encoded = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+			from_linear[i] = static_cast<uint8_t>(std::lround(encoded * 255.0f));
+		}
+	}
+};
+
+const Srgb_Tables& srgb_tables() {
+	static const Srgb_Tables tables;
+	return tables;
+}
+
+// Weights along one axis. Destination texel x reads source texels x * step + first + k, clamped to the edge, so odd
+// sizes reuse their last row or column. A source that is already 1 texel wide is passed through.
+struct Kernel {
+	int taps = 1;
+	int step = 0;
+	int first = 0;
+	float weights[MAX_TAPS] = {1.0f};
+};
+
+// zeroth-order modified Bessel function of the first kind, for the Kaiser window
+double bessel_i0(double x) {
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; k < 32; k++) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+Kernel make_kernel(mipmap::Filter filter, int source_size) {
+	Kernel kernel;
+	if (source_size == 1) {
+		return kernel;
+	}
+
+	kernel.step = 2;
+	if (filter == mipmap::Filter::box) {
+		kernel.taps = 2;
+		kernel.weights[0] = kernel.weights[1] = 0.5f;
+		return kernel;
+	}
+
+	// sinc low-passed at half the source rate, windowed over 4 source texels either side of the destination center
+	constexpr double RADIUS = 4.0;
+	constexpr double ALPHA = 4.0;
+	kernel.taps = MAX_TAPS;
+	kernel.first = -MAX_TAPS / 2 + 1;
+	double weights[MAX_TAPS];
+	double total = 0.0;
+	for (int k = 0; k < MAX_TAPS; k++) {
+		double distance = k - MAX_TAPS / 2 + 0.5;
+		double t = distance / 2.0;
+		double sinc = std::sin(std::numbers::pi * t) / (std::numbers::pi * t);
+		double ratio = distance / RADIUS;
+		weights[k] = sinc * bessel_i0(ALPHA * std::sqrt(1.0 - ratio * ratio)) / bessel_i0(ALPHA);
+		total += weights[k];
+	}
+	for (int k = 0; k < MAX_TAPS; k++) {
+		kernel.weights[k] = static_cast<float>(weights[k] / total);
+	}
+
+	return kernel;
+}
+
+int source_index(const Kernel& kernel, int x, int k, int source_size) {
+	return std::clamp(x * kernel.step + kernel.first + k, 0, source_size - 1);
+}
+
+// which channels hold sRGB color: all but alpha, if the layout has one
+bool is_color_channel(int channel, int num_chans) {
+	bool has_alpha = num_chans == 2 || num_chans == 4;
+	return !has_alpha || channel < num_chans - 1;
+}
+
+// Floats per texel while filtering. Single channel images stay dense, everything else is padded to 4 so a texel is
+// one SSE register.
+int lane_count(int num_chans) {
+	return num_chans == 1 ? 1 : 4;
+}
+
+template <int NUM_CHANS>
+void decode_texels(const unsigned char* source, int width, const float* const tables[4], float* out) {
+	constexpr int LANES = NUM_CHANS == 1 ? 1 : 4;
+	for (int x = 0; x < width; x++) {
+		for (int c = 0; c < LANES; c++) {
+			out[x * LANES + c] = c < NUM_CHANS ? tables[c][source[x * NUM_CHANS + c]] : 0.0f;
+		}
+	}
+}
+
+// padding lanes are 0
+void decode_row(const unsigned char* source, int width, int num_chans, const float* const tables[4], float* out) {
+	switch (num_chans) {
+		case 1:
+			return decode_texels<1>(source, width, tables, out);
+		case 2:
+			return decode_texels<2>(source, width, tables, out);
+		case 3:
+			return decode_texels<3>(source, width, tables, out);
+		default:
+			return decode_texels<4>(source, width, tables, out);
+	}
+}
+
+template <int NUM_CHANS>
+void encode_texels(const float* row, int width, const bool srgb[4], unsigned char* out) {
+	constexpr int LANES = NUM_CHANS == 1 ? 1 : 4;
+	const uint8_t* from_linear = srgb_tables().from_linear;
+	float scales[LANES];
+	for (int c = 0; c < LANES; c++) {
+		scales[c] = srgb[c] ? static_cast<float>(LINEAR_STEPS) : 255.0f;
+	}
+
+	for (int x = 0; x < width; x++) {
+		// the sinc's negative lobes can ring past the valid range
+		int values[LANES];
+#ifdef MIPMAP_SSE2
+		if constexpr (LANES == 4) {
+			__m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(row + x * 4), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+			__m128 scaled = _mm_add_ps(_mm_mul_ps(value, _mm_loadu_ps(scales)), _mm_set1_ps(0.5f));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(values), _mm_cvttps_epi32(scaled));
+		} else
+#endif
+		{
+			for (int c = 0; c < LANES; c++) {
+				values[c] = static_cast<int>(std::clamp(row[x * LANES + c], 0.0f, 1.0f) * scales[c] + 0.5f);
+			}
+		}
+
+		for (int c = 0; c < NUM_CHANS; c++) {
+			out[x * NUM_CHANS + c] = static_cast<unsigned char>(srgb[c] ? from_linear[values[c]] : values[c]);
+		}
+	}
+}
+
+void encode_row(const float* row, int width, int num_chans, const bool srgb[4], unsigned char* out) {
+	switch (num_chans) {
+		case 1:
+			return encode_texels<1>(row, width, srgb, out);
+		case 2:
+			return encode_texels<2>(row, width, srgb, out);
+		case 3:
+			return encode_texels<3>(row, width, srgb, out);
+		default:
+			return encode_texels<4>(row, width, srgb, out);
+	}
+}
+
+// out[i] = sum of weights[k] * rows[k][i], the vertical pass over whole rows
+void weighted_sum(const float* const* rows, const float* weights, int taps, size_t count, float* out) {
+	size_t i = 0;
+#ifdef MIPMAP_AVX
+	for (; i + 8 <= count; i += 8) {
+		__m256 sum = _mm256_mul_ps(_mm256_loadu_ps(rows[0] + i), _mm256_set1_ps(weights[0]));
+		for (int k = 1; k < taps; k++) {
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(rows[k] + i), _mm256_set1_ps(weights[k])));
+		}
+		_mm256_storeu_ps(out + i, sum);
+	}
+#endif
+#ifdef MIPMAP_SSE2
+	for (; i + 4 <= count; i += 4) {
+		__m128 sum = _mm_mul_ps(_mm_loadu_ps(rows[0] + i), _mm_set1_ps(weights[0]));
+		for (int k = 1; k < taps; k++) {
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[k] + i), _mm_set1_ps(weights[k])));
+		}
+		_mm_storeu_ps(out + i, sum);
+	}
+#endif
+	for (; i < count; i++) {
+		float sum = 0.0f;
+		for (int k = 0; k < taps; k++) {
+			sum += rows[k][i] * weights[k];
+		}
+		out[i] = sum;
+	}
+}
+
+// destination texels from this one on read past the end of a `width` texel row
+int inner_end(const Kernel& kernel, int width, int out_width) {
+	int last_start = width - kernel.taps - kernel.first;
+	return last_start >= 0 ? std::min(out_width, last_start / kernel.step + 1) : 0;
+}
+
+// horizontal pass for 4 lanes, one texel per register
+void filter_row_rgba(const float* row, int width, const Kernel& kernel, int out_width, float* out) {
+	auto filter_texel = [&](int x) {
+		float sum[4] = {};
+		for (int k = 0; k < kernel.taps; k++) {
+			const float* texel = row + source_index(kernel, x, k, width) * 4;
+			for (int c = 0; c < 4; c++) {
+				sum[c] += texel[c] * kernel.weights[k];
+			}
+		}
+		std::copy(sum, sum + 4, out + x * 4);
+	};
+
+	int x = 0;
+#ifdef MIPMAP_SSE2
+	if (kernel.step == 2) {
+		// destination texels before this one read past the start of the row
+		for (int first_inner = std::min((1 - kernel.first) / 2, out_width); x < first_inner; x++) {
+			filter_texel(x);
+		}
+		for (int end_inner = inner_end(kernel, width, out_width); x < end_inner; x++) {
+			const float* taps = row + (2 * x + kernel.first) * 4;
+			__m128 sum = _mm_setzero_ps();
+			for (int k = 0; k < kernel.taps; k++) {
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(taps + k * 4), _mm_set1_ps(kernel.weights[k])));
+			}
+			_mm_storeu_ps(out + x * 4, sum);
+		}
+	}
+#endif
+	for (; x < out_width; x++) {
+		filter_texel(x);
+	}
+}
+
+// horizontal pass for a single lane, four destination texels at a time away from the edges
+void filter_row_single(const float* row, int width, const Kernel& kernel, int out_width, float* out) {
+	auto filter_texel = [&](int x) {
+		float sum = 0.0f;
+		for (int k = 0; k < kernel.taps; k++) {
+			sum += row[source_index(kernel, x, k, width)] * kernel.weights[k];
+		}
+		out[x] = sum;
+	};
+
+	int x = 0;
+#ifdef MIPMAP_SSE2
+	if (kernel.step == 2) {
+		// destination texels before this one read past the start of the row
+		for (int first_inner = std::min((1 - kernel.first) / 2, out_width); x < first_inner; x++) {
+			filter_texel(x);
+		}
+		// the loads below read one texel past the last tap
+		for (int end_inner = inner_end(kernel, width - 1, out_width); x + 4 <= end_inner; x += 4) {
+			// tap k of destination texels x..x+3 is every other source texel from 2x + first + k
+			const float* taps = row + 2 * x + kernel.first;
+			__m128 sum = _mm_setzero_ps();
+			for (int k = 0; k < kernel.taps; k++) {
+				__m128 low = _mm_loadu_ps(taps + k);
+				__m128 high = _mm_loadu_ps(taps + k + 4);
+				__m128 even = _mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0));
+				sum = _mm_add_ps(sum, _mm_mul_ps(even, _mm_set1_ps(kernel.weights[k])));
+			}
+			_mm_storeu_ps(out + x, sum);
+		}
+	}
+#endif
+	for (; x < out_width; x++) {
+		filter_texel(x);
+	}
+}
+
+}
+
+mipmap::Color_Space mipmap::color_space(std::string_view type) {
+	return type == "texture_diffuse" ? Color_Space::srgb : Color_Space::linear;
+}
+
+mipmap::Level mipmap::downsample(std::span<const unsigned char> pixels,
+								 int width,
+								 int height,
+								 int num_chans,
+								 const Options& options) {
+	Level level;
+	level.width = std::max(1, width / 2);
+	level.height = std::max(1, height / 2);
+	level.num_chans = num_chans;
+	level.pixels.resize(level.row_size() * level.height);
+
+	float unorm[256];
+	for (int i = 0; i < 256; i++) {
+		unorm[i] = i / 255.0f;
+	}
+	const float* tables[4];
+	bool srgb[4];
+	for (int c = 0; c < 4; c++) {
+		srgb[c] = options.color_space == Color_Space::srgb && is_color_channel(c, num_chans);
+		tables[c] = srgb[c] ? srgb_tables().to_linear : unorm;
+	}
+
+	Kernel horizontal = make_kernel(options.filter, width);
+	Kernel vertical = make_kernel(options.filter, height);
+	int lanes = lane_count(num_chans);
+	size_t source_row_size = static_cast<size_t>(width) * num_chans;
+	size_t filtered_row_size = static_cast<size_t>(level.width) * lanes;
+	size_t bands = (level.height + BAND_ROWS - 1) / BAND_ROWS;
+	Thread_Pool::shared().parallel_for(bands, [&](size_t band) {
+		int first_row = static_cast<int>(band) * BAND_ROWS;
+		int last_row = std::min(first_row + BAND_ROWS, level.height) - 1;
+
+		// every source row the band reads is decoded and filtered horizontally once, which halves the width the
+		// vertical pass has to cover
+		int first_source = source_index(vertical, first_row, 0, height);
+		int last_source = source_index(vertical, last_row, vertical.taps - 1, height);
+		std::vector<float> decoded(static_cast<size_t>(width) * lanes);
+		std::vector<float> filtered(static_cast<size_t>(last_source - first_source + 1) * filtered_row_size);
+		for (int y = first_source; y <= last_source; y++) {
+			decode_row(pixels.data() + y * source_row_size, width, num_chans, tables, decoded.data());
+			float* out = filtered.data() + (y - first_source) * filtered_row_size;
+			if (lanes == 1) {
+				filter_row_single(decoded.data(), width, horizontal, level.width, out);
+			} else {
+				filter_row_rgba(decoded.data(), width, horizontal, level.width, out);
+			}
+		}
+
+		std::vector<float> result(filtered_row_size);
+		const float* rows[MAX_TAPS];
+		for (int y = first_row; y <= last_row; y++) {
+			for (int k = 0; k < vertical.taps; k++) {
+				rows[k] = filtered.data() + (source_index(vertical, y, k, height) - first_source) * filtered_row_size;
+			}
+			weighted_sum(rows, vertical.weights, vertical.taps, result.size(), result.data());
+			encode_row(result.data(), level.width, num_chans, srgb, level.pixels.data() + y * level.row_size());
+		}
+	});
+
+	return level;
+}
+
+std::vector<mipmap::Level> mipmap::generate(const Image& image, const Options& options) {
+	std::vector<Level> levels;
+	if (!image) {
+		return levels;
+	}
+
+	std::span<const unsigned char> pixels(image.pixels.get(), image.size());
+	int width = image.width;
+	int height = image.height;
+	while (width > 1 || height > 1) {
+		levels.push_back(downsample(pixels, width, height, image.num_chans, options));
+		pixels = levels.back().pixels;
+		width = levels.back().width;
+		height = levels.back().height;
+	}
+
+	return levels;
+}
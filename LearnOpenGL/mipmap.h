@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "texture.h"
+
+// CPU mip chain generation, so mips are built on loader threads with a known filter instead of by glGenerateMipmap on
+// the context thread, whose speed and quality are up to the driver.
+//
+// Levels are filtered in floating point (sRGB color in linear space) and split into bands of rows over the shared
+// thread pool. Each level is built from the one above it.
+namespace mipmap {
+
+enum class Filter : uint32_t {
+	// 2x2 average, what most glGenerateMipmap implementations do
+	box,
+	// 8-tap Kaiser-windowed sinc, keeps detail the box filter blurs away
+	kaiser,
+};
+
+enum class Color_Space : uint32_t {
+	// data such as normals, specular or AO, filtered as stored
+	linear,
+	// color, converted to linear before filtering and back afterwards; alpha is always filtered as stored
+	srgb,
+};
+
+struct Options {
+	Filter filter = Filter::kaiser;
+	Color_Space color_space = Color_Space::linear;
+};
+
+// one level of 8-bit pixels, laid out like the Image it was built from
+struct Level {
+	int width = 0;
+	int height = 0;
+	int num_chans = 0;
+	std::vector<unsigned char> pixels;
+
+	size_t row_size() const { return static_cast<size_t>(width) * num_chans; }
+};
+
+// the color space of a material slot (`type`, e.g. "texture_diffuse")
+Color_Space color_space(std::string_view type);
+
+// the next level down, each dimension halved (rounding down) but never below 1
+Level downsample(std::span<const unsigned char> pixels, int width, int height, int num_chans, const Options& options);
+// levels 1 down to 1x1, level 0 being `image` itself
+std::vector<Level> generate(const Image& image, const Options& options);
+
+}
@@ -1,103 +1,574 @@
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <utility>
 
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 #include <assimp/Importer.hpp>
 
+#include "bindless_textures.h"
+#include "block_compression.h"
+#include "config.h"
+#include "frame_stats.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
 #include "model.h"
+#include "process_memory.h"
+#include "texture_cache.h"
+#include "texture_streamer.h"
+#include "thread_pool.h"
+
+// any change here invalidates existing mesh caches, since the flags are part of the cache key
+static constexpr unsigned int IMPORT_FLAGS =
+	aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+Mesh::Mesh(std::vector<Vertex>&& vertices,
+		   std::vector<unsigned int>&& indices,
+		   std::vector<Material_Texture>&& textures,
+		   Vertex_Format format,
+		   Residency residency,
+		   std::span<const Mesh_Lod> lods,
+		   std::span<const Meshlet> meshlets,
+		   bool two_sided)
+	: textures(std::move(textures)),
+	  m_format(format),
+	  m_meshlets(meshlets.begin(), meshlets.end()),
+	  m_two_sided(two_sided) {
+	setup_mesh(vertices, indices);
+	set_lods(lods, indices.size());
+
+	switch (residency) {
+		case Residency::keep:
+			this->vertices = std::move(vertices);
+			this->indices = std::move(indices);
+			break;
+		case Residency::positions_only:
+			keep_positions(vertices);
+			this->indices = std::move(indices);
+			std::vector<Vertex>().swap(vertices);
+			break;
+		case Residency::drop:
+			// free the caller's buffers now rather than whenever it gets around to it
+			std::vector<Vertex>().swap(vertices);
+			std::vector<unsigned int>().swap(indices);
+			break;
+	}
+}
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures)
-	: vertices(vertices), indices(indices), textures(textures) {
-	setup_mesh();
+Mesh::Mesh(std::span<const Vertex> vertices,
+		   std::span<const unsigned int> indices,
+		   std::vector<Material_Texture>&& textures,
+		   Vertex_Format format,
+		   Residency residency,
+		   std::span<const Mesh_Lod> lods,
+		   std::span<const Meshlet> meshlets,
+		   bool two_sided)
+	: textures(std::move(textures)),
+	  m_format(format),
+	  m_meshlets(meshlets.begin(), meshlets.end()),
+	  m_two_sided(two_sided) {
+	setup_mesh(vertices, indices);
+	set_lods(lods, indices.size());
+	keep_resident(vertices, indices, residency);
+}
+
+Mesh::Mesh(size_t vertex_count,
+		   size_t index_count,
+		   std::vector<Material_Texture>&& textures,
+		   Vertex_Format format,
+		   const Quantization_Bounds& bounds,
+		   const Bounding_Volume& bounding_volume,
+		   std::span<const Mesh_Lod> lods,
+		   std::span<const Meshlet> meshlets,
+		   bool two_sided)
+	: textures(std::move(textures)),
+	  m_format(format),
+	  m_bounds(bounds),
+	  m_bounding_volume(bounding_volume),
+	  m_meshlets(meshlets.begin(), meshlets.end()),
+	  m_two_sided(two_sided) {
+	m_geometry = Geometry_Arena::get(m_format).allocate(vertex_count, index_count);
+	set_lods(lods, index_count);
+}
+
+Mesh::Mesh(Mesh&& other) noexcept {
+	*this = std::move(other);
+}
+
+Mesh& Mesh::operator=(Mesh&& other) noexcept {
+	if (this != &other) {
+		if (m_geometry != Geometry_Arena::INVALID_HANDLE) {
+			Geometry_Arena::get(m_format).free(m_geometry);
+		}
+		release_textures();
+		vertices = std::move(other.vertices);
+		positions = std::move(other.positions);
+		indices = std::move(other.indices);
+		textures = std::move(other.textures);
+		m_geometry = std::exchange(other.m_geometry, Geometry_Arena::INVALID_HANDLE);
+		m_format = other.m_format;
+		m_bounds = other.m_bounds;
+		m_bounding_volume = other.m_bounding_volume;
+		m_lods = std::move(other.m_lods);
+		m_meshlets = std::move(other.m_meshlets);
+		m_two_sided = other.m_two_sided;
+		m_material_bindings = std::move(other.m_material_bindings);
+	}
+
+	return *this;
+}
+
+Mesh::~Mesh() {
+	if (m_geometry != Geometry_Arena::INVALID_HANDLE) {
+		Geometry_Arena::get(m_format).free(m_geometry);
+	}
+	release_textures();
+}
+
+void Mesh::release_textures() {
+	Texture_Registry& registry = Texture_Registry::shared();
+	for (const Material_Texture& texture : textures) {
+		registry.release(texture.handle);
+	}
+	textures.clear();
 }
 
 void Mesh::draw(Shader_Program& shader) {
-	unsigned int curr_diffuse = 1;
-	unsigned int curr_specular = 1;
+	Geometry_Arena::get(m_format).bind();
+	draw_bound(shader);
+	glBindVertexArray(0);
+}
 
-	for (size_t i = 0; i < textures.size(); i++) {
-		Texture& texture = textures[i];
+void Mesh::draw_bound(Shader_Program& shader, size_t lod) {
+	set_draw_uniforms(shader);
 
-		std::string number;
-		if (texture.type == "texture_diffuse") {
-			number = std::to_string(curr_diffuse++);
-		} else if (texture.type == "texture_specular") {
-			//number = std::to_string(curr_specular++);
+	const Geometry_Arena::Range& range = geometry();
+	const Mesh_Lod& level = m_lods[lod];
+	glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(level.index_count), GL_UNSIGNED_INT,
+							 (void*)((range.first_index + level.first_index) * sizeof(unsigned int)),
+							 static_cast<GLint>(range.first_vertex));
+
+	Frame_Stats& stats = frame_stats::current();
+	stats.draw_calls++;
+	stats.triangles += level.index_count / 3;
+}
+
+void Mesh::draw_meshlets_bound(Shader_Program& shader,
+							   const Frustum& frustum,
+							   const glm::vec3& camera,
+							   bool cull_backfacing,
+							   Meshlet_Batch& batch) {
+	const Geometry_Arena::Range& range = geometry();
+	Frame_Stats& stats = frame_stats::current();
+
+	// meshlets are consecutive index ranges, so runs of visible ones become a single draw
+	batch.clear();
+	uint32_t run_end = UINT32_MAX;
+	for (const Meshlet& meshlet : m_meshlets) {
+		if (!meshlet::is_visible(meshlet, frustum, camera, cull_backfacing)) {
+			stats.triangles_culled += meshlet.index_count / 3;
 			continue;
 		}
 
-		std::string uniform_name = "material." + texture.type + number;
-		shader.set_texture(uniform_name, texture, static_cast<GLenum>(i));
+		stats.triangles += meshlet.index_count / 3;
+		if (meshlet.first_index == run_end) {
+			batch.counts.back() += static_cast<GLsizei>(meshlet.index_count);
+		} else {
+			batch.counts.push_back(static_cast<GLsizei>(meshlet.index_count));
+			batch.offsets.push_back((void*)((range.first_index + meshlet.first_index) * sizeof(unsigned int)));
+			batch.base_vertices.push_back(static_cast<GLint>(range.first_vertex));
+		}
+		run_end = meshlet.first_index + meshlet.index_count;
 	}
 
-	glBindVertexArray(m_vao);
-	glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+	if (batch.counts.empty()) {
+		return;
+	}
+
+	set_draw_uniforms(shader);
+	glMultiDrawElementsBaseVertex(GL_TRIANGLES, batch.counts.data(), GL_UNSIGNED_INT, batch.offsets.data(),
+								  static_cast<GLsizei>(batch.counts.size()), batch.base_vertices.data());
+	stats.draw_calls++;
 }
 
-void Mesh::setup_mesh() {
-	glGenVertexArrays(1, &m_vao);
-	glGenBuffers(1, &m_vbo);
-	glGenBuffers(1, &m_ebo);
+void Mesh::draw_instanced_bound(Shader_Program& shader, size_t instance_count) {
+	set_draw_uniforms(shader);
 
-	glBindVertexArray(m_vao);
-	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	const Geometry_Arena::Range& range = geometry();
+	const Mesh_Lod& level = m_lods[0];
+	glDrawElementsInstancedBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(level.index_count), GL_UNSIGNED_INT,
+									  (void*)((range.first_index + level.first_index) * sizeof(unsigned int)),
+									  static_cast<GLsizei>(instance_count), static_cast<GLint>(range.first_vertex));
+
+	Frame_Stats& stats = frame_stats::current();
+	stats.draw_calls++;
+	stats.triangles += level.index_count / 3 * instance_count;
+}
 
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+size_t Mesh::select_lod(float max_error) const {
+	size_t level = 0;
+	while (level + 1 < m_lods.size() && m_lods[level + 1].error <= max_error) {
+		level++;
+	}
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+	return level;
+}
 
-	// vertex positions
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-	// vertex normals
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-	// vertex texture coords
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tex_coords));
+void Mesh::set_draw_uniforms(Shader_Program& shader) {
+	bind_textures(shader);
 
-	glBindVertexArray(0);
+	if (m_format == Vertex_Format::packed) {
+		shader.set_vec3("meshBoundsMin", m_bounds.min);
+		shader.set_vec3("meshBoundsExtent", m_bounds.extent);
+	}
 }
 
-void Model::draw(Shader_Program& shader) {
+void Mesh::bind_textures(Shader_Program& shader) const {
+	m_material_bindings.apply(shader, textures);
+}
+
+void Mesh::request_texture_detail(float uv_per_pixel) const {
+	Texture_Streamer& streamer = Texture_Streamer::shared();
+	for (const Material_Texture& texture : textures) {
+		streamer.request(texture.handle, uv_per_pixel);
+	}
+}
+
+GLuint64 Mesh::diffuse_texture_handle() const {
+	if (!Bindless_Textures::supported()) {
+		return 0;
+	}
+
+	for (const Material_Texture& texture : textures) {
+		if (texture.type == "texture_diffuse") {
+			if (Texture_Streamer::shared().contains(texture.handle)) {
+				return 0;
+			}
+			return Bindless_Textures::shared().handle(Texture_Registry::shared().get(texture.handle).id);
+		}
+	}
+
+	return 0;
+}
+
+void Mesh::setup_mesh(std::span<const Vertex> vertices, std::span<const unsigned int> indices) {
+	Geometry_Arena& arena = Geometry_Arena::get(m_format);
+	m_geometry = arena.allocate(vertices.size(), indices.size());
+	m_bounding_volume = bounds::calculate(vertices, indices);
+
+	if (m_format == Vertex_Format::packed) {
+		m_bounds = vertex_format::calculate_bounds(vertices);
+		std::vector<Packed_Vertex> packed = vertex_format::pack(vertices, m_bounds);
+		arena.upload_vertices(m_geometry, std::as_bytes(std::span(packed)));
+	} else {
+		arena.upload_vertices(m_geometry, std::as_bytes(vertices));
+	}
+
+	arena.upload_indices(m_geometry, indices);
+}
+
+void Mesh::set_lods(std::span<const Mesh_Lod> lods, size_t index_count) {
+	if (lods.empty()) {
+		m_lods = {{0, static_cast<uint32_t>(index_count), 0.0f}};
+	} else {
+		m_lods.assign(lods.begin(), lods.end());
+	}
+}
+
+void Mesh::keep_resident(std::span<const Vertex> vertices,
+						 std::span<const unsigned int> indices,
+						 Residency residency) {
+	switch (residency) {
+		case Residency::keep:
+			this->vertices.assign(vertices.begin(), vertices.end());
+			this->indices.assign(indices.begin(), indices.end());
+			break;
+		case Residency::positions_only:
+			keep_positions(vertices);
+			this->indices.assign(indices.begin(), indices.end());
+			break;
+		case Residency::drop:
+			break;
+	}
+}
+
+void Mesh::keep_positions(std::span<const Vertex> vertices) {
+	positions.resize(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++) {
+		positions[i] = vertices[i].position;
+	}
+}
+
+void Model::draw(Shader_Program& shader, const glm::mat4& transform) {
+	uint64_t allocations_before = frame_stats::thread_allocations();
+	scene_graph.update();
+
+	Uniform<glm::mat4> model = shader.uniform<glm::mat4>("model");
+	Geometry_Arena::get(m_options.vertex_format).bind();
 	for (unsigned int i = 0; i < meshes.size(); i++) {
-		meshes[i].draw(shader);
+		shader.set_mat4(model, transform * scene_graph.world(mesh_nodes[i]));
+		// without a view there's no telling how large the textures end up on screen
+		meshes[i].request_texture_detail(0.0f);
+		meshes[i].draw_bound(shader);
+	}
+	glBindVertexArray(0);
+
+	frame_stats::current().draw_allocations += frame_stats::thread_allocations() - allocations_before;
+}
+
+size_t Model::select_lod(size_t mesh_index, const Render_View& view) const {
+	const Mesh& mesh = meshes[mesh_index];
+	if (mesh.lod_count() == 1) {
+		return 0;
+	}
+
+	// distance to the closest point of the bounding sphere, a camera inside it always gets full detail
+	float radius = m_cull_batch.radius(mesh_index);
+	float distance = glm::length(m_cull_batch.center(mesh_index) - view.position) - radius;
+	if (distance <= 0.0f) {
+		return 0;
+	}
+
+	// world error = object error * scale, screen error = world error * projection_scale / distance
+	float object_radius = mesh.bounding_volume().sphere.radius;
+	float scale = object_radius > 0.0f ? radius / object_radius : 1.0f;
+	return mesh.select_lod(view.max_error_pixels * distance / (view.projection_scale * scale));
+}
+
+void Model::draw_instanced(Shader_Program& shader, std::span<const glm::mat4> transforms) {
+	if (transforms.empty()) {
+		return;
+	}
+
+	uint64_t allocations_before = frame_stats::thread_allocations();
+	scene_graph.update();
+	m_instances.update(transforms);
+
+	Geometry_Arena::get(m_options.vertex_format).bind();
+	m_instances.enable_attributes();
+	shader.set_bool("packedVertices", m_options.vertex_format == Vertex_Format::packed);
+	Uniform<glm::mat4> model = shader.uniform<glm::mat4>("model");
+	for (size_t i = 0; i < meshes.size(); i++) {
+		shader.set_mat4(model, scene_graph.world(mesh_nodes[i]));
+		meshes[i].request_texture_detail(0.0f);
+		meshes[i].draw_instanced_bound(shader, transforms.size());
+	}
+	Instance_Buffer::disable_attributes();
+	glBindVertexArray(0);
+
+	frame_stats::current().draw_allocations += frame_stats::thread_allocations() - allocations_before;
+}
+
+void Model::draw(Shader_Program& shader, const Render_View& view, const glm::mat4& transform) {
+	uint64_t allocations_before = frame_stats::thread_allocations();
+	scene_graph.update();
+
+	m_cull_batch.clear();
+	for (size_t i = 0; i < meshes.size(); i++) {
+		m_cull_batch.add(meshes[i].bounding_volume(), transform * scene_graph.world(mesh_nodes[i]));
+	}
+	size_t visible = m_cull_batch.cull(view.frustum);
+
+	Frame_Stats& stats = frame_stats::current();
+	stats.meshes_drawn += visible;
+	stats.meshes_culled += meshes.size() - visible;
+
+	bool culls_backfaces = m_options.meshlet_culling && meshlet::culls_backfaces();
+	Uniform<glm::mat4> model = shader.uniform<glm::mat4>("model");
+	Geometry_Arena::get(m_options.vertex_format).bind();
+	for (size_t i = 0; i < meshes.size(); i++) {
+		Mesh& mesh = meshes[i];
+		if (!m_cull_batch.is_visible(i)) {
+			stats.triangles_culled += mesh.lod(0).index_count / 3;
+			continue;
+		}
+
+		glm::mat4 world = transform * scene_graph.world(mesh_nodes[i]);
+		shader.set_mat4(model, world);
+		mesh.request_texture_detail(Texture_Streamer::uv_per_pixel(mesh.bounding_volume(), m_cull_batch.center(i),
+																   m_cull_batch.radius(i), view));
+		size_t lod = select_lod(i, view);
+		if (lod == 0 && m_options.meshlet_culling && !mesh.meshlets().empty()) {
+			glm::vec3 camera = glm::vec3(glm::inverse(world) * glm::vec4(view.position, 1.0f));
+			bool cull_backfacing = culls_backfaces && !mesh.two_sided() && !meshlet::mirrors(world);
+			mesh.draw_meshlets_bound(shader, view.frustum.to_object_space(world), camera, cull_backfacing,
+									 m_meshlet_batch);
+		} else {
+			mesh.draw_bound(shader, lod);
+		}
 	}
+	glBindVertexArray(0);
+
+	stats.draw_allocations += frame_stats::thread_allocations() - allocations_before;
 }
 
 void Model::load_model(const std::filesystem::path& path) {
+	using Clock = std::chrono::steady_clock;
+	auto elapsed_ms = [](Clock::time_point since) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+	};
+	auto report_memory = [&path](const char* when) {
+		if constexpr (constants::DEBUG) {
+			process_memory::Usage usage = process_memory::query();
+			std::cout << "MODEL::MEMORY " << path << " " << when << ": RSS " << usage.resident / (1024 * 1024)
+					  << " MB, peak " << usage.peak_resident / (1024 * 1024) << " MB" << std::endl;
+		}
+	};
+
+	m_directory = path.parent_path();
+	auto start = Clock::now();
+	m_texture_decode_ms = 0.0;
+	if (load_from_cache(path)) {
+		if constexpr (constants::DEBUG) {
+			std::cout << "MODEL::LOAD " << path << " from cache in " << elapsed_ms(start) << " ms (" << meshes.size()
+					  << " meshes, texture decode " << m_texture_decode_ms << " ms)" << std::endl;
+		}
+		report_memory("after load");
+		return;
+	}
+
+	Model_Data model_data = import_model(path);
+	scene_graph = std::move(model_data.scene_graph);
+
+	// GL objects can only be created on the context thread
+	auto upload_start = Clock::now();
+	meshes.reserve(model_data.meshes.size());
+	mesh_nodes.reserve(model_data.meshes.size());
+	for (Mesh_Data& data : model_data.meshes) {
+		meshes.push_back(Mesh(std::move(data.vertices), std::move(data.indices), load_material_textures(data.textures),
+							  m_options.vertex_format, m_options.residency, data.lods, data.meshlets, data.two_sided));
+		mesh_nodes.push_back(data.node);
+	}
+
+	// whatever is still alive after this is the model's steady state footprint
+	model_data = {};
+	report_memory("after load");
+
+	if constexpr (constants::DEBUG) {
+		std::cout << "MODEL::LOAD " << path << " upload " << elapsed_ms(upload_start) << " ms (texture decode "
+				  << m_texture_decode_ms << " ms)" << std::endl;
+	}
+}
+
+Model_Data Model::import_model(const std::filesystem::path& path) {
+	using Clock = std::chrono::steady_clock;
+	auto elapsed_ms = [](Clock::time_point since) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+	};
+
+	auto start = Clock::now();
 	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(path.string(), aiProcess_Triangulate | aiProcess_GenSmoothNormals |
-																aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+	const aiScene* scene = importer.ReadFile(path.string(), IMPORT_FLAGS);
 
 	if (!scene || !scene->mRootNode || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) {
 		std::cerr << "ERROR::ASSIMP\n" << importer.GetErrorString() << std::endl;
 		exit(-1);
 	}
+	double import_ms = elapsed_ms(start);
 
-	m_directory = path.parent_path();
-	process_node(scene->mRootNode, scene);
+	if constexpr (constants::DEBUG) {
+		process_memory::Usage usage = process_memory::query();
+		std::cout << "MODEL::MEMORY " << path << " after import: RSS " << usage.resident / (1024 * 1024)
+				  << " MB, peak " << usage.peak_resident / (1024 * 1024) << " MB" << std::endl;
+	}
+
+	// the per-mesh conversion is independent CPU work, so it fans out over the pool and lands in node order
+	auto process_start = Clock::now();
+	Model_Data model_data;
+	std::vector<aiMesh*> scene_meshes;
+	std::vector<Scene_Graph::Node> mesh_nodes;
+	process_node(scene->mRootNode, scene, Scene_Graph::INVALID_NODE, model_data.scene_graph, scene_meshes, mesh_nodes);
+	model_data.scene_graph.update();
+
+	std::vector<Mesh_Data>& mesh_data = model_data.meshes;
+	mesh_data.resize(scene_meshes.size());
+	std::vector<mesh_opt::Optimize_Report> reports(scene_meshes.size());
+	Thread_Pool::shared().parallel_for(scene_meshes.size(), [&](size_t i) {
+		mesh_data[i] = process_mesh(scene_meshes[i], scene);
+		mesh_data[i].node = mesh_nodes[i];
+		reports[i] = mesh_opt::optimize(mesh_data[i]);
+		// LOD 0 stays at the front of the indices, where optimize() built the meshlets
+		mesh_opt::generate_lods(mesh_data[i]);
+	});
+	double process_ms = elapsed_ms(process_start);
+
+	if constexpr (constants::DEBUG) {
+		for (size_t i = 0; i < reports.size(); i++) {
+			const mesh_opt::Optimize_Report& report = reports[i];
+			std::cout << "MESH::OPTIMIZE '" << scene_meshes[i]->mName.C_Str() << "' welded "
+					  << report.welded_vertices << " vertices, ACMR " << report.before.acmr << " -> "
+					  << report.after.acmr << ", ATVR " << report.before.atvr << " -> " << report.after.atvr
+					  << std::endl;
+
+			std::cout << "MESH::LOD '" << scene_meshes[i]->mName.C_Str() << "'";
+			for (const Mesh_Lod& lod : mesh_data[i].lods) {
+				std::cout << " " << lod.index_count / 3 << " (error " << lod.error << ")";
+			}
+			std::cout << ", " << mesh_data[i].meshlets.size() << " meshlets" << std::endl;
+		}
+
+		std::cout << "MODEL::IMPORT " << path << " import " << import_ms << " ms, process " << process_ms << " ms ("
+				  << mesh_data.size() << " meshes on " << Thread_Pool::shared().thread_count() + 1 << " threads)"
+				  << std::endl;
+	}
+
+	mesh_cache::write(path, IMPORT_FLAGS, mesh_data, model_data.scene_graph);
+	return model_data;
+}
+
+unsigned int Model::import_flags() {
+	return IMPORT_FLAGS;
 }
 
-void Model::process_node(aiNode* node, const aiScene* scene) {
+bool Model::load_from_cache(const std::filesystem::path& path) {
+	std::optional<mesh_cache::Cache_File> cache = mesh_cache::Cache_File::open(path, IMPORT_FLAGS);
+	if (!cache) {
+		return false;
+	}
+
+	scene_graph = std::move(cache->scene_graph);
+	meshes.reserve(cache->meshes.size());
+	mesh_nodes.reserve(cache->meshes.size());
+	for (const mesh_cache::Mesh_View& view : cache->meshes) {
+		meshes.push_back(Mesh(view.vertices, view.indices, load_material_textures(view.textures),
+							  m_options.vertex_format, m_options.residency, view.lods, view.meshlets, view.two_sided));
+		mesh_nodes.push_back(view.node);
+	}
+
+	return true;
+}
+
+void Model::process_node(aiNode* node,
+						 const aiScene* scene,
+						 Scene_Graph::Node parent,
+						 Scene_Graph& graph,
+						 std::vector<aiMesh*>& scene_meshes,
+						 std::vector<Scene_Graph::Node>& mesh_nodes) {
+	// Assimp matrices are row major, glm takes columns
+	const aiMatrix4x4& m = node->mTransformation;
+	glm::mat4 local(m.a1, m.b1, m.c1, m.d1, m.a2, m.b2, m.c2, m.d2, m.a3, m.b3, m.c3, m.d3, m.a4, m.b4, m.c4, m.d4);
+	Scene_Graph::Node graph_node = graph.add_node(parent, local, node->mName.C_Str());
+
 	for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.push_back(process_mesh(mesh, scene));
+		scene_meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
+		mesh_nodes.push_back(graph_node);
 	}
 
 	for (unsigned int i = 0; i < node->mNumChildren; i++) {
 		aiNode* child = node->mChildren[i];
-		process_node(child, scene);
+		process_node(child, scene, graph_node, graph, scene_meshes, mesh_nodes);
 	}
 }
 
-Mesh Model::process_mesh(aiMesh* mesh, const aiScene* scene) {
-	std::vector<Vertex> vertices;
-	std::vector<unsigned int> indices;
-	std::vector<Texture> textures;
+Mesh_Data Model::process_mesh(aiMesh* mesh, const aiScene* scene) {
+	Mesh_Data data;
+	std::vector<Vertex>& vertices = data.vertices;
+	std::vector<unsigned int>& indices = data.indices;
+	std::vector<Texture_Ref>& textures = data.textures;
 
+	vertices.reserve(mesh->mNumVertices);
 	for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
 		Vertex vertex{};
 
@@ -138,24 +609,92 @@ Mesh Model::process_mesh(aiMesh* mesh, const aiScene* scene) {
 	// process material
 	if (mesh->mMaterialIndex >= 0) {
 		aiMaterial* mat = scene->mMaterials[mesh->mMaterialIndex];
-		std::vector<Texture> diffuse_maps = load_material_textures(mat, aiTextureType_DIFFUSE, "texture_diffuse");
+		std::vector<Texture_Ref> diffuse_maps = material_texture_refs(mat, aiTextureType_DIFFUSE, "texture_diffuse");
 		textures.insert(textures.end(), diffuse_maps.begin(), diffuse_maps.end());
-		std::vector<Texture> specular_maps = load_material_textures(mat, aiTextureType_SPECULAR, "texture_specular");
+		std::vector<Texture_Ref> specular_maps = material_texture_refs(mat, aiTextureType_SPECULAR, "texture_specular");
 		textures.insert(textures.end(), specular_maps.begin(), specular_maps.end());
+
+		int two_sided = 0;
+		data.two_sided = mat->Get(AI_MATKEY_TWOSIDED, two_sided) == AI_SUCCESS && two_sided != 0;
 	}
 
-	return std::move(Mesh(vertices, indices, textures));
+	return data;
 }
 
-std::vector<Texture> Model::load_material_textures(aiMaterial* mat, aiTextureType type, std::string type_name) {
-	std::vector<Texture> textures;
+std::vector<Texture_Ref> Model::material_texture_refs(aiMaterial* mat, aiTextureType type, std::string type_name) {
+	std::vector<Texture_Ref> refs;
 
 	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
 		aiString tex_path;
 		mat->GetTexture(type, i, &tex_path);
-		
-		auto texture = Texture(m_directory / tex_path.C_Str(), type_name);
-		textures.push_back(texture);
+
+		refs.push_back({tex_path.C_Str(), type_name});
+	}
+
+	return refs;
+}
+
+std::vector<Material_Texture> Model::load_material_textures(const std::vector<Texture_Ref>& refs) {
+	using Clock = std::chrono::steady_clock;
+	Texture_Registry& registry = Texture_Registry::shared();
+
+	// references to resident textures are taken up front, so uploading the rest can't evict them
+	std::vector<Material_Texture> textures;
+	textures.reserve(refs.size());
+	for (const Texture_Ref& ref : refs) {
+		textures.push_back({registry.acquire(m_directory / ref.path), ref.type});
+	}
+
+	// decode (or fetch from the texture cache, or map) every map the material still needs at once, then upload in
+	// reference order on this thread
+	auto decode_start = Clock::now();
+	std::vector<std::filesystem::path> paths;
+	std::vector<std::string_view> types;
+	for (size_t i = 0; i < refs.size(); i++) {
+		std::filesystem::path path = m_directory / refs[i].path;
+		if (textures[i].handle == Texture_Registry::INVALID_HANDLE &&
+			std::find(paths.begin(), paths.end(), path) == paths.end()) {
+			paths.push_back(std::move(path));
+			types.push_back(refs[i].type);
+		}
+	}
+
+	const block_compression::Support& support = block_compression::query_support();
+	std::vector<texture_cache::Texture_Source> sources(paths.size());
+	Thread_Pool::shared().parallel_for(paths.size(), [&](size_t i) {
+		sources[i] = texture_cache::load(paths[i], types[i], m_options.compress_textures ? &support : nullptr,
+										 m_options.mip_filter);
+	});
+	m_texture_decode_ms += std::chrono::duration<double, std::milli>(Clock::now() - decode_start).count();
+
+	std::vector<Texture_Registry::Handle> uploaded(paths.size(), Texture_Registry::INVALID_HANDLE);
+	for (size_t i = 0; i < refs.size(); i++) {
+		if (textures[i].handle != Texture_Registry::INVALID_HANDLE) {
+			continue;
+		}
+
+		size_t source_index = std::find(paths.begin(), paths.end(), m_directory / refs[i].path) - paths.begin();
+		Texture_Registry::Handle& handle = uploaded[source_index];
+		texture_cache::Texture_Source& source = sources[source_index];
+		if (handle != Texture_Registry::INVALID_HANDLE) {
+			registry.retain(handle);
+		} else if (source.container || source.compressed) {
+			size_t first_level = m_options.stream_textures ? Texture_Streamer::first_resident_level(source) : 0;
+			Texture texture = source.container
+								  ? Texture(*source.container, GL_REPEAT, GL_REPEAT, first_level)
+								  : Texture(source.compressed, GL_REPEAT, GL_REPEAT, first_level);
+			handle = registry.add(paths[source_index], texture);
+			if (first_level > 0) {
+				Texture_Streamer::shared().add(handle, texture, Texture_Streamer::Source::from(std::move(source)));
+			}
+		} else if (source.image) {
+			handle = registry.add(paths[source_index], Texture(source.image, source.mips));
+		} else {
+			std::cerr << "ERROR::MODEL\n"
+					  << "couldn't load texture '" << paths[source_index] << "', using a placeholder" << std::endl;
+			handle = registry.fallback();
+		}
+		textures[i].handle = handle;
 	}
 
 	return textures;
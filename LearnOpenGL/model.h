@@ -1,50 +1,239 @@
 #pragma once
 
 #include <filesystem>
+#include <span>
 #include <string>
 #include <vector>
-#include <unordered_map>
 
 #include <assimp/scene.h>
 #include <glm/glm.hpp>
 
+#include "bounds.h"
+#include "camera.h"
+#include "culling.h"
+#include "geometry_arena.h"
+#include "instance_buffer.h"
+#include "material.h"
+#include "meshlet.h"
+#include "mipmap.h"
+#include "scene_graph.h"
 #include "shader_program.h"
 #include "texture.h"
+#include "vertex_format.h"
 
-struct Vertex {
-	glm::vec3 position;
-	glm::vec3 normal;
-	glm::vec2 tex_coords;
+// a texture as referenced by a material, relative to the model's directory
+struct Texture_Ref {
+	std::string path;
+	std::string type;
+};
+
+// one level of detail: a range of the mesh's index buffer, all levels share the same vertices
+struct Mesh_Lod {
+	uint32_t first_index = 0;
+	uint32_t index_count = 0;
+	// largest surface deviation from LOD 0, in object-space units
+	float error = 0.0f;
+};
+
+// CPU-side result of importing a single mesh, before anything touches the GPU
+struct Mesh_Data {
+	std::vector<Vertex> vertices;
+	// every LOD's indices back to back, LOD 0 first
+	std::vector<unsigned int> indices;
+	// empty means the whole index buffer is the only LOD
+	std::vector<Mesh_Lod> lods;
+	// clusters of LOD 0
+	std::vector<Meshlet> meshlets;
+	std::vector<Texture_Ref> textures;
+	// the material is meant to be seen from both sides, so its back faces are never culled
+	bool two_sided = false;
+	// the scene graph node that places the mesh
+	Scene_Graph::Node node = 0;
+};
+
+// CPU-side result of importing a whole file
+struct Model_Data {
+	std::vector<Mesh_Data> meshes;
+	Scene_Graph scene_graph;
+};
+
+// what a mesh keeps in system memory once its geometry is on the GPU
+enum class Residency {
+	// vertices and indices stay available
+	keep,
+	// everything is freed right after the upload
+	drop,
+	// only positions and indices stay, e.g. for picking and collision
+	positions_only,
 };
 
 class Mesh {
    public:
+	// which of these are filled depends on the mesh's Residency
 	std::vector<Vertex> vertices;
+	std::vector<glm::vec3> positions;
 	std::vector<unsigned int> indices;
-	std::vector<Texture> textures;
+	// holds a registry reference to each
+	std::vector<Material_Texture> textures;
+
+	// takes ownership of the imported buffers, they are never copied
+	Mesh(std::vector<Vertex>&& vertices,
+		 std::vector<unsigned int>&& indices,
+		 std::vector<Material_Texture>&& textures,
+		 Vertex_Format format = Vertex_Format::full,
+		 Residency residency = Residency::drop,
+		 std::span<const Mesh_Lod> lods = {},
+		 std::span<const Meshlet> meshlets = {},
+		 bool two_sided = false);
+	// uploads straight from the given memory (e.g. a mapped cache file), only copying what `residency` keeps
+	Mesh(std::span<const Vertex> vertices,
+		 std::span<const unsigned int> indices,
+		 std::vector<Material_Texture>&& textures,
+		 Vertex_Format format = Vertex_Format::full,
+		 Residency residency = Residency::drop,
+		 std::span<const Mesh_Lod> lods = {},
+		 std::span<const Meshlet> meshlets = {},
+		 bool two_sided = false);
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+	Mesh(Mesh&& other) noexcept;
+	Mesh& operator=(Mesh&& other) noexcept;
+	~Mesh();
 
-	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
+	// packed meshes need a shader that decodes them, see shaders/model_packed.vert
 	void draw(Shader_Program& shader);
+	// expects the geometry arena for format() to be bound already, so a model only binds it once
+	void draw_bound(Shader_Program& shader, size_t lod = 0);
+	// draws only the LOD 0 meshlets that pass meshlet::is_visible(), `frustum` and `camera` in object space
+	void draw_meshlets_bound(Shader_Program& shader,
+							 const Frustum& frustum,
+							 const glm::vec3& camera,
+							 bool cull_backfacing,
+							 Meshlet_Batch& batch);
+	// same, with the instance attributes already set up on the arena's VAO
+	void draw_instanced_bound(Shader_Program& shader, size_t instance_count);
+	// binds this mesh's textures to the material.* samplers of the shader, allocation free after the first call
+	void bind_textures(Shader_Program& shader) const;
+	// tells the Texture_Streamer the mesh is drawn at `uv_per_pixel` this frame, 0 for full detail
+	void request_texture_detail(float uv_per_pixel) const;
+	// A resident handle for the first diffuse texture where bindless textures are supported, so draws can sample it
+	// without a bind. 0 without support, without a diffuse texture, or while it is streamed or still loading.
+	GLuint64 diffuse_texture_handle() const;
+
+	Vertex_Format format() const { return m_format; }
+	const Geometry_Arena::Range& geometry() const { return Geometry_Arena::get(m_format).range(m_geometry); }
+	// only meaningful for packed meshes
+	const Quantization_Bounds& quantization_bounds() const { return m_bounds; }
+	// object space, for culling
+	const Bounding_Volume& bounding_volume() const { return m_bounding_volume; }
+
+	// first_index is relative to geometry().first_index, there's always at least LOD 0
+	size_t lod_count() const { return m_lods.size(); }
+	const Mesh_Lod& lod(size_t level) const { return m_lods[level]; }
+	std::span<const Meshlet> meshlets() const { return m_meshlets; }
+	bool two_sided() const { return m_two_sided; }
+	// the coarsest LOD whose error stays within `max_error` (object-space units)
+	size_t select_lod(float max_error) const;
 
    private:
-	GLuint m_vao, m_vbo, m_ebo;
+	friend class Model_Loader;
+
+	Geometry_Arena::Handle m_geometry = Geometry_Arena::INVALID_HANDLE;
+	Vertex_Format m_format = Vertex_Format::full;
+	Quantization_Bounds m_bounds;
+	Bounding_Volume m_bounding_volume;
+	std::vector<Mesh_Lod> m_lods;
+	std::vector<Meshlet> m_meshlets;
+	bool m_two_sided = false;
+	Material_Bindings m_material_bindings;
+
+	// only allocates the geometry, Model_Loader streams the data in afterwards
+	Mesh(size_t vertex_count,
+		 size_t index_count,
+		 std::vector<Material_Texture>&& textures,
+		 Vertex_Format format,
+		 const Quantization_Bounds& bounds,
+		 const Bounding_Volume& bounding_volume,
+		 std::span<const Mesh_Lod> lods,
+		 std::span<const Meshlet> meshlets,
+		 bool two_sided);
+
+	// textures and packed vertex bounds
+	void set_draw_uniforms(Shader_Program& shader);
+	void setup_mesh(std::span<const Vertex> vertices, std::span<const unsigned int> indices);
+	void set_lods(std::span<const Mesh_Lod> lods, size_t index_count);
+	// copies whatever `residency` says to keep
+	void keep_resident(std::span<const Vertex> vertices, std::span<const unsigned int> indices, Residency residency);
+	void keep_positions(std::span<const Vertex> vertices);
+	void release_textures();
+};
 
-	void setup_mesh();
+struct Model_Options {
+	// Vertex_Format::packed halves vertex memory, at the cost of needing shaders/model_packed.vert
+	Vertex_Format vertex_format = Vertex_Format::full;
+	Residency residency = Residency::drop;
+	// cull meshes drawn at LOD 0 per meshlet in Model::draw(shader, view); the normal cone test only applies while
+	// back faces are culled (see meshlet::culls_backfaces()), the frustum test always
+	bool meshlet_culling = true;
+	// store textures block-compressed where the context supports it, cached under CACHE_PATH
+	bool compress_textures = true;
+	// how texture mips are built on the CPU
+	mipmap::Filter mip_filter = mipmap::Filter::kaiser;
+	// upload only the small mips of compressed textures and let the Texture_Streamer bring in the rest on demand
+	bool stream_textures = true;
 };
 
 class Model {
    public:
 	std::vector<Mesh> meshes;
+	// the file's node hierarchy, move parts with scene_graph.set_local()
+	Scene_Graph scene_graph;
+	// parallel to meshes
+	std::vector<Scene_Graph::Node> mesh_nodes;
 
-	Model(const std::filesystem::path& path) { load_model(path); }
-	void draw(Shader_Program& shader);
+	Model(const std::filesystem::path& path, Model_Options options = {}) : m_options(options) { load_model(path); }
+	// sets the "model" uniform per mesh to `transform` times the mesh's node transform
+	void draw(Shader_Program& shader, const glm::mat4& transform = glm::mat4(1.0f));
+	// skips meshes whose bounds, placed by `transform`, are entirely outside the view's frustum, and draws the rest at
+	// the coarsest LOD that stays within the view's screen-space error
+	void draw(Shader_Program& shader, const Render_View& view, const glm::mat4& transform = glm::mat4(1.0f));
+	// one instanced draw call per mesh, needs a shader with the instance attributes of shaders/model_instanced.vert
+	void draw_instanced(Shader_Program& shader, std::span<const glm::mat4> transforms);
+	// recomputes the world transforms of moved nodes, draw() does this on its own
+	void update_transforms() { scene_graph.update(); }
+
+	// Assimp import plus the CPU-side mesh processing, refreshes the mesh cache; safe to call from any thread
+	static Model_Data import_model(const std::filesystem::path& path);
+	// the flags the mesh cache is keyed on
+	static unsigned int import_flags();
 
    private:
-	std::unordered_map<std::filesystem::path, Texture> textures_loaded;
+	friend class Model_Loader;
+
 	std::filesystem::path m_directory;
+	// time spent in load_material_textures decoding images during the current load
+	double m_texture_decode_ms = 0.0;
+	Model_Options m_options;
+	Cull_Batch m_cull_batch;
+	Instance_Buffer m_instances;
+	Meshlet_Batch m_meshlet_batch;
+
+	// an empty model for Model_Loader to fill in
+	explicit Model(Model_Options options) : m_options(options) {}
 
 	void load_model(const std::filesystem::path& path);
-	void process_node(aiNode* node, const aiScene* scene);
-	Mesh process_mesh(aiMesh* mesh, const aiScene* scene);
-	std::vector<Texture> load_material_textures(aiMaterial* mat, aiTextureType type, std::string type_name);
-};
\ No newline at end of file
+	// expects m_cull_batch to hold this frame's bounds
+	size_t select_lod(size_t mesh_index, const Render_View& view) const;
+	bool load_from_cache(const std::filesystem::path& path);
+	// mirrors the node hierarchy into `graph` and collects the scene's meshes in node order, with the node of each
+	static void process_node(aiNode* node,
+							 const aiScene* scene,
+							 Scene_Graph::Node parent,
+							 Scene_Graph& graph,
+							 std::vector<aiMesh*>& scene_meshes,
+							 std::vector<Scene_Graph::Node>& mesh_nodes);
+	// CPU-only, safe to call from worker threads
+	static Mesh_Data process_mesh(aiMesh* mesh, const aiScene* scene);
+	static std::vector<Texture_Ref> material_texture_refs(aiMaterial* mat, aiTextureType type, std::string type_name);
+	std::vector<Material_Texture> load_material_textures(const std::vector<Texture_Ref>& refs);
+};
@@ -0,0 +1,377 @@
+#include "model_loader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "block_compression.h"
+#include "bounds.h"
+#include "config.h"
+#include "geometry_arena.h"
+#include "mesh_cache.h"
+#include "mipmap.h"
+#include "texture.h"
+#include "texture_cache.h"
+#include "texture_container.h"
+#include "texture_registry.h"
+#include "texture_streamer.h"
+#include "thread_pool.h"
+#include "upload_queue.h"
+#include "vertex_format.h"
+
+// keeps a single upload job well under a millisecond on typical hardware
+static constexpr size_t UPLOAD_SLICE_BYTES = 1024 * 1024;
+
+namespace {
+struct Pending_Mesh {
+	std::span<const Vertex> vertices;
+	std::span<const unsigned int> indices;
+	std::span<const Mesh_Lod> lods;
+	std::span<const Meshlet> meshlets;
+	std::vector<Texture_Ref> textures;
+	bool two_sided = false;
+	// filled on the loader thread when the model uses the packed vertex format
+	std::vector<Packed_Vertex> packed;
+	Quantization_Bounds bounds;
+	Bounding_Volume bounding_volume;
+	Scene_Graph::Node node = 0;
+};
+
+struct Pending_Texture {
+	std::filesystem::path path;
+	// the material slot of the first mesh that uses the file, which picks its block format
+	std::string type;
+	texture_cache::Texture_Source source;
+	// the finer levels are left to the Texture_Streamer
+	size_t first_level = 0;
+	Texture texture;
+	// the pending model's reference, once the texture is resident
+	Texture_Registry::Handle handle = Texture_Registry::INVALID_HANDLE;
+};
+}  // namespace
+
+// everything the upload jobs reference, kept alive until the last one has run
+struct Model_Loader::Pending_Model {
+	std::optional<mesh_cache::Cache_File> cache;
+	Model_Data model_data;
+	std::vector<Pending_Mesh> meshes;
+	std::vector<Pending_Texture> textures;
+	std::unordered_map<std::filesystem::path, size_t> texture_indices;
+
+	// the meshes hold their own references by now, or the load was abandoned
+	~Pending_Model() {
+		for (const Pending_Texture& texture : textures) {
+			Texture_Registry::shared().release(texture.handle);
+		}
+	}
+};
+
+// Copies a slice into the Pixel_Buffer_Ring from the loader thread, so the context thread only issues the upload.
+// Held by a shared_ptr as upload jobs have to be copyable; empty if the ring was full.
+static std::shared_ptr<Pixel_Buffer_Ring::Staging> stage_slice(const void* data, size_t size) {
+	return std::make_shared<Pixel_Buffer_Ring::Staging>(
+		Pixel_Buffer_Ring::shared().try_stage({static_cast<const std::byte*>(data), size}));
+}
+
+void Model_Handle::draw(Shader_Program& shader) const {
+	if (Model* model = get()) {
+		model->draw(shader);
+	}
+}
+
+void Model_Handle::draw(Shader_Program& shader, const Render_View& view, const glm::mat4& transform) const {
+	if (Model* model = get()) {
+		model->draw(shader, view, transform);
+	}
+}
+
+void Model_Handle::draw_instanced(Shader_Program& shader, std::span<const glm::mat4> transforms) const {
+	if (Model* model = get()) {
+		model->draw_instanced(shader, transforms);
+	}
+}
+
+void Model_Loader::queue_texture_uploads(const std::shared_ptr<Pending_Model>& pending, size_t texture_index) {
+	Upload_Queue& queue = Upload_Queue::shared();
+	const texture_cache::Texture_Source& source = pending->textures[texture_index].source;
+	if (!source.container && !source.image && !source.compressed) {
+		// nothing to upload if it was already resident, else it couldn't be loaded
+		if (pending->textures[texture_index].handle == Texture_Registry::INVALID_HANDLE) {
+			std::cerr << "ERROR::MODEL_LOADER\n"
+					  << "couldn't load texture '" << pending->textures[texture_index].path
+					  << "', using a placeholder" << std::endl;
+			queue.push([pending, texture_index]() {
+				pending->textures[texture_index].handle = Texture_Registry::shared().fallback();
+			});
+		}
+		return;
+	}
+	size_t first_level = pending->textures[texture_index].first_level;
+
+	queue.push([pending, texture_index]() {
+		Pending_Texture& texture = pending->textures[texture_index];
+		// another model may have finished uploading the same file since it was decoded
+		texture.handle = Texture_Registry::shared().acquire(texture.path);
+		if (texture.handle != Texture_Registry::INVALID_HANDLE) {
+			return;
+		}
+
+		if (texture.source.container) {
+			texture.texture = Texture::allocate(*texture.source.container, GL_REPEAT, GL_REPEAT, texture.first_level);
+		} else if (texture.source.compressed) {
+			texture.texture = Texture::allocate(texture.source.compressed, GL_REPEAT, GL_REPEAT, texture.first_level);
+		} else {
+			texture.texture = Texture::allocate(texture.source.image, texture.source.mips);
+		}
+	});
+
+	if (source.container) {
+		const texture_container::Container& container = *source.container;
+		for (size_t level = first_level; level < container.levels.size(); level++) {
+			// specifying a large level's storage is costly by itself, so it gets a job of its own
+			queue.push([pending, texture_index, level]() {
+				Pending_Texture& texture = pending->textures[texture_index];
+				if (texture.handle == Texture_Registry::INVALID_HANDLE) {
+					texture.texture.allocate_level(*texture.source.container, level);
+				}
+			});
+			uint32_t rows = texture_container::row_count(container, level);
+			size_t row_size = texture_container::row_size(container, level);
+			uint32_t rows_per_slice = static_cast<uint32_t>(std::max<size_t>(1, UPLOAD_SLICE_BYTES / row_size));
+			for (uint32_t first_row = 0; first_row < rows; first_row += rows_per_slice) {
+				uint32_t row_count = std::min(rows_per_slice, rows - first_row);
+				auto staged = stage_slice(container.levels[level].images[0].data() + first_row * row_size,
+										  row_count * row_size);
+				queue.push([pending, texture_index, level, first_row, row_count, staged]() {
+					Pending_Texture& texture = pending->textures[texture_index];
+					if (texture.handle == Texture_Registry::INVALID_HANDLE) {
+						texture.texture.upload_rows(*texture.source.container, level, first_row, row_count,
+													std::move(*staged));
+					}
+				});
+			}
+		}
+	} else if (source.compressed) {
+		const block_compression::Compressed_Image& image = source.compressed;
+		for (size_t level = first_level; level < image.levels.size(); level++) {
+			uint32_t block_rows = block_compression::block_count(image.levels[level].height);
+			size_t row_size = image.levels[level].size / block_rows;
+			uint32_t rows_per_slice = static_cast<uint32_t>(std::max<size_t>(1, UPLOAD_SLICE_BYTES / row_size));
+			for (uint32_t first_row = 0; first_row < block_rows; first_row += rows_per_slice) {
+				uint32_t row_count = std::min(rows_per_slice, block_rows - first_row);
+				auto staged = stage_slice(image.level_data(level).data() + first_row * row_size, row_count * row_size);
+				queue.push([pending, texture_index, level, first_row, row_count, staged]() {
+					Pending_Texture& texture = pending->textures[texture_index];
+					if (texture.handle == Texture_Registry::INVALID_HANDLE) {
+						texture.texture.upload_blocks(texture.source.compressed, level, first_row, row_count,
+													  std::move(*staged));
+					}
+				});
+			}
+		}
+	} else {
+		const Image& image = source.image;
+		int rows_per_slice = static_cast<int>(std::max<size_t>(1, UPLOAD_SLICE_BYTES / image.row_size()));
+		for (int first_row = 0; first_row < image.height; first_row += rows_per_slice) {
+			int row_count = std::min(rows_per_slice, image.height - first_row);
+			auto staged = stage_slice(image.pixels.get() + first_row * image.row_size(), row_count * image.row_size());
+			queue.push([pending, texture_index, first_row, row_count, staged]() {
+				Pending_Texture& texture = pending->textures[texture_index];
+				if (texture.handle == Texture_Registry::INVALID_HANDLE) {
+					texture.texture.upload_rows(texture.source.image, first_row, row_count, std::move(*staged));
+				}
+			});
+		}
+
+		// the mips were built on the loader thread, level 1 first
+		for (size_t mip = 0; mip < source.mips.size(); mip++) {
+			const mipmap::Level& level = source.mips[mip];
+			int rows_per_slice = static_cast<int>(std::max<size_t>(1, UPLOAD_SLICE_BYTES / level.row_size()));
+			for (int first_row = 0; first_row < level.height; first_row += rows_per_slice) {
+				int row_count = std::min(rows_per_slice, level.height - first_row);
+				size_t row_size = level.row_size();
+				auto staged = stage_slice(level.pixels.data() + first_row * row_size, row_count * row_size);
+				queue.push([pending, texture_index, mip, first_row, row_count, staged]() {
+					Pending_Texture& texture = pending->textures[texture_index];
+					if (texture.handle == Texture_Registry::INVALID_HANDLE) {
+						texture.texture.upload_rows(texture.source.mips[mip], static_cast<GLint>(mip + 1), first_row,
+													row_count, std::move(*staged));
+					}
+				});
+			}
+		}
+	}
+
+	queue.push([pending, texture_index]() {
+		Pending_Texture& texture = pending->textures[texture_index];
+		if (texture.handle == Texture_Registry::INVALID_HANDLE) {
+			texture.texture.finish_upload();
+			texture.handle = Texture_Registry::shared().add(texture.path, texture.texture);
+			if (texture.first_level > 0) {
+				Texture_Streamer::shared().add(texture.handle, texture.texture,
+											   Texture_Streamer::Source::from(std::move(texture.source)));
+			}
+		}
+		texture.source = {};
+	});
+}
+
+void Model_Loader::queue_mesh_uploads(const std::shared_ptr<Pending_Model>& pending,
+									  Model* model,
+									  size_t mesh_index,
+									  Vertex_Format format) {
+	Upload_Queue& queue = Upload_Queue::shared();
+	const Pending_Mesh& mesh = pending->meshes[mesh_index];
+
+	queue.push([pending, model, mesh_index, format]() {
+		const Pending_Mesh& mesh = pending->meshes[mesh_index];
+		std::vector<Material_Texture> textures;
+		for (const Texture_Ref& ref : mesh.textures) {
+			auto it = pending->texture_indices.find(model->m_directory / ref.path);
+			Texture_Registry::Handle handle = pending->textures[it->second].handle;
+			Texture_Registry::shared().retain(handle);
+			textures.push_back({handle, ref.type});
+		}
+
+		model->meshes.push_back(Mesh(mesh.vertices.size(), mesh.indices.size(), std::move(textures), format,
+									 mesh.bounds, mesh.bounding_volume, mesh.lods, mesh.meshlets, mesh.two_sided));
+	});
+
+	std::span<const std::byte> vertex_bytes =
+		format == Vertex_Format::packed ? std::as_bytes(std::span(mesh.packed)) : std::as_bytes(mesh.vertices);
+	size_t stride = vertex_format::stride(format);
+	size_t vertices_per_slice = std::max<size_t>(1, UPLOAD_SLICE_BYTES / stride);
+	for (size_t first = 0; first < mesh.vertices.size(); first += vertices_per_slice) {
+		std::span<const std::byte> slice =
+			vertex_bytes.subspan(first * stride, std::min(vertices_per_slice, mesh.vertices.size() - first) * stride);
+		queue.push([pending, model, mesh_index, format, slice, first]() {
+			Geometry_Arena::get(format).upload_vertices(model->meshes[mesh_index].m_geometry, slice, first);
+		});
+	}
+
+	size_t indices_per_slice = UPLOAD_SLICE_BYTES / sizeof(unsigned int);
+	for (size_t first = 0; first < mesh.indices.size(); first += indices_per_slice) {
+		std::span<const unsigned int> slice =
+			mesh.indices.subspan(first, std::min(indices_per_slice, mesh.indices.size() - first));
+		queue.push([pending, model, mesh_index, format, slice, first]() {
+			Geometry_Arena::get(format).upload_indices(model->meshes[mesh_index].m_geometry, slice, first);
+		});
+	}
+
+	queue.push([pending, model, mesh_index]() {
+		const Pending_Mesh& mesh = pending->meshes[mesh_index];
+		model->meshes[mesh_index].keep_resident(mesh.vertices, mesh.indices, model->m_options.residency);
+	});
+}
+
+Model_Handle Model_Loader::load_async(const std::filesystem::path& path, Model_Options options) {
+	Model_Handle handle;
+	handle.m_state = std::make_shared<Model_Handle::State>();
+	handle.m_state->model.reset(new Model(options));
+	handle.m_state->model->m_directory = path.parent_path();
+	// has to be asked on the context thread
+	block_compression::Support support = block_compression::query_support();
+
+	Thread_Pool::shared().submit([state = handle.m_state, path, options, support]() {
+		using Clock = std::chrono::steady_clock;
+		auto start = Clock::now();
+
+		auto pending = std::make_shared<Pending_Model>();
+		Model* model = state->model.get();
+		pending->cache = mesh_cache::Cache_File::open(path, Model::import_flags());
+		if (pending->cache) {
+			for (const mesh_cache::Mesh_View& view : pending->cache->meshes) {
+				Pending_Mesh& mesh = pending->meshes.emplace_back();
+				mesh.vertices = view.vertices;
+				mesh.indices = view.indices;
+				mesh.lods = view.lods;
+				mesh.meshlets = view.meshlets;
+				mesh.two_sided = view.two_sided;
+				mesh.textures = view.textures;
+				mesh.node = view.node;
+			}
+			model->scene_graph = std::move(pending->cache->scene_graph);
+		} else {
+			pending->model_data = Model::import_model(path);
+			for (const Mesh_Data& data : pending->model_data.meshes) {
+				Pending_Mesh& mesh = pending->meshes.emplace_back();
+				mesh.vertices = data.vertices;
+				mesh.indices = data.indices;
+				mesh.lods = data.lods;
+				mesh.meshlets = data.meshlets;
+				mesh.two_sided = data.two_sided;
+				mesh.textures = data.textures;
+				mesh.node = data.node;
+			}
+			model->scene_graph = std::move(pending->model_data.scene_graph);
+		}
+
+		// the context thread doesn't look at the model until it's ready, so these can be filled in from here
+		for (Pending_Mesh& mesh : pending->meshes) {
+			model->mesh_nodes.push_back(mesh.node);
+			mesh.bounding_volume = bounds::calculate(mesh.vertices, mesh.indices);
+			if (options.vertex_format == Vertex_Format::packed) {
+				mesh.bounds = vertex_format::calculate_bounds(mesh.vertices);
+				mesh.packed = vertex_format::pack(mesh.vertices, mesh.bounds);
+			}
+
+			for (const Texture_Ref& ref : mesh.textures) {
+				std::filesystem::path texture_path = model->m_directory / ref.path;
+				if (pending->texture_indices.emplace(texture_path, pending->textures.size()).second) {
+					Pending_Texture& texture = pending->textures.emplace_back();
+					texture.path = texture_path;
+					texture.type = ref.type;
+				}
+			}
+		}
+
+		// textures that are already resident only need a reference
+		Thread_Pool::shared().parallel_for(pending->textures.size(), [&](size_t i) {
+			Pending_Texture& texture = pending->textures[i];
+			texture.handle = Texture_Registry::shared().acquire(texture.path);
+			if (texture.handle != Texture_Registry::INVALID_HANDLE) {
+				return;
+			}
+			texture.source =
+				texture_cache::load(texture.path, texture.type, options.compress_textures ? &support : nullptr,
+									options.mip_filter);
+			if (options.stream_textures) {
+				texture.first_level = Texture_Streamer::first_resident_level(texture.source);
+			}
+		});
+
+		if constexpr (constants::DEBUG) {
+			std::cout << "MODEL::LOAD_ASYNC " << path << " prepared " << pending->meshes.size() << " meshes and "
+					  << pending->textures.size() << " textures in "
+					  << std::chrono::duration<double, std::milli>(Clock::now() - start).count() << " ms" << std::endl;
+		}
+
+		Upload_Queue& queue = Upload_Queue::shared();
+		for (size_t i = 0; i < pending->textures.size(); i++) {
+			queue_texture_uploads(pending, i);
+		}
+
+		size_t mesh_count = pending->meshes.size();
+		queue.push([model, mesh_count]() { model->meshes.reserve(mesh_count); });
+		for (size_t i = 0; i < mesh_count; i++) {
+			queue_mesh_uploads(pending, model, i, options.vertex_format);
+		}
+
+		queue.push([state, path, start]() {
+			state->ready.store(true, std::memory_order_release);
+
+			if constexpr (constants::DEBUG) {
+				std::cout << "MODEL::LOAD_ASYNC " << path << " ready after "
+						  << std::chrono::duration<double, std::milli>(Clock::now() - start).count() << " ms"
+						  << std::endl;
+			}
+		});
+	});
+
+	return handle;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <span>
+
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "model.h"
+#include "shader_program.h"
+
+// A model that is still being loaded in the background. Stays empty (and draws nothing) until every mesh and texture
+// has reached the GPU.
+class Model_Handle {
+   public:
+	Model_Handle() = default;
+
+	bool is_ready() const { return m_state && m_state->ready.load(std::memory_order_acquire); }
+	// nullptr until the model is ready
+	Model* get() const { return is_ready() ? m_state->model.get() : nullptr; }
+	void draw(Shader_Program& shader) const;
+	void draw(Shader_Program& shader, const Render_View& view, const glm::mat4& transform = glm::mat4(1.0f)) const;
+	void draw_instanced(Shader_Program& shader, std::span<const glm::mat4> transforms) const;
+
+   private:
+	friend class Model_Loader;
+
+	struct State {
+		std::unique_ptr<Model> model;
+		std::atomic<bool> ready = false;
+	};
+
+	std::shared_ptr<State> m_state;
+};
+
+// Imports models and decodes their textures on the shared thread pool, then hands the GL work to the shared upload
+// queue in slices, so it lands over several frames as Upload_Queue::drain() gets to it.
+class Model_Loader {
+   public:
+	static Model_Handle load_async(const std::filesystem::path& path, Model_Options options = {});
+
+   private:
+	struct Pending_Model;
+
+	static void queue_texture_uploads(const std::shared_ptr<Pending_Model>& pending, size_t texture_index);
+	static void queue_mesh_uploads(const std::shared_ptr<Pending_Model>& pending,
+								   Model* model,
+								   size_t mesh_index,
+								   Vertex_Format format);
+};
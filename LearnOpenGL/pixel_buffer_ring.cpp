@@ -0,0 +1,216 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <optional>
+
+#include "config.h"
+#include "pixel_buffer_ring.h"
+
+Pixel_Buffer_Ring::Staging::Staging(Staging&& other) noexcept
+	: m_ring(other.m_ring), m_offset(other.m_offset), m_size(other.m_size) {
+	other.m_ring = nullptr;
+}
+
+Pixel_Buffer_Ring::Staging& Pixel_Buffer_Ring::Staging::operator=(Staging&& other) noexcept {
+	if (this != &other) {
+		if (m_ring) {
+			m_ring->release(m_offset);
+		}
+		m_ring = other.m_ring;
+		m_offset = other.m_offset;
+		m_size = other.m_size;
+		other.m_ring = nullptr;
+	}
+
+	return *this;
+}
+
+Pixel_Buffer_Ring::Staging::~Staging() {
+	if (m_ring) {
+		m_ring->release(m_offset);
+	}
+}
+
+Pixel_Buffer_Ring::Pixel_Buffer_Ring(size_t capacity) : m_capacity(capacity) {}
+
+Pixel_Buffer_Ring& Pixel_Buffer_Ring::shared() {
+	static Pixel_Buffer_Ring ring(constants::UPLOAD_RING_MB * 1024 * 1024);
+	return ring;
+}
+
+bool Pixel_Buffer_Ring::supported() {
+	return GLAD_GL_VERSION_4_4;
+}
+
+Pixel_Buffer_Ring::Staging Pixel_Buffer_Ring::try_stage(std::span<const std::byte> data) {
+	Staging staging = reserve(data.size());
+	if (!staging) {
+		std::lock_guard lock(m_mutex);
+		if (m_mapped) {
+			m_full_count++;
+		}
+		return staging;
+	}
+
+	// the range is ours, the copy doesn't need the lock
+	std::memcpy(m_mapped + staging.m_offset, data.data(), data.size());
+	return staging;
+}
+
+Pixel_Buffer_Ring::Staging Pixel_Buffer_Ring::stage(std::span<const std::byte> data) {
+	create();
+	while (true) {
+		if (Staging staging = reserve(data.size())) {
+			std::memcpy(m_mapped + staging.m_offset, data.data(), data.size());
+			return staging;
+		}
+
+		GLsync oldest = nullptr;
+		{
+			std::lock_guard lock(m_mutex);
+			if (retire_front()) {
+				continue;
+			}
+			// nothing in flight that could make room: `data` is larger than the ring, or the oldest range is still
+			// waiting for its upload to be issued
+			if (m_ranges.empty() || !m_ranges.front().fence) {
+				return {};
+			}
+			oldest = m_ranges.front().fence;
+		}
+
+		// only the context thread deletes fences, so `oldest` stays valid outside the lock
+		auto start = std::chrono::steady_clock::now();
+		glClientWaitSync(oldest, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000'000);
+		double waited_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		std::lock_guard lock(m_mutex);
+		m_stall_count++;
+		m_stall_ms += waited_ms;
+	}
+}
+
+void Pixel_Buffer_Ring::submit(Staging&& staging) {
+	if (!staging) {
+		return;
+	}
+
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	std::lock_guard lock(m_mutex);
+	if (Range* range = find(staging.m_offset)) {
+		range->fence = fence;
+	}
+	staging.m_ring = nullptr;
+}
+
+void Pixel_Buffer_Ring::retire() {
+	create();
+	std::lock_guard lock(m_mutex);
+	while (retire_front()) {
+	}
+}
+
+Pixel_Buffer_Ring::Stats Pixel_Buffer_Ring::stats() const {
+	std::lock_guard lock(m_mutex);
+	return {m_mapped ? m_capacity : 0, m_used_bytes, m_staged_bytes, m_full_count, m_stall_count, m_stall_ms};
+}
+
+void Pixel_Buffer_Ring::create() {
+	if (m_buffer != 0 || !supported()) {
+		return;
+	}
+
+	// coherent, so copies from any thread are visible to the uploads issued after them without a flush
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	GLuint buffer = 0;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+	glBufferStorage(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(m_capacity), nullptr, flags);
+	void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(m_capacity), flags);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (!mapped) {
+		std::cerr << "ERROR::PIXEL_BUFFER_RING\n" << "failed to map the staging buffer" << std::endl;
+	}
+
+	std::lock_guard lock(m_mutex);
+	m_buffer = buffer;
+	m_mapped = static_cast<std::byte*>(mapped);
+}
+
+Pixel_Buffer_Ring::Staging Pixel_Buffer_Ring::reserve(size_t size) {
+	size_t aligned_size = (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+	std::lock_guard lock(m_mutex);
+	if (!m_mapped || size == 0) {
+		return {};
+	}
+
+	// The free space runs from m_head up to the oldest range, wrapping around the end. m_head only catches up with
+	// the oldest range when the ring is empty, so a wrapped allocation has to stop short of it.
+	if (m_ranges.empty()) {
+		m_head = 0;
+	}
+	size_t tail = m_ranges.empty() ? 0 : m_ranges.front().offset;
+	std::optional<size_t> offset;
+	if (m_ranges.empty() || m_head > tail) {
+		if (m_head + aligned_size <= m_capacity) {
+			offset = m_head;
+		} else if (aligned_size < tail) {
+			offset = 0;
+		}
+	} else if (m_head + aligned_size < tail) {
+		offset = m_head;
+	}
+	if (!offset) {
+		return {};
+	}
+
+	m_ranges.push_back({*offset, aligned_size});
+	m_head = *offset + aligned_size;
+	m_used_bytes += aligned_size;
+	m_staged_bytes += size;
+
+	Staging staging;
+	staging.m_ring = this;
+	staging.m_offset = *offset;
+	staging.m_size = size;
+	return staging;
+}
+
+void Pixel_Buffer_Ring::release(size_t offset) {
+	std::lock_guard lock(m_mutex);
+	if (Range* range = find(offset)) {
+		range->released = true;
+	}
+}
+
+Pixel_Buffer_Ring::Range* Pixel_Buffer_Ring::find(size_t offset) {
+	for (Range& range : m_ranges) {
+		if (range.offset == offset) {
+			return &range;
+		}
+	}
+
+	return nullptr;
+}
+
+bool Pixel_Buffer_Ring::retire_front() {
+	if (m_ranges.empty()) {
+		return false;
+	}
+
+	Range& front = m_ranges.front();
+	if (!front.released) {
+		if (!front.fence) {
+			return false;
+		}
+		GLenum status = glClientWaitSync(front.fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+			return false;
+		}
+		glDeleteSync(front.fence);
+	}
+
+	m_used_bytes -= front.size;
+	m_ranges.pop_front();
+	return true;
+}
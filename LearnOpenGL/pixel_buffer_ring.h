@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <span>
+
+#include <glad/glad.h>
+
+// A persistently mapped GL_PIXEL_UNPACK_BUFFER that texture uploads are staged through.
+//
+// Space is handed out in order around the ring. Any thread can reserve a range and copy pixels into it, so loader
+// threads write decoded images straight into memory the GL reads from. The context thread then issues
+// glTex(Sub)Image from the range's offset and submit() puts a fence behind it. A range is reused once its fence has
+// signaled and every range reserved before it was freed too; retire() checks, once a frame.
+//
+// try_stage() never blocks: a loader thread that finds the ring full gets nothing and its upload is staged on the
+// context thread later. stage() may wait on the oldest fence for room, and gives up if the ring is held by ranges
+// that haven't been submitted yet; the caller then hands its pointer to the GL directly.
+//
+// The buffer needs GL 4.4 for glBufferStorage and is created by the first stage() or retire() on the context thread.
+// Until then, or without 4.4, nothing is staged.
+class Pixel_Buffer_Ring {
+   public:
+	// a reserved range, freed unused when dropped without being submitted
+	class Staging {
+	   public:
+		Staging() = default;
+		Staging(Staging&& other) noexcept;
+		Staging& operator=(Staging&& other) noexcept;
+		Staging(const Staging&) = delete;
+		Staging& operator=(const Staging&) = delete;
+		~Staging();
+
+		explicit operator bool() const { return m_ring != nullptr; }
+		// for glTex(Sub)Image while the ring's buffer is bound
+		const void* offset() const { return reinterpret_cast<const void*>(m_offset); }
+		size_t size() const { return m_size; }
+
+	   private:
+		friend class Pixel_Buffer_Ring;
+
+		Pixel_Buffer_Ring* m_ring = nullptr;
+		size_t m_offset = 0;
+		size_t m_size = 0;
+	};
+
+	struct Stats {
+		size_t capacity = 0;
+		// reserved and not yet retired
+		size_t used_bytes = 0;
+		uint64_t staged_bytes = 0;
+		// try_stage() calls that found no room
+		uint64_t full_count = 0;
+		// waits on a fence in stage(), and how long they took
+		uint64_t stall_count = 0;
+		double stall_ms = 0.0;
+	};
+
+	explicit Pixel_Buffer_Ring(size_t capacity);
+	Pixel_Buffer_Ring(const Pixel_Buffer_Ring&) = delete;
+	Pixel_Buffer_Ring& operator=(const Pixel_Buffer_Ring&) = delete;
+	// leaves the GL objects to the context, which is gone by the time the shared ring is destroyed
+	~Pixel_Buffer_Ring() = default;
+
+	// the ring texture uploads go through, constants::UPLOAD_RING_MB large
+	static Pixel_Buffer_Ring& shared();
+	static bool supported();
+
+	// copies `data` into the ring if there is room right now; any thread
+	Staging try_stage(std::span<const std::byte> data);
+	// copies `data` into the ring, waiting for uploads in flight to make room if they have to; context thread only
+	Staging stage(std::span<const std::byte> data);
+	// fences the range behind the upload commands already issued from it; context thread only
+	void submit(Staging&& staging);
+	// frees the ranges whose uploads have finished, call once per frame on the context thread
+	void retire();
+
+	// 0 until the ring is created
+	GLuint buffer() const { return m_buffer; }
+	Stats stats() const;
+
+   private:
+	static constexpr size_t ALIGNMENT = 16;
+
+	struct Range {
+		size_t offset;
+		size_t size;
+		// set by submit(), from then on the range is free once the fence signals
+		GLsync fence = nullptr;
+		// dropped without being submitted
+		bool released = false;
+	};
+
+	mutable std::mutex m_mutex;
+	size_t m_capacity;
+	GLuint m_buffer = 0;
+	std::byte* m_mapped = nullptr;
+	// oldest first
+	std::deque<Range> m_ranges;
+	size_t m_head = 0;
+	size_t m_used_bytes = 0;
+	uint64_t m_staged_bytes = 0;
+	uint64_t m_full_count = 0;
+	uint64_t m_stall_count = 0;
+	double m_stall_ms = 0.0;
+
+	void create();
+	Staging reserve(size_t size);
+	void release(size_t offset);
+	// these expect m_mutex to be held
+	Range* find(size_t offset);
+	bool retire_front();
+};
@@ -0,0 +1,64 @@
+#include <fstream>
+#include <limits>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <sys/resource.h>
+#endif
+
+#include "process_memory.h"
+
+#ifdef _WIN32
+process_memory::Usage process_memory::query() {
+	PROCESS_MEMORY_COUNTERS counters{};
+	if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return {};
+	}
+
+	return {counters.WorkingSetSize, counters.PeakWorkingSetSize};
+}
+#elif defined(__APPLE__)
+process_memory::Usage process_memory::query() {
+	Usage usage;
+
+	mach_task_basic_info info{};
+	mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+	if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) ==
+		KERN_SUCCESS) {
+		usage.resident = info.resident_size;
+	}
+
+	// ru_maxrss is in bytes on macOS
+	rusage resources{};
+	if (getrusage(RUSAGE_SELF, &resources) == 0) {
+		usage.peak_resident = static_cast<size_t>(resources.ru_maxrss);
+	}
+
+	return usage;
+}
+#else
+process_memory::Usage process_memory::query() {
+	Usage usage;
+
+	// both values are reported in kB
+	std::ifstream status("/proc/self/status");
+	std::string key;
+	while (status >> key) {
+		size_t value;
+		if (key == "VmRSS:" && status >> value) {
+			usage.resident = value * 1024;
+		} else if (key == "VmHWM:" && status >> value) {
+			usage.peak_resident = value * 1024;
+		}
+		status.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+	}
+
+	return usage;
+}
+#endif
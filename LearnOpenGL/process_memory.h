@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+
+namespace process_memory {
+
+struct Usage {
+	// bytes of physical memory the process currently uses
+	size_t resident = 0;
+	// high-water mark of `resident` since the process started
+	size_t peak_resident = 0;
+};
+
+// returns zeros on platforms where this isn't implemented
+Usage query();
+
+}
@@ -0,0 +1,109 @@
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SCENE_GRAPH_SSE 1
+#include <xmmintrin.h>
+#endif
+
+#include "scene_graph.h"
+
+// out = a * b for column-major 4x4 matrices, `out` may not alias `a` or `b`
+static void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+#ifdef SCENE_GRAPH_SSE
+	const float* a_ptr = &a[0][0];
+	const float* b_ptr = &b[0][0];
+	float* out_ptr = &out[0][0];
+
+	__m128 a0 = _mm_loadu_ps(a_ptr);
+	__m128 a1 = _mm_loadu_ps(a_ptr + 4);
+	__m128 a2 = _mm_loadu_ps(a_ptr + 8);
+	__m128 a3 = _mm_loadu_ps(a_ptr + 12);
+
+	// every column of the result is a's columns weighted by the matching column of b
+	for (int column = 0; column < 4; column++) {
+		const float* b_column = b_ptr + column * 4;
+		__m128 result = _mm_mul_ps(a0, _mm_set1_ps(b_column[0]));
+		result = _mm_add_ps(result, _mm_mul_ps(a1, _mm_set1_ps(b_column[1])));
+		result = _mm_add_ps(result, _mm_mul_ps(a2, _mm_set1_ps(b_column[2])));
+		result = _mm_add_ps(result, _mm_mul_ps(a3, _mm_set1_ps(b_column[3])));
+		_mm_storeu_ps(out_ptr + column * 4, result);
+	}
+#else
+	out = a * b;
+#endif
+}
+
+Scene_Graph::Node Scene_Graph::add_node(Node parent, const glm::mat4& local, std::string name) {
+	Node node = static_cast<Node>(m_parents.size());
+	m_parents.push_back(parent < node ? parent : INVALID_NODE);
+	m_local.push_back(local);
+	m_world.push_back(local);
+	m_dirty.push_back(1);
+	m_names.push_back(std::move(name));
+
+	m_first_dirty = std::min(m_first_dirty, static_cast<size_t>(node));
+	return node;
+}
+
+void Scene_Graph::reserve(size_t node_count) {
+	m_parents.reserve(node_count);
+	m_local.reserve(node_count);
+	m_world.reserve(node_count);
+	m_dirty.reserve(node_count);
+	m_names.reserve(node_count);
+}
+
+void Scene_Graph::clear() {
+	m_parents.clear();
+	m_local.clear();
+	m_world.clear();
+	m_dirty.clear();
+	m_names.clear();
+	m_first_dirty = 0;
+}
+
+void Scene_Graph::set_local(Node node, const glm::mat4& local) {
+	m_local[node] = local;
+	m_dirty[node] = 1;
+	m_first_dirty = std::min(m_first_dirty, static_cast<size_t>(node));
+}
+
+Scene_Graph::Node Scene_Graph::find(std::string_view name) const {
+	auto it = std::find(m_names.begin(), m_names.end(), name);
+	return it != m_names.end() ? static_cast<Node>(it - m_names.begin()) : INVALID_NODE;
+}
+
+size_t Scene_Graph::update() {
+	size_t count = size();
+	size_t first = m_first_dirty;
+	if (first >= count) {
+		return 0;
+	}
+
+	const Node* parents = m_parents.data();
+	const glm::mat4* local = m_local.data();
+	glm::mat4* world = m_world.data();
+	uint8_t* dirty = m_dirty.data();
+
+	// parents come first, so by the time a node is reached its parent's flag and world transform are final
+	size_t recomputed = 0;
+	for (size_t i = first; i < count; i++) {
+		Node parent = parents[i];
+		if (parent != INVALID_NODE) {
+			dirty[i] |= dirty[parent];
+		}
+
+		if (dirty[i]) {
+			if (parent == INVALID_NODE) {
+				world[i] = local[i];
+			} else {
+				multiply(world[parent], local[i], world[i]);
+			}
+			recomputed++;
+		}
+	}
+
+	std::fill(m_dirty.begin() + first, m_dirty.end(), uint8_t(0));
+	m_first_dirty = count;
+	return recomputed;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Node hierarchy stored as flat arrays in parent-before-child order, so world transforms can be recomputed in a
+// single forward pass without recursion.
+//
+// set_local() only marks a node dirty; update() then recomputes the world transforms of dirty nodes and everything
+// below them, and skips the rest. The pass starts at the first dirty node, so moving a leaf near the end of a large
+// graph only touches that part of it.
+class Scene_Graph {
+   public:
+	using Node = uint32_t;
+	static constexpr Node INVALID_NODE = UINT32_MAX;
+
+	// `parent` must already exist (or be INVALID_NODE for a root), which keeps the arrays parent-before-child
+	Node add_node(Node parent, const glm::mat4& local, std::string name = {});
+	void reserve(size_t node_count);
+	void clear();
+
+	void set_local(Node node, const glm::mat4& local);
+	const glm::mat4& local(Node node) const { return m_local[node]; }
+	// as of the last update()
+	const glm::mat4& world(Node node) const { return m_world[node]; }
+	Node parent(Node node) const { return m_parents[node]; }
+	const std::string& name(Node node) const { return m_names[node]; }
+	// the first node with that name, or INVALID_NODE
+	Node find(std::string_view name) const;
+
+	size_t size() const { return m_parents.size(); }
+	bool is_dirty() const { return m_first_dirty < size(); }
+
+	// returns the number of world transforms that were recomputed
+	size_t update();
+
+   private:
+	std::vector<Node> m_parents;
+	std::vector<glm::mat4> m_local;
+	std::vector<glm::mat4> m_world;
+	std::vector<uint8_t> m_dirty;
+	std::vector<std::string> m_names;
+	size_t m_first_dirty = 0;
+};
@@ -1,17 +1,23 @@
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
+#include <string>
 #include <string_view>
 
 #include <glm/gtc/type_ptr.hpp>
 
+#include "bindless_textures.h"
 #include "shader_program.h"
 
 Shader_Program::Shader_Program(std::string_view vertex_source, std::string_view fragment_source) {
 	GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
 	const char* vertex_source_c = vertex_source.data();
 	const char* fragment_source_c = fragment_source.data();
+	// string views needn't be NUL-terminated
+	GLint vertex_source_length = static_cast<GLint>(vertex_source.size());
+	GLint fragment_source_length = static_cast<GLint>(fragment_source.size());
 
-	glShaderSource(vertex_shader, 1, &vertex_source_c, nullptr);
+	glShaderSource(vertex_shader, 1, &vertex_source_c, &vertex_source_length);
 	glCompileShader(vertex_shader);
 	GLint vertex_shader_compile_success;
 	glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &vertex_shader_compile_success);
@@ -23,7 +29,7 @@ Shader_Program::Shader_Program(std::string_view vertex_source, std::string_view
 	}
 
 	GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment_shader, 1, &fragment_source_c, nullptr);
+	glShaderSource(fragment_shader, 1, &fragment_source_c, &fragment_source_length);
 	glCompileShader(fragment_shader);
 	GLint fragment_shader_compile_success;
 	glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &fragment_shader_compile_success);
@@ -49,6 +55,39 @@ Shader_Program::Shader_Program(std::string_view vertex_source, std::string_view
 
 	glDeleteShader(vertex_shader);
 	glDeleteShader(fragment_shader);
+	reflect();
+}
+
+Shader_Program::Shader_Program(std::string_view compute_source) {
+	GLuint compute_shader = glCreateShader(GL_COMPUTE_SHADER);
+	const char* compute_source_c = compute_source.data();
+	GLint compute_source_length = static_cast<GLint>(compute_source.size());
+
+	glShaderSource(compute_shader, 1, &compute_source_c, &compute_source_length);
+	glCompileShader(compute_shader);
+	GLint compute_shader_compile_success;
+	glGetShaderiv(compute_shader, GL_COMPILE_STATUS, &compute_shader_compile_success);
+	if (!compute_shader_compile_success) {
+		GLchar info_log[512];
+		glGetShaderInfoLog(compute_shader, 512, nullptr, info_log);
+		std::cout << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED\n" << info_log << std::endl;
+		exit(-1);
+	}
+
+	id = glCreateProgram();
+	glAttachShader(id, compute_shader);
+	glLinkProgram(id);
+	GLint program_link_success;
+	glGetProgramiv(id, GL_LINK_STATUS, &program_link_success);
+	if (!program_link_success) {
+		GLchar info_log[512];
+		glGetProgramInfoLog(id, 512, nullptr, info_log);
+		std::cout << "ERROR::SHADER::PROGRAM::CREATION_FAILED\n" << info_log << std::endl;
+		exit(-1);
+	}
+
+	glDeleteShader(compute_shader);
+	reflect();
 }
 
 void Shader_Program::use() const {
@@ -56,45 +95,168 @@ void Shader_Program::use() const {
 }
 
 void Shader_Program::set_bool(std::string_view name, bool value) const {
-	GLint location = get_uniform_location(name);
-	glUniform1i(location, (GLint)value);
+	set_bool(uniform<bool>(name), value);
 }
 
 void Shader_Program::set_int(std::string_view name, GLint value) const {
-	GLint location = get_uniform_location(name);
-	glUniform1i(location, value);
+	set_int(uniform<GLint>(name), value);
 }
 
 void Shader_Program::set_float(std::string_view name, GLfloat value) const {
-	GLint location = get_uniform_location(name);
-	glUniform1f(location, value);
+	set_float(uniform<GLfloat>(name), value);
 }
 
 void Shader_Program::set_vec3(std::string_view name, const glm::vec3& value) const {
-	GLint location = get_uniform_location(name);
-	glUniform3f(location, value.x, value.y, value.z);
+	set_vec3(uniform<glm::vec3>(name), value);
 }
 
 void Shader_Program::set_mat4(std::string_view name, const glm::mat4& value) const {
-	GLint location = get_uniform_location(name);
-	glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+	set_mat4(uniform<glm::mat4>(name), value);
 }
 
 void Shader_Program::set_texture(std::string_view name, const Texture& value, GLenum slot) const {
-	value.bind(slot);
-	set_int(name, slot);
+	set_texture(uniform<GLint>(name), value, slot);
 }
+
 void Shader_Program::set_cubemap(std::string_view name, const Cubemap& value, GLenum slot) const {
+	set_cubemap(uniform<GLint>(name), value, slot);
+}
+
+void Shader_Program::set_bool(Uniform<bool> uniform, bool value) const {
+	glUniform1i(uniform.location, (GLint)value);
+}
+
+void Shader_Program::set_int(Uniform<GLint> uniform, GLint value) const {
+	glUniform1i(uniform.location, value);
+}
+
+void Shader_Program::set_float(Uniform<GLfloat> uniform, GLfloat value) const {
+	glUniform1f(uniform.location, value);
+}
+
+void Shader_Program::set_vec3(Uniform<glm::vec3> uniform, const glm::vec3& value) const {
+	glUniform3f(uniform.location, value.x, value.y, value.z);
+}
+
+void Shader_Program::set_mat4(Uniform<glm::mat4> uniform, const glm::mat4& value) const {
+	glUniformMatrix4fv(uniform.location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader_Program::set_texture(Uniform<GLint> uniform, const Texture& value, GLenum slot) const {
 	value.bind(slot);
-	set_int(name, slot);
+	set_int(uniform, slot);
+}
+
+void Shader_Program::set_cubemap(Uniform<GLint> uniform, const Cubemap& value, GLenum slot) const {
+	value.bind(slot);
+	set_int(uniform, slot);
+}
+
+void Shader_Program::set_texture_handle(std::string_view name, GLuint64 handle) const {
+	Bindless_Textures::set_uniform(get_uniform_location(name, GL_INT), handle);
+}
+
+GLint Shader_Program::find_uniform_location(std::string_view name) const {
+	const Active_Uniform* uniform = find_uniform(name);
+	return uniform ? uniform->location : -1;
+}
+
+void Shader_Program::reflect() {
+	GLint uniform_count = 0;
+	GLint max_name_length = 0;
+	glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &uniform_count);
+	glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+	std::string name_buffer(std::max(max_name_length, 1), '\0');
+
+	for (GLint i = 0; i < uniform_count; i++) {
+		GLsizei name_length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(id, i, static_cast<GLsizei>(name_buffer.size()), &name_length, &size, &type,
+						   name_buffer.data());
+		std::string name(name_buffer.data(), name_length);
+		GLint location = glGetUniformLocation(id, name.c_str());
+		// members of uniform blocks are set through their buffer
+		if (location == -1) {
+			continue;
+		}
+
+		// arrays are reported once, as "name[0]" with their size; the elements after the first needn't have
+		// consecutive locations
+		if (name.ends_with("[0]")) {
+			std::string base = name.substr(0, name.size() - 3);
+			m_uniforms.push_back({base, location, type});
+			for (GLint element = 1; element < size; element++) {
+				std::string element_name = base + "[" + std::to_string(element) + "]";
+				GLint element_location = glGetUniformLocation(id, element_name.c_str());
+				if (element_location != -1) {
+					m_uniforms.push_back({std::move(element_name), element_location, type});
+				}
+			}
+		}
+		m_uniforms.push_back({std::move(name), location, type});
+	}
+
+	std::sort(m_uniforms.begin(), m_uniforms.end(),
+			  [](const Active_Uniform& a, const Active_Uniform& b) { return a.name < b.name; });
+}
+
+const Shader_Program::Active_Uniform* Shader_Program::find_uniform(std::string_view name) const {
+	auto it = std::lower_bound(
+		m_uniforms.begin(), m_uniforms.end(), name,
+		[](const Active_Uniform& uniform, std::string_view name) { return uniform.name < name; });
+	return it != m_uniforms.end() && it->name == name ? &*it : nullptr;
 }
 
-GLint Shader_Program::get_uniform_location(std::string_view name) const {
-	GLint location = glGetUniformLocation(id, name.data());
-	if (location == -1) {
+static bool is_sampler(GLenum type) {
+	switch (type) {
+		case GL_SAMPLER_1D:
+		case GL_SAMPLER_2D:
+		case GL_SAMPLER_3D:
+		case GL_SAMPLER_CUBE:
+		case GL_SAMPLER_1D_SHADOW:
+		case GL_SAMPLER_2D_SHADOW:
+		case GL_SAMPLER_1D_ARRAY:
+		case GL_SAMPLER_2D_ARRAY:
+		case GL_SAMPLER_1D_ARRAY_SHADOW:
+		case GL_SAMPLER_2D_ARRAY_SHADOW:
+		case GL_SAMPLER_2D_MULTISAMPLE:
+		case GL_SAMPLER_2D_MULTISAMPLE_ARRAY:
+		case GL_SAMPLER_CUBE_SHADOW:
+		case GL_SAMPLER_CUBE_MAP_ARRAY:
+		case GL_SAMPLER_CUBE_MAP_ARRAY_SHADOW:
+		case GL_SAMPLER_BUFFER:
+		case GL_SAMPLER_2D_RECT:
+		case GL_SAMPLER_2D_RECT_SHADOW:
+		case GL_INT_SAMPLER_2D:
+		case GL_INT_SAMPLER_3D:
+		case GL_INT_SAMPLER_CUBE:
+		case GL_INT_SAMPLER_2D_ARRAY:
+		case GL_UNSIGNED_INT_SAMPLER_2D:
+		case GL_UNSIGNED_INT_SAMPLER_3D:
+		case GL_UNSIGNED_INT_SAMPLER_CUBE:
+		case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+			return true;
+		default:
+			return false;
+	}
+}
+
+GLint Shader_Program::get_uniform_location(std::string_view name, GLenum type) const {
+	const Active_Uniform* uniform = find_uniform(name);
+	if (!uniform) {
 		std::cerr << "ERROR::SHADER\n" << "uniform '" << name << "' does not exist";
 		exit(-1);
 	}
 
-	return location;
+	// glUniform1i sets ints, bools and samplers alike
+	bool integer = type == GL_INT || type == GL_BOOL;
+	bool matches = uniform->type == type ||
+				   (integer && (uniform->type == GL_INT || uniform->type == GL_BOOL || is_sampler(uniform->type)));
+	if (!matches) {
+		std::cerr << "ERROR::SHADER\n" << "uniform '" << name << "' can't be set with GL type 0x" << std::hex << type;
+		exit(-1);
+	}
+
+	return uniform->location;
 }
@@ -1,12 +1,24 @@
 #pragma once
 
+#include <string>
 #include <string_view>
+#include <type_traits>
+#include <vector>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
 #include "texture.h"
 
+// A uniform resolved once with Shader_Program::uniform(), so setting it takes no lookup. `T` is the type it is set
+// with; samplers are set with GLint.
+template <typename T>
+struct Uniform {
+	GLint location = -1;
+
+	explicit operator bool() const { return location != -1; }
+};
+
 class Shader_Program {
    public:
 	// the program ID
@@ -14,9 +26,17 @@ class Shader_Program {
 
 	// constructor reads and builds the shader
 	Shader_Program(std::string_view vertexSource, std::string_view fragmentSource);
+	// builds a compute program, needs GL 4.3
+	explicit Shader_Program(std::string_view computeSource);
 	// use/activate the shader
 	void use() const;
-	// utility uniform functions
+	// Looks `name` up in the table of active uniforms read back after linking. Exits like the setters below if the
+	// uniform doesn't exist or its GLSL type can't be set with a `T`.
+	template <typename T>
+	Uniform<T> uniform(std::string_view name) const {
+		return {get_uniform_location(name, gl_type<T>())};
+	}
+	// utility uniform functions, the ones taking a name look it up in the same table
 	void set_bool(std::string_view name, bool value) const;
 	void set_int(std::string_view name, GLint value) const;
 	void set_float(std::string_view name, GLfloat value) const;
@@ -24,7 +44,48 @@ class Shader_Program {
 	void set_mat4(std::string_view name, const glm::mat4& value) const;
 	void set_texture(std::string_view name, const Texture& value, GLenum slot) const;
 	void set_cubemap(std::string_view name, const Cubemap& value, GLenum slot) const;
+	void set_bool(Uniform<bool> uniform, bool value) const;
+	void set_int(Uniform<GLint> uniform, GLint value) const;
+	void set_float(Uniform<GLfloat> uniform, GLfloat value) const;
+	void set_vec3(Uniform<glm::vec3> uniform, const glm::vec3& value) const;
+	void set_mat4(Uniform<glm::mat4> uniform, const glm::mat4& value) const;
+	void set_texture(Uniform<GLint> uniform, const Texture& value, GLenum slot) const;
+	void set_cubemap(Uniform<GLint> uniform, const Cubemap& value, GLenum slot) const;
+	// for samplers declared layout(bindless_sampler), see Bindless_Textures; the handle stays set on the program, so
+	// unlike a texture unit it doesn't have to be set again before each draw
+	void set_texture_handle(std::string_view name, GLuint64 handle) const;
+	// returns -1 instead of exiting if the uniform doesn't exist (or was optimized out)
+	GLint find_uniform_location(std::string_view name) const;
 
    private:
-	GLint get_uniform_location(std::string_view name) const;
+	struct Active_Uniform {
+		std::string name;
+		GLint location;
+		GLenum type;
+	};
+
+	// sorted by name; every element of an array is in it as "name[i]", and the first as "name" as well
+	std::vector<Active_Uniform> m_uniforms;
+
+	// fills m_uniforms once the program is linked
+	void reflect();
+	const Active_Uniform* find_uniform(std::string_view name) const;
+	// `type` is what the caller sets the uniform with, GL_INT also covers bools and samplers
+	GLint get_uniform_location(std::string_view name, GLenum type) const;
+
+	template <typename T>
+	static constexpr GLenum gl_type() {
+		if constexpr (std::is_same_v<T, bool>) {
+			return GL_BOOL;
+		} else if constexpr (std::is_same_v<T, GLint>) {
+			return GL_INT;
+		} else if constexpr (std::is_same_v<T, GLfloat>) {
+			return GL_FLOAT;
+		} else if constexpr (std::is_same_v<T, glm::vec3>) {
+			return GL_FLOAT_VEC3;
+		} else {
+			static_assert(std::is_same_v<T, glm::mat4>, "no setter takes this type");
+			return GL_FLOAT_MAT4;
+		}
+	}
 };
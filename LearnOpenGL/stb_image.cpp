@@ -0,0 +1,3 @@
+// the one translation unit that compiles stb_image, shared by the application and the benchmarks
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
@@ -1,55 +1,354 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
 #include <iostream>
-#include <unordered_map>
+#include <optional>
 
+#include "bindless_textures.h"
+#include "block_compression.h"
+#include "config.h"
+#include "frame_stats.h"
+#include "mipmap.h"
 #include "texture.h"
+#include "texture_cache.h"
+#include "texture_container.h"
+#include "thread_pool.h"
 
-static std::unordered_map<std::filesystem::path, Texture> textures_loaded;
+// unsupported channel counts are reported by Image::decode
+static GLenum image_format(int num_chans) {
+	if (num_chans == 1) {
+		return GL_RED;
+	} else if (num_chans == 4) {
+		return GL_RGBA;
+	}
 
-Texture::Texture(std::filesystem::path image_path, std::string type, GLenum wrap_s, GLenum wrap_t) : type(type) {
-	if (textures_loaded.contains(image_path)) {
-		*this = textures_loaded[image_path];
-		return;
+	return GL_RGB;
+}
+
+// the size of a full mip chain with `texel_size` bytes per texel
+static size_t mip_chain_size(int width, int height, size_t texel_size) {
+	size_t size = 0;
+	while (true) {
+		size += static_cast<size_t>(width) * height * texel_size;
+		if (width == 1 && height == 1) {
+			return size;
+		}
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
 	}
+}
 
-	unsigned char* image_data = stbi_load(image_path.string().c_str(), &width, &height, &num_chans, 0);
-	if (!image_data) {
+static GLenum sized_format(int num_chans) {
+	if (num_chans == 1) {
+		return GL_R8;
+	} else if (num_chans == 4) {
+		return GL_RGBA8;
+	}
+	return GL_RGB8;
+}
+
+// Times an upload on the context thread, from staging to the glTex(Sub)Image call, for Frame_Stats. Its pointer is
+// where the call reads from: the staged range in the bound Pixel_Buffer_Ring, or the caller's memory if the ring
+// couldn't take it.
+class Staged_Upload {
+   public:
+	Staged_Upload(Pixel_Buffer_Ring::Staging&& staged, const void* data, size_t size)
+		: m_start(std::chrono::steady_clock::now()), m_staged(std::move(staged)), m_size(size) {
+		Pixel_Buffer_Ring& ring = Pixel_Buffer_Ring::shared();
+		if (!m_staged) {
+			m_staged = ring.stage({static_cast<const std::byte*>(data), size});
+		}
+		if (m_staged) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring.buffer());
+			m_pointer = m_staged.offset();
+		} else {
+			m_pointer = data;
+		}
+	}
+	Staged_Upload(const Staged_Upload&) = delete;
+	Staged_Upload& operator=(const Staged_Upload&) = delete;
+
+	~Staged_Upload() {
+		if (m_staged) {
+			Pixel_Buffer_Ring::shared().submit(std::move(m_staged));
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+
+		Frame_Stats& stats = frame_stats::current();
+		stats.upload_bytes += m_size;
+		stats.upload_stall_ns += static_cast<uint64_t>(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count());
+	}
+
+	const void* pointer() const { return m_pointer; }
+
+   private:
+	std::chrono::steady_clock::time_point m_start;
+	Pixel_Buffer_Ring::Staging m_staged;
+	size_t m_size;
+	const void* m_pointer = nullptr;
+};
+
+// the rows [first_row, first_row + row_count) of one level of uncompressed pixels
+static void upload_pixel_rows(GLuint texture,
+							  GLint level,
+							  const unsigned char* pixels,
+							  int width,
+							  int num_chans,
+							  int first_row,
+							  int row_count,
+							  Pixel_Buffer_Ring::Staging&& staged) {
+	size_t row_size = static_cast<size_t>(width) * num_chans;
+	const unsigned char* rows = pixels + first_row * row_size;
+	size_t size = row_count * row_size;
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	// rows of 1 and 3 channel images aren't necessarily 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	GLenum format = image_format(num_chans);
+	{
+		Staged_Upload upload(std::move(staged), rows, size);
+		glTexSubImage2D(GL_TEXTURE_2D, level, 0, first_row, width, row_count, format, GL_UNSIGNED_BYTE,
+						upload.pointer());
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+Image Image::decode(const std::filesystem::path& image_path) {
+	Image image;
+	image.pixels.reset(stbi_load(image_path.string().c_str(), &image.width, &image.height, &image.num_chans, 0));
+	if (!image.pixels) {
 		std::cerr << "ERROR::TEXTURE\n" << "failed to load image '" << image_path << "'" << std::endl;
+	} else if (image.num_chans != 1 && image.num_chans != 3 && image.num_chans != 4) {
+		std::cerr << "WARNING: unsupported number of channels (" << image.num_chans << ") for image '" << image_path
+				  << "', falling back to RGB" << std::endl;
+	}
+
+	return image;
+}
+
+std::vector<Image> Image::decode_all(std::span<const std::filesystem::path> image_paths) {
+	std::vector<Image> images(image_paths.size());
+	Thread_Pool::shared().parallel_for(image_paths.size(), [&](size_t i) { images[i] = decode(image_paths[i]); });
+
+	return images;
+}
+
+Texture::Texture(const std::filesystem::path& image_path, GLenum wrap_s, GLenum wrap_t) {
+	if (texture_container::is_container(image_path)) {
+		std::optional<texture_container::Container> container = texture_container::Container::open(image_path);
+		if (!container) {
+			return;
+		}
+		if (container->target != GL_TEXTURE_2D) {
+			std::cerr << "ERROR::TEXTURE\n" << "'" << image_path << "' is not a 2D texture" << std::endl;
+			return;
+		}
+
+		*this = Texture(*container, wrap_s, wrap_t);
 		return;
 	}
 
-	glGenTextures(1, &id);
+	Image image = Image::decode(image_path);
+	if (!image) {
+		return;
+	}
+
+	*this = Texture(image, mipmap::generate(image, {}), wrap_s, wrap_t);
+}
+
+Texture::Texture(const Image& image, std::span<const mipmap::Level> mips, GLenum wrap_s, GLenum wrap_t) {
+	*this = allocate(image, mips, wrap_s, wrap_t);
+	upload_rows(image, 0, image.height);
+	for (size_t i = 0; i < mips.size(); i++) {
+		upload_rows(mips[i], static_cast<GLint>(i + 1), 0, mips[i].height);
+	}
+	finish_upload();
+}
+
+Texture::Texture(const block_compression::Compressed_Image& image, GLenum wrap_s, GLenum wrap_t, size_t first_level) {
+	*this = allocate(image, wrap_s, wrap_t, first_level);
+	for (size_t level = first_level; level < image.levels.size(); level++) {
+		upload_blocks(image, level, 0, block_compression::block_count(image.levels[level].height));
+	}
+	finish_upload();
+}
+
+Texture::Texture(const texture_container::Container& container, GLenum wrap_s, GLenum wrap_t, size_t first_level) {
+	*this = allocate(container, wrap_s, wrap_t, first_level);
+	for (size_t level = first_level; level < container.levels.size(); level++) {
+		allocate_level(container, level);
+		upload_rows(container, level, 0, texture_container::row_count(container, level));
+	}
+	finish_upload();
+}
+
+void Texture::bind(GLenum slot) const {
+	glActiveTexture(GL_TEXTURE0 + slot);
 	glBindTexture(GL_TEXTURE_2D, id);
+	glActiveTexture(GL_TEXTURE0);
+	frame_stats::current().texture_binds++;
+}
+
+GLuint64 Texture::resident_handle() const {
+	return Bindless_Textures::shared().handle(id);
+}
+
+Texture Texture::allocate(const Image& image, std::span<const mipmap::Level> mips, GLenum wrap_s, GLenum wrap_t) {
+	Texture texture;
+	texture.width = image.width;
+	texture.height = image.height;
+	texture.num_chans = image.num_chans;
+	// drivers pad RGB8 to 4 bytes per texel almost everywhere
+	texture.memory_size = mip_chain_size(image.width, image.height, image.num_chans == 1 ? 1 : 4);
+
+	glGenTextures(1, &texture.id);
+	glBindTexture(GL_TEXTURE_2D, texture.id);
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap_s);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap_t);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-	GLenum format;
-	if (num_chans == 1) {
-		format = GL_RED;
-	} else if (num_chans == 3) {
-		format = GL_RGB;
-	} else if (num_chans == 4) {
-		format = GL_RGBA;
-	} else {
-		std::cerr << "WARNING: unsupported number of channels (" << num_chans << ") for image '" << image_path
-				  << "', falling back to RGB" << std::endl;
-		format = GL_RGB;
+	if (!mips.empty()) {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(mips.size()));
+		texture.prebuilt_mips = true;
 	}
 
-	glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, image_data);
-	glGenerateMipmap(GL_TEXTURE_2D);
+	// immutable storage spares the driver from checking the levels for completeness on every draw
+	if (GLAD_GL_VERSION_4_2) {
+		unsigned largest = static_cast<unsigned>(std::max(image.width, image.height));
+		GLsizei levels = static_cast<GLsizei>(mips.empty() ? std::bit_width(largest) : mips.size() + 1);
+		glTexStorage2D(GL_TEXTURE_2D, levels, sized_format(image.num_chans), image.width, image.height);
+		return texture;
+	}
 
-	textures_loaded[image_path] = *this;
+	GLenum format = image_format(image.num_chans);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, nullptr);
+	for (size_t i = 0; i < mips.size(); i++) {
+		glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i + 1), format, mips[i].width, mips[i].height, 0, format,
+					 GL_UNSIGNED_BYTE, nullptr);
+	}
 
-	stbi_image_free(image_data);
+	return texture;
 }
 
-void Texture::bind(GLenum slot) const {
-	glActiveTexture(GL_TEXTURE0 + slot);
+void Texture::upload_rows(const Image& image, int first_row, int row_count, Pixel_Buffer_Ring::Staging staged) const {
+	upload_pixel_rows(id, 0, image.pixels.get(), image.width, image.num_chans, first_row, row_count,
+					  std::move(staged));
+}
+
+void Texture::upload_rows(const mipmap::Level& mip,
+						  GLint level,
+						  int first_row,
+						  int row_count,
+						  Pixel_Buffer_Ring::Staging staged) const {
+	upload_pixel_rows(id, level, mip.pixels.data(), mip.width, mip.num_chans, first_row, row_count, std::move(staged));
+}
+
+Texture Texture::allocate(const block_compression::Compressed_Image& image,
+						  GLenum wrap_s,
+						  GLenum wrap_t,
+						  size_t first_level) {
+	Texture texture;
+	texture.width = static_cast<int>(image.levels[0].width);
+	texture.height = static_cast<int>(image.levels[0].height);
+	texture.num_chans = image.num_chans;
+	texture.prebuilt_mips = true;
+	texture.memory_size = image.size(first_level);
+
+	glGenTextures(1, &texture.id);
+	glBindTexture(GL_TEXTURE_2D, texture.id);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap_s);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap_t);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(first_level));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(image.levels.size() - 1));
+
+	GLenum format = block_compression::gl_format(image.format);
+	for (size_t level = first_level; level < image.levels.size(); level++) {
+		const block_compression::Mip_Level& mip = image.levels[level];
+		glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), format, static_cast<GLsizei>(mip.width),
+							   static_cast<GLsizei>(mip.height), 0, static_cast<GLsizei>(mip.size), nullptr);
+	}
+
+	return texture;
+}
+
+void Texture::upload_blocks(const block_compression::Compressed_Image& image,
+							size_t level,
+							uint32_t first_block_row,
+							uint32_t block_row_count,
+							Pixel_Buffer_Ring::Staging staged) const {
+	const block_compression::Mip_Level& mip = image.levels[level];
+	size_t row_size = block_compression::block_count(mip.width) * block_compression::block_size(image.format);
+	size_t size = block_row_count * row_size;
+	// the last row of blocks may reach past the edge of the level, which the sub-image can't
+	uint32_t first_row = first_block_row * 4;
+	uint32_t row_count = std::min(block_row_count * 4, mip.height - first_row);
+
 	glBindTexture(GL_TEXTURE_2D, id);
-	glActiveTexture(GL_TEXTURE0);
+	Staged_Upload upload(std::move(staged), image.level_data(level).data() + first_block_row * row_size, size);
+	glCompressedTexSubImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), 0, static_cast<GLint>(first_row),
+							  static_cast<GLsizei>(mip.width), static_cast<GLsizei>(row_count),
+							  block_compression::gl_format(image.format), static_cast<GLsizei>(size), upload.pointer());
+}
+
+Texture Texture::allocate(const texture_container::Container& container,
+						  GLenum wrap_s,
+						  GLenum wrap_t,
+						  size_t first_level) {
+	Texture texture;
+	texture.width = static_cast<int>(container.levels[0].width);
+	texture.height = static_cast<int>(container.levels[0].height);
+	texture.num_chans = container.num_chans;
+	texture.prebuilt_mips = !container.generate_mips;
+	for (size_t level = first_level; level < container.levels.size(); level++) {
+		for (std::span<const std::byte> image : container.levels[level].images) {
+			texture.memory_size += image.size();
+		}
+	}
+	// the generated levels add about a third
+	if (container.generate_mips) {
+		texture.memory_size += texture.memory_size / 3;
+	}
+
+	texture.id = texture_container::create(container);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap_s);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap_t);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(first_level));
+
+	return texture;
+}
+
+void Texture::allocate_level(const texture_container::Container& container, size_t level) const {
+	glBindTexture(GL_TEXTURE_2D, id);
+	texture_container::allocate_level(container, level);
+}
+
+void Texture::upload_rows(const texture_container::Container& container,
+						  size_t level,
+						  uint32_t first_row,
+						  uint32_t row_count,
+						  Pixel_Buffer_Ring::Staging staged) const {
+	size_t row_size = texture_container::row_size(container, level);
+	size_t size = row_count * row_size;
+
+	glBindTexture(GL_TEXTURE_2D, id);
+	Staged_Upload upload(std::move(staged), container.levels[level].images[0].data() + first_row * row_size, size);
+	texture_container::upload_rows(container, level, 0, first_row, row_count, upload.pointer());
+}
+
+void Texture::finish_upload() const {
+	glBindTexture(GL_TEXTURE_2D, id);
+	if (!prebuilt_mips) {
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
 }
 
 Cubemap::Cubemap(const std::vector<std::filesystem::path>& image_paths) {
@@ -57,51 +356,115 @@ Cubemap::Cubemap(const std::vector<std::filesystem::path>& image_paths) {
 		std::cerr << "ERROR::CUBEMAP\n"
 				  << "path array must have exactly 6 elements, but had '" << image_paths.size() << "' elements"
 				  << std::endl;
+		return;
 	}
 
-	glGenTextures(1, &id);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+	using Clock = std::chrono::steady_clock;
+	auto elapsed_ms = [](Clock::time_point since) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+	};
 
-	for (size_t i = 0; i < image_paths.size(); i++) {
-		const auto& image_path = image_paths[i];
+	auto start = Clock::now();
+	if (std::optional<texture_container::Container> cached = texture_cache::read_cubemap(image_paths)) {
+		*this = Cubemap(*cached);
+		if constexpr (constants::DEBUG) {
+			std::cout << "TEXTURE::CUBEMAP from cache in " << elapsed_ms(start) << " ms" << std::endl;
+		}
+		return;
+	}
 
-		int width, height, num_chans;
-		unsigned char* image_data = stbi_load(image_path.string().c_str(), &width, &height, &num_chans, 0);
-		if (!image_data) {
-			std::cerr << "ERROR::CUBEMAP\n" << "failed to load image '" << image_path << "'" << std::endl;
+	// the faces decode independently; only the uploads need the context thread
+	auto decode_start = Clock::now();
+	std::vector<Image> images = Image::decode_all(image_paths);
+	double decode_ms = elapsed_ms(decode_start);
+	for (size_t i = 0; i < images.size(); i++) {
+		if (!images[i]) {
+			std::cerr << "ERROR::CUBEMAP\n" << "failed to load image '" << image_paths[i] << "'" << std::endl;
 			return;
 		}
+	}
 
-		GLenum format;
-		if (num_chans == 1) {
-			format = GL_RED;
-		} else if (num_chans == 3) {
-			format = GL_RGB;
-		} else if (num_chans == 4) {
-			format = GL_RGBA;
-		} else {
-			std::cerr << "WARNING: unsupported number of channels (" << num_chans << ") for image '" << image_path
-					  << "', falling back to RGB" << std::endl;
-			format = GL_RGB;
+	// bake the faces into one compressed file, so later runs skip the decode as well
+	if (block_compression::query_support().s3tc) {
+		auto compress_start = Clock::now();
+		std::vector<block_compression::Compressed_Image> faces;
+		for (const Image& image : images) {
+			faces.push_back(block_compression::compress(image, block_compression::Block_Format::bc1,
+														{mipmap::Filter::kaiser, mipmap::Color_Space::srgb}));
 		}
+		double compress_ms = elapsed_ms(compress_start);
 
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + static_cast<GLenum>(i), 0, format, width, height, 0, format,
-					 GL_UNSIGNED_BYTE,
-					 image_data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+		if (std::optional<texture_container::Container> written = texture_cache::write_cubemap(image_paths, faces)) {
+			auto upload_start = Clock::now();
+			*this = Cubemap(*written);
+			if constexpr (constants::DEBUG) {
+				std::cout << "TEXTURE::CUBEMAP decode " << decode_ms << " ms, compress " << compress_ms
+						  << " ms, upload " << elapsed_ms(upload_start) << " ms" << std::endl;
+			}
+			return;
+		}
+	}
 
-		stbi_image_free(image_data);
+	auto upload_start = Clock::now();
+	glGenTextures(1, &id);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+
+	for (size_t i = 0; i < images.size(); i++) {
+		const Image& image = images[i];
+		GLenum format = image_format(image.num_chans);
+
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + static_cast<GLenum>(i), 0, format, image.width, image.height, 0,
+					 format, GL_UNSIGNED_BYTE, image.pixels.get());
 	}
+	// once every face is there, a cube map with missing faces is incomplete
+	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
 
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+	if constexpr (constants::DEBUG) {
+		std::cout << "TEXTURE::CUBEMAP decode " << decode_ms << " ms, upload " << elapsed_ms(upload_start) << " ms"
+				  << std::endl;
+	}
+}
+
+Cubemap::Cubemap(const std::filesystem::path& container_path) {
+	std::optional<texture_container::Container> container = texture_container::Container::open(container_path);
+	if (!container) {
+		return;
+	}
+	if (container->target != GL_TEXTURE_CUBE_MAP) {
+		std::cerr << "ERROR::CUBEMAP\n" << "'" << container_path << "' is not a cube map" << std::endl;
+		return;
+	}
+
+	*this = Cubemap(*container);
+}
+
+Cubemap::Cubemap(const texture_container::Container& container) {
+	id = texture_container::create(container);
+	for (size_t level = 0; level < container.levels.size(); level++) {
+		texture_container::upload_level(container, level);
+	}
+	if (container.generate_mips) {
+		glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+	}
+
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 }
 
 void Cubemap::bind(GLenum slot) const {
 	glActiveTexture(GL_TEXTURE0 + slot);
 	glBindTexture(GL_TEXTURE_CUBE_MAP, id);
 	glActiveTexture(GL_TEXTURE0);
+	frame_stats::current().texture_binds++;
+}
+
+GLuint64 Cubemap::resident_handle() const {
+	return Bindless_Textures::shared().handle(id);
 }
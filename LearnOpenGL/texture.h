@@ -1,33 +1,132 @@
 #pragma once
 
+#include <cstddef>
 #include <filesystem>
-#include <string>
+#include <memory>
+#include <span>
 #include <vector>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <stb_image.h>
 
+#include "pixel_buffer_ring.h"
+
+namespace block_compression {
+struct Compressed_Image;
+}
+namespace mipmap {
+struct Level;
+}
+namespace texture_container {
+class Container;
+}
+
+// decoded 8-bit pixels, safe to produce on any thread
+struct Image {
+	int width = 0;
+	int height = 0;
+	int num_chans = 0;
+	std::unique_ptr<unsigned char, decltype(&stbi_image_free)> pixels{nullptr, &stbi_image_free};
+
+	// returns an empty image (and reports the error) if the file can't be decoded
+	static Image decode(const std::filesystem::path& image_path);
+	// decodes every path on the shared thread pool, the results are in the same order as `image_paths`
+	static std::vector<Image> decode_all(std::span<const std::filesystem::path> image_paths);
+
+	explicit operator bool() const { return pixels != nullptr; }
+	size_t row_size() const { return static_cast<size_t>(width) * num_chans; }
+	size_t size() const { return row_size() * height; }
+};
+
+// A 2D texture on the GPU. A plain value: copies share the GL object, and nothing deletes it on its own; textures
+// loaded for models are owned by the Texture_Registry.
 struct Texture {
 	int width = 0;
 	int height = 0;
 	int num_chans = 0;
 
 	GLuint id = 0;
-	std::string type;
+	// the mip chain came with the image (block-compressed or from a container) instead of being generated
+	bool prebuilt_mips = false;
+	// VRAM taken up by the levels that are resident
+	size_t memory_size = 0;
 
 	Texture() = default;
-	Texture(std::filesystem::path image_path,
-					 std::string type,
+	// decodes an image and builds its mips with mipmap::generate(), or maps a DDS or KTX2 file, and uploads it
+	explicit Texture(const std::filesystem::path& image_path, GLenum wrap_s = GL_REPEAT, GLenum wrap_t = GL_REPEAT);
+	// Uploads an image that was decoded ahead of time, e.g. on a loader thread, with the rest of its mip chain
+	// (level 1 first). Without `mips` the driver generates them.
+	explicit Texture(const Image& image,
+					 std::span<const mipmap::Level> mips = {},
 					 GLenum wrap_s = GL_REPEAT,
 					 GLenum wrap_t = GL_REPEAT);
+	// Both upload the levels from `first_level` down and clamp GL_TEXTURE_BASE_LEVEL to it, leaving the finer ones to
+	// the Texture_Streamer.
+	explicit Texture(const block_compression::Compressed_Image& image,
+					 GLenum wrap_s = GL_REPEAT,
+					 GLenum wrap_t = GL_REPEAT,
+					 size_t first_level = 0);
+	// a 2D texture from a DDS or KTX2 file, see texture_container.h
+	explicit Texture(const texture_container::Container& container,
+					 GLenum wrap_s = GL_REPEAT,
+					 GLenum wrap_t = GL_REPEAT,
+					 size_t first_level = 0);
 	void bind(GLenum slot) const;
+	// see Bindless_Textures::handle(), streamed textures must not get one
+	GLuint64 resident_handle() const;
+
+	// Incremental upload for streaming: allocate() creates the storage for `image` and `mips`, immutable where
+	// glTexStorage2D is available, upload_rows() fills a level a slice at a time and finish_upload() has the driver
+	// build the mips if none were given. The rows go through the Pixel_Buffer_Ring: from `staged` if a loader thread
+	// already copied them in, else staged on the spot.
+	static Texture allocate(const Image& image,
+							std::span<const mipmap::Level> mips = {},
+							GLenum wrap_s = GL_REPEAT,
+							GLenum wrap_t = GL_REPEAT);
+	void upload_rows(const Image& image, int first_row, int row_count, Pixel_Buffer_Ring::Staging staged = {}) const;
+	// `level` is the mip level, 1 for the first of the `mips` passed to allocate()
+	void upload_rows(const mipmap::Level& mip,
+					 GLint level,
+					 int first_row,
+					 int row_count,
+					 Pixel_Buffer_Ring::Staging staged = {}) const;
+	// the same for block-compressed textures, a level at a time in rows of 4x4 blocks; only the levels from
+	// `first_level` down get storage
+	static Texture allocate(const block_compression::Compressed_Image& image,
+							GLenum wrap_s = GL_REPEAT,
+							GLenum wrap_t = GL_REPEAT,
+							size_t first_level = 0);
+	void upload_blocks(const block_compression::Compressed_Image& image,
+					   size_t level,
+					   uint32_t first_block_row,
+					   uint32_t block_row_count,
+					   Pixel_Buffer_Ring::Staging staged = {}) const;
+	// and for containers, in rows (of 4x4 blocks when compressed) as they are in the file's mapping. allocate() only
+	// creates the texture here, each level's storage is specified by allocate_level() before its rows are uploaded.
+	static Texture allocate(const texture_container::Container& container,
+							GLenum wrap_s = GL_REPEAT,
+							GLenum wrap_t = GL_REPEAT,
+							size_t first_level = 0);
+	void allocate_level(const texture_container::Container& container, size_t level) const;
+	void upload_rows(const texture_container::Container& container,
+					 size_t level,
+					 uint32_t first_row,
+					 uint32_t row_count,
+					 Pixel_Buffer_Ring::Staging staged = {}) const;
+	void finish_upload() const;
 };
 
 struct Cubemap {
 	GLuint id = 0;
 
 	Cubemap() = default;
+	// the six faces are baked into one block-compressed KTX2 file under CACHE_PATH on first use
 	Cubemap(const std::vector<std::filesystem::path>& image_paths);
+	// a cube map DDS or KTX2 file
+	explicit Cubemap(const std::filesystem::path& container_path);
+	explicit Cubemap(const texture_container::Container& container);
 	void bind(GLenum slot) const;
+	// see Bindless_Textures::handle()
+	GLuint64 resident_handle() const;
 };
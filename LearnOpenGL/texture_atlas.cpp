@@ -0,0 +1,366 @@
+#include <algorithm>
+#include <bit>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <unordered_set>
+
+#include "block_compression.h"
+#include "config.h"
+#include "texture_atlas.h"
+
+namespace {
+
+// what packing needs to know about a texture, read back from GL
+struct Candidate {
+	Texture_Atlas::Handle handle;
+	GLuint texture;
+	GLenum internal_format;
+	int width;
+	int height;
+	bool compressed;
+	// bytes per 4x4 block for compressed formats, per texel otherwise
+	size_t unit_size;
+	// the top left of the texture's cell, gutter included, and the layer it is in
+	int x = 0;
+	int y = 0;
+	uint32_t layer = 0;
+	// 0 for textures that fill a layer
+	int gutter = 0;
+};
+
+// one array as it is being laid out
+struct Layout {
+	GLenum internal_format;
+	int width;
+	int height;
+	int level_count;
+	uint32_t layer_count = 0;
+	std::vector<Candidate> members;
+};
+
+// textures that can be copied into an array level by level: fully resident (not waiting on the Texture_Streamer),
+// power of two sized and small enough to be worth it
+std::optional<Candidate> inspect(Texture_Atlas::Handle handle, GLuint texture) {
+	glBindTexture(GL_TEXTURE_2D, texture);
+	GLint base_level = 0;
+	GLint width = 0;
+	GLint height = 0;
+	GLint compressed = GL_FALSE;
+	glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, &base_level);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+	bool power_of_two = width > 0 && height > 0 && std::has_single_bit(static_cast<unsigned>(width)) &&
+						std::has_single_bit(static_cast<unsigned>(height));
+	if (base_level != 0 || !power_of_two || std::max(width, height) > Texture_Atlas::MAX_PACKED_SIZE ||
+		(compressed && std::min(width, height) < 4)) {
+		return std::nullopt;
+	}
+
+	// the whole chain has to be there, down to 1x1
+	GLint last_level = std::bit_width(static_cast<unsigned>(std::max(width, height))) - 1;
+	GLint last_width = 0;
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, last_level, GL_TEXTURE_WIDTH, &last_width);
+	if (last_width != std::max(1, width >> last_level)) {
+		return std::nullopt;
+	}
+
+	GLint internal_format = 0;
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internal_format);
+	Candidate candidate{handle, texture, static_cast<GLenum>(internal_format), width, height,
+						compressed == GL_TRUE, 0};
+	if (candidate.compressed) {
+		GLint size = 0;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+		size_t block_count = size_t{block_compression::block_count(static_cast<uint32_t>(width))} *
+							 block_compression::block_count(static_cast<uint32_t>(height));
+		candidate.unit_size = static_cast<size_t>(size) / block_count;
+	} else {
+		GLint bits = 0;
+		for (GLenum channel :
+			 {GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE}) {
+			GLint channel_bits = 0;
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, channel, &channel_bits);
+			bits += channel_bits;
+		}
+		candidate.unit_size = static_cast<size_t>(bits) / 8;
+	}
+
+	return candidate;
+}
+
+// the levels of a texture all the same size as its group each fill a layer
+std::vector<Layout> layout_layers(GLenum internal_format, std::vector<Candidate>& members, uint32_t max_layers) {
+	std::vector<Layout> layouts;
+	int level_count = std::bit_width(static_cast<unsigned>(std::max(members[0].width, members[0].height)));
+	for (Candidate& member : members) {
+		if (layouts.empty() || layouts.back().layer_count == max_layers) {
+			layouts.push_back({internal_format, member.width, member.height, level_count, 0, {}});
+		}
+		member.layer = layouts.back().layer_count++;
+		layouts.back().members.push_back(member);
+	}
+
+	return layouts;
+}
+
+// shelf packs cells, gutters included, tallest first; textures as large as a page get one to themselves
+std::vector<Layout> layout_atlas(GLenum internal_format, std::vector<Candidate>& members, uint32_t max_layers) {
+	int block = members[0].compressed ? 4 : 1;
+	int gutter = Texture_Atlas::GUTTER_BLOCKS * block;
+	// too small to keep a gutter-wide level at the coarsest atlas level
+	std::erase_if(members, [&](const Candidate& member) { return std::min(member.width, member.height) < gutter; });
+	if (members.empty()) {
+		return {};
+	}
+
+	auto fills_page = [](const Candidate& member, int page) { return member.width == page && member.height == page; };
+	int page = 0;
+	for (const Candidate& member : members) {
+		page = std::max({page, member.width, member.height});
+	}
+	while (std::any_of(members.begin(), members.end(), [&](const Candidate& member) {
+		return !fills_page(member, page) && std::max(member.width, member.height) + 2 * gutter > page;
+	})) {
+		page *= 2;
+	}
+
+	std::sort(members.begin(), members.end(), [](const Candidate& a, const Candidate& b) {
+		return a.height != b.height ? a.height > b.height : a.width > b.width;
+	});
+
+	// the gutter only protects the levels in which it is still a block wide
+	int level_count = std::bit_width(static_cast<unsigned>(Texture_Atlas::GUTTER_BLOCKS));
+	std::vector<Layout> layouts;
+	int x = 0;
+	int y = 0;
+	int shelf_height = 0;
+	auto next_page = [&]() {
+		if (layouts.empty() || layouts.back().layer_count == max_layers) {
+			layouts.push_back({internal_format, page, page, level_count, 0, {}});
+		}
+		layouts.back().layer_count++;
+		x = 0;
+		y = 0;
+		shelf_height = 0;
+	};
+
+	for (Candidate& member : members) {
+		if (fills_page(member, page)) {
+			next_page();
+			member.layer = layouts.back().layer_count - 1;
+			layouts.back().members.push_back(member);
+			// the page is full, whatever comes next starts another one
+			y = page;
+			continue;
+		}
+
+		int cell_width = member.width + 2 * gutter;
+		int cell_height = member.height + 2 * gutter;
+		if (!layouts.empty() && x + cell_width > page) {
+			x = 0;
+			y += shelf_height;
+			shelf_height = 0;
+		}
+		if (layouts.empty() || y + cell_height > page) {
+			next_page();
+		}
+
+		member.layer = layouts.back().layer_count - 1;
+		member.x = x;
+		member.y = y;
+		member.gutter = gutter;
+		layouts.back().members.push_back(member);
+		x += cell_width;
+		shelf_height = std::max(shelf_height, cell_height);
+	}
+
+	return layouts;
+}
+
+void copy_region(const Candidate& member,
+				 GLint level,
+				 GLint src_x,
+				 GLint src_y,
+				 GLuint array,
+				 GLint dst_x,
+				 GLint dst_y,
+				 GLsizei width,
+				 GLsizei height) {
+	glCopyImageSubData(member.texture, GL_TEXTURE_2D, level, src_x, src_y, 0, array, GL_TEXTURE_2D_ARRAY, level, dst_x,
+					   dst_y, static_cast<GLint>(member.layer), width, height, 1);
+}
+
+// a member's level, and around it in the gutter its opposite edges, as GL_REPEAT would wrap to them
+void copy_level(const Candidate& member, GLuint array, GLint level) {
+	GLsizei width = std::max(1, member.width >> level);
+	GLsizei height = std::max(1, member.height >> level);
+	GLint g = member.gutter >> level;
+	GLint x = (member.x >> level) + g;
+	GLint y = (member.y >> level) + g;
+	copy_region(member, level, 0, 0, array, x, y, width, height);
+	if (g == 0) {
+		return;
+	}
+
+	copy_region(member, level, width - g, 0, array, x - g, y, g, height);
+	copy_region(member, level, 0, 0, array, x + width, y, g, height);
+	copy_region(member, level, 0, height - g, array, x, y - g, width, g);
+	copy_region(member, level, 0, 0, array, x, y + height, width, g);
+	copy_region(member, level, width - g, height - g, array, x - g, y - g, g, g);
+	copy_region(member, level, 0, height - g, array, x + width, y - g, g, g);
+	copy_region(member, level, width - g, 0, array, x - g, y + height, g, g);
+	copy_region(member, level, 0, 0, array, x + width, y + height, g, g);
+}
+
+// Texture uploads plain images with unsized formats, which glTexStorage3D doesn't take, and glCopyImageSubData only
+// copies between those when both sides have the very same one. Such arrays are specified level by level instead.
+void allocate(const Layout& layout) {
+	GLenum internal_format = layout.internal_format;
+	bool unsized = internal_format == GL_RED || internal_format == GL_RG || internal_format == GL_RGB ||
+				   internal_format == GL_RGBA;
+	if (!unsized) {
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, layout.level_count, internal_format, layout.width, layout.height,
+					   static_cast<GLsizei>(layout.layer_count));
+		return;
+	}
+
+	for (int level = 0; level < layout.level_count; level++) {
+		GLsizei width = std::max(1, layout.width >> level);
+		GLsizei height = std::max(1, layout.height >> level);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, level, static_cast<GLint>(internal_format), width, height,
+					 static_cast<GLsizei>(layout.layer_count), 0, internal_format, GL_UNSIGNED_BYTE, nullptr);
+	}
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, layout.level_count - 1);
+}
+
+size_t level_size(const Layout& layout, int level) {
+	size_t width = static_cast<size_t>(std::max(1, layout.width >> level));
+	size_t height = static_cast<size_t>(std::max(1, layout.height >> level));
+	const Candidate& member = layout.members[0];
+	if (member.compressed) {
+		width = block_compression::block_count(static_cast<uint32_t>(width));
+		height = block_compression::block_count(static_cast<uint32_t>(height));
+	}
+
+	return width * height * member.unit_size * layout.layer_count;
+}
+
+}  // namespace
+
+Texture_Atlas::~Texture_Atlas() {
+	release();
+}
+
+bool Texture_Atlas::supported() {
+	return GLAD_GL_VERSION_4_3;
+}
+
+void Texture_Atlas::build(std::span<const Handle> handles) {
+	release();
+	m_generation++;
+	if (!supported()) {
+		std::cerr << "ERROR::TEXTURE_ATLAS\n" << "copying into texture arrays needs OpenGL 4.3" << std::endl;
+		return;
+	}
+
+	Texture_Registry& registry = Texture_Registry::shared();
+	std::map<GLenum, std::vector<Candidate>> groups;
+	std::unordered_set<Handle> seen;
+	for (Handle handle : handles) {
+		if (!seen.insert(handle).second) {
+			continue;
+		}
+		GLuint texture = registry.get(handle).id;
+		if (texture == 0) {
+			continue;
+		}
+
+		if (std::optional<Candidate> candidate = inspect(handle, texture)) {
+			groups[candidate->internal_format].push_back(*candidate);
+		}
+	}
+
+	GLint max_layers = 0;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+
+	for (auto& [internal_format, members] : groups) {
+		bool same_size = std::all_of(members.begin(), members.end(), [&](const Candidate& member) {
+			return member.width == members[0].width && member.height == members[0].height;
+		});
+		std::vector<Layout> layouts = same_size
+										  ? layout_layers(internal_format, members, static_cast<uint32_t>(max_layers))
+										  : layout_atlas(internal_format, members, static_cast<uint32_t>(max_layers));
+
+		for (const Layout& layout : layouts) {
+			GLuint array = 0;
+			glGenTextures(1, &array);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+			allocate(layout);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			// whole layers wrap in the sampler, atlas cells with fract() in the shader
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+			uint32_t index = static_cast<uint32_t>(m_arrays.size());
+			m_arrays.push_back(array);
+			m_layer_count += layout.layer_count;
+			for (int level = 0; level < layout.level_count; level++) {
+				m_memory_size += level_size(layout, level);
+			}
+
+			glm::vec2 page_size(static_cast<float>(layout.width), static_cast<float>(layout.height));
+			for (const Candidate& member : layout.members) {
+				for (int level = 0; level < layout.level_count; level++) {
+					copy_level(member, array, level);
+				}
+
+				Placement& placement = m_placements[member.handle];
+				placement.array = index;
+				placement.layer = member.layer;
+				placement.offset = glm::vec2(member.x + member.gutter, member.y + member.gutter) / page_size;
+				placement.scale = glm::vec2(member.width, member.height) / page_size;
+			}
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	if constexpr (constants::DEBUG) {
+		std::cout << "TEXTURE_ATLAS packed " << m_placements.size() << " of " << handles.size() << " textures into "
+				  << m_arrays.size() << " arrays, " << m_layer_count << " layers, " << m_memory_size / 1024 << " KiB"
+				  << std::endl;
+	}
+}
+
+void Texture_Atlas::build(const Model& model) {
+	std::vector<Handle> handles;
+	for (const Mesh& mesh : model.meshes) {
+		auto diffuse = std::find_if(mesh.textures.begin(), mesh.textures.end(),
+									[](const Material_Texture& texture) { return texture.type == "texture_diffuse"; });
+		// build() skips duplicates
+		if (diffuse != mesh.textures.end()) {
+			handles.push_back(diffuse->handle);
+		}
+	}
+
+	build(handles);
+}
+
+const Texture_Atlas::Placement* Texture_Atlas::find(Handle handle) const {
+	auto it = m_placements.find(handle);
+	return it != m_placements.end() ? &it->second : nullptr;
+}
+
+Texture_Atlas::Stats Texture_Atlas::stats() const {
+	return {m_placements.size(), m_arrays.size(), m_layer_count, m_memory_size};
+}
+
+void Texture_Atlas::release() {
+	glDeleteTextures(static_cast<GLsizei>(m_arrays.size()), m_arrays.data());
+	m_arrays.clear();
+	m_placements.clear();
+	m_layer_count = 0;
+	m_memory_size = 0;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "model.h"
+#include "texture_registry.h"
+
+// Packs small textures into GL_TEXTURE_2D_ARRAYs, so draws that sample different ones can share a single bind.
+//
+// Textures are grouped by internal format. If every texture in a group has the same size, each gets a layer of its
+// own and keeps its full mip chain. Otherwise the group becomes an atlas. A texture as large as the atlas pages still
+// gets a whole layer. Smaller ones are shelf packed into pages, each surrounded by a gutter holding its opposite edges,
+// so GL_REPEAT filtering across the seam samples the right texels. A gutter is GUTTER_BLOCKS blocks wide
+// and cells sit on gutter-sized steps. That keeps the gutter at least a block wide, on block boundaries, down to
+// level log2(GUTTER_BLOCKS). Atlases stop there, so coarser levels never blend two neighbours.
+//
+// Everything is copied on the GPU with glCopyImageSubData, which needs GL 4.3. The textures themselves are left as
+// they are, so anything that wasn't packed (too large, not a power of two, or still being streamed) is drawn the
+// usual way. A shader applies a placement as uv' = offset + fract(uv) * scale, sampled with the gradients of the
+// unwrapped uv, see shaders/model_indirect.frag.
+class Texture_Atlas {
+   public:
+	using Handle = Texture_Registry::Handle;
+
+	// larger textures are left alone, binding them is rarely what a frame is waiting on
+	static constexpr int MAX_PACKED_SIZE = 512;
+	// in 4x4 blocks for compressed formats, texels otherwise
+	static constexpr int GUTTER_BLOCKS = 4;
+	// the layer a draw samples when its texture isn't packed
+	static constexpr uint32_t NO_LAYER = UINT32_MAX;
+
+	struct Placement {
+		// index into the atlas' arrays
+		uint32_t array = 0;
+		uint32_t layer = 0;
+		glm::vec2 offset = glm::vec2(0.0f);
+		glm::vec2 scale = glm::vec2(1.0f);
+	};
+
+	struct Stats {
+		size_t packed_count = 0;
+		size_t array_count = 0;
+		size_t layer_count = 0;
+		size_t memory_size = 0;
+	};
+
+	Texture_Atlas() = default;
+	Texture_Atlas(const Texture_Atlas&) = delete;
+	Texture_Atlas& operator=(const Texture_Atlas&) = delete;
+	~Texture_Atlas();
+
+	static bool supported();
+
+	// Replaces whatever was packed before with the textures at `handles` that can be packed. The copies are
+	// independent of the originals. Context thread only.
+	void build(std::span<const Handle> handles);
+	// the first diffuse texture of every mesh, the one Indirect_Draw_List looks placements up for
+	void build(const Model& model);
+
+	// nullptr if the texture wasn't packed
+	const Placement* find(Handle handle) const;
+	GLuint array(uint32_t index) const { return m_arrays[index]; }
+	size_t array_count() const { return m_arrays.size(); }
+	// changes with every build(), so users of the placements can tell they're stale
+	uint64_t generation() const { return m_generation; }
+	Stats stats() const;
+
+   private:
+	std::vector<GLuint> m_arrays;
+	std::unordered_map<Handle, Placement> m_placements;
+	size_t m_layer_count = 0;
+	size_t m_memory_size = 0;
+	uint64_t m_generation = 0;
+
+	void release();
+};
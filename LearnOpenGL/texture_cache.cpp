@@ -0,0 +1,352 @@
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+#include "config.h"
+#include "fs_util.h"
+#include "texture_cache.h"
+
+using block_compression::Block_Format;
+using block_compression::Compressed_Image;
+
+namespace {
+
+constexpr char MAGIC[8] = {'L', 'O', 'G', 'L', 'B', 'C', 'T', 'X'};
+// a 1x1 texture has one level, anything past this is a corrupt header
+constexpr uint32_t MAX_LEVELS = 32;
+
+struct File_Header {
+	char magic[8];
+	uint32_t version;
+	uint32_t format;
+	uint64_t source_hash;
+	uint64_t source_size;
+	int64_t source_write_time;
+	uint32_t num_chans;
+	uint32_t level_count;
+	uint32_t mip_filter;
+	uint32_t color_space;
+};
+
+struct Level_Record {
+	uint32_t width;
+	uint32_t height;
+	uint64_t offset;
+	uint64_t size;
+};
+
+int64_t write_time(const std::filesystem::path& path, std::error_code& error) {
+	return std::filesystem::last_write_time(path, error).time_since_epoch().count();
+}
+
+std::filesystem::path cache_path_for(const std::filesystem::path& source) {
+	std::string key = std::filesystem::absolute(source).generic_string();
+	uint64_t key_hash = fs_util::hash_bytes(std::as_bytes(std::span(key)));
+
+	std::stringstream name;
+	name << source.stem().string() << "-" << std::hex << std::setw(16) << std::setfill('0') << key_hash << ".btex";
+	return constants::CACHE_PATH / "textures" / name.str();
+}
+
+std::filesystem::path cubemap_path_for(std::span<const std::filesystem::path> faces) {
+	std::string key;
+	for (const std::filesystem::path& face : faces) {
+		key += std::filesystem::absolute(face).generic_string();
+		key += '\n';
+	}
+	uint64_t key_hash = fs_util::hash_bytes(std::as_bytes(std::span(key)));
+
+	std::stringstream name;
+	name << faces[0].parent_path().filename().string() << "-" << std::hex << std::setw(16) << std::setfill('0')
+		 << key_hash << ".ktx2";
+	return constants::CACHE_PATH / "textures" / name.str();
+}
+
+// stored in the cube map's key/value data, so a changed face or encoder invalidates the file
+std::string cubemap_source_key(std::span<const std::filesystem::path> faces) {
+	std::stringstream key;
+	key << "v" << texture_cache::VERSION;
+	for (const std::filesystem::path& face : faces) {
+		key << "-" << std::hex << std::setw(16) << std::setfill('0') << fs_util::hash_file(face);
+	}
+	return key.str();
+}
+
+constexpr std::string_view CUBEMAP_SOURCE_KEY = "LearnOpenGL.source";
+constexpr std::string_view IRRADIANCE_KEY = "LearnOpenGL.irradiance";
+
+std::filesystem::path environment_path_for(const std::filesystem::path& source) {
+	std::string key = std::filesystem::absolute(source).generic_string();
+	uint64_t key_hash = fs_util::hash_bytes(std::as_bytes(std::span(key)));
+
+	std::stringstream name;
+	name << source.stem().string() << "-" << std::hex << std::setw(16) << std::setfill('0') << key_hash << ".ktx2";
+	return constants::CACHE_PATH / "textures" / name.str();
+}
+
+// like cubemap_source_key, and a bake with other options or level count is just as stale
+std::string environment_source_key(const std::filesystem::path& source, const environment_map::Options& options) {
+	std::stringstream key;
+	key << "v" << texture_cache::VERSION << "-" << std::hex << std::setw(16) << std::setfill('0')
+		<< fs_util::hash_file(source) << std::dec << "-" << options.face_size << "-" << options.sample_count << "-"
+		<< environment_map::LEVELS;
+	return key.str();
+}
+
+// nine significant digits bring every float back exactly
+std::string format_irradiance(const environment_map::Irradiance& irradiance) {
+	std::stringstream text;
+	text << std::setprecision(9);
+	for (const glm::vec3& coefficient : irradiance) {
+		text << coefficient.r << " " << coefficient.g << " " << coefficient.b << " ";
+	}
+	return text.str();
+}
+
+std::optional<environment_map::Irradiance> parse_irradiance(std::string_view text) {
+	std::stringstream stream{std::string(text)};
+	environment_map::Irradiance irradiance;
+	for (glm::vec3& coefficient : irradiance) {
+		if (!(stream >> coefficient.r >> coefficient.g >> coefficient.b)) {
+			return std::nullopt;
+		}
+	}
+	return irradiance;
+}
+
+}
+
+texture_cache::Texture_Source texture_cache::load(const std::filesystem::path& source,
+												  std::string_view type,
+												  const block_compression::Support* support,
+												  mipmap::Filter filter) {
+	Texture_Source result;
+	if (texture_container::is_container(source)) {
+		result.container = texture_container::Container::open(source);
+		return result;
+	}
+
+	mipmap::Options mip_options{filter, mipmap::color_space(type)};
+	if (!support) {
+		result.image = Image::decode(source);
+		result.mips = mipmap::generate(result.image, mip_options);
+		return result;
+	}
+
+	result.compressed = read(source, mip_options);
+	if (result.compressed &&
+		block_compression::choose_format(result.compressed.num_chans, *support) == result.compressed.format) {
+		return result;
+	}
+
+	result.compressed = {};
+	result.image = Image::decode(source);
+	if (!result.image) {
+		return result;
+	}
+
+	std::optional<Block_Format> format = block_compression::choose_format(result.image.num_chans, *support);
+	if (!format) {
+		result.mips = mipmap::generate(result.image, mip_options);
+		return result;
+	}
+
+	result.compressed = block_compression::compress(result.image, *format, mip_options);
+	write(source, result.compressed, mip_options);
+	result.image = {};
+	return result;
+}
+
+Compressed_Image texture_cache::read(const std::filesystem::path& source, const mipmap::Options& mip_options) {
+	auto file = std::make_shared<fs_util::Mapped_File>();
+	if (!file->open(cache_path_for(source))) {
+		return {};
+	}
+
+	std::span<const std::byte> bytes = file->bytes();
+	File_Header header;
+	if (bytes.size() < sizeof(header)) {
+		return {};
+	}
+	std::memcpy(&header, bytes.data(), sizeof(header));
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+		header.format > static_cast<uint32_t>(Block_Format::bc7) || header.level_count == 0 ||
+		header.level_count > MAX_LEVELS || header.mip_filter != static_cast<uint32_t>(mip_options.filter) ||
+		header.color_space != static_cast<uint32_t>(mip_options.color_space)) {
+		return {};
+	}
+
+	// an untouched source keeps its size and write time, only a touched one is hashed to tell an edit from a copy
+	std::error_code error;
+	uint64_t source_size = std::filesystem::file_size(source, error);
+	if (error || source_size != header.source_size) {
+		return {};
+	}
+	int64_t source_write_time = write_time(source, error);
+	if (error ||
+		(source_write_time != header.source_write_time && fs_util::hash_file(source) != header.source_hash)) {
+		return {};
+	}
+
+	uint64_t data_offset = sizeof(File_Header) + header.level_count * sizeof(Level_Record);
+	if (bytes.size() < data_offset) {
+		return {};
+	}
+
+	Compressed_Image image;
+	image.format = static_cast<Block_Format>(header.format);
+	image.num_chans = static_cast<int>(header.num_chans);
+	image.levels.resize(header.level_count);
+	uint64_t data_size = bytes.size() - data_offset;
+	for (uint32_t i = 0; i < header.level_count; i++) {
+		Level_Record record;
+		std::memcpy(&record, bytes.data() + sizeof(File_Header) + i * sizeof(Level_Record), sizeof(record));
+
+		uint64_t expected_size = uint64_t(block_compression::block_count(record.width)) *
+								 block_compression::block_count(record.height) *
+								 block_compression::block_size(image.format);
+		if (record.size != expected_size || record.offset > data_size || record.size > data_size - record.offset) {
+			return {};
+		}
+		image.levels[i] = {record.width, record.height, data_offset + record.offset, record.size};
+	}
+
+	// the blocks are used straight from the mapping, so the streamer can read levels back long after the load
+	image.file = std::move(file);
+	return image;
+}
+
+bool texture_cache::write(const std::filesystem::path& source,
+						  const Compressed_Image& image,
+						  const mipmap::Options& mip_options) {
+	std::error_code error;
+	File_Header header{};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.format = static_cast<uint32_t>(image.format);
+	header.source_size = std::filesystem::file_size(source, error);
+	if (error) {
+		return false;
+	}
+	header.source_write_time = write_time(source, error);
+	if (error) {
+		return false;
+	}
+	header.source_hash = fs_util::hash_file(source);
+	header.num_chans = static_cast<uint32_t>(image.num_chans);
+	header.level_count = static_cast<uint32_t>(image.levels.size());
+	header.mip_filter = static_cast<uint32_t>(mip_options.filter);
+	header.color_space = static_cast<uint32_t>(mip_options.color_space);
+
+	std::filesystem::path path = cache_path_for(source);
+	std::filesystem::create_directories(path.parent_path(), error);
+	std::filesystem::path temp_path = path;
+	temp_path += ".tmp";
+
+	{
+		std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			std::cerr << "WARNING: could not write texture cache '" << temp_path << "'" << std::endl;
+			return false;
+		}
+
+		// the levels are written back to back, whether `image` was encoded or read from a mapping
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		uint64_t offset = 0;
+		for (const block_compression::Mip_Level& level : image.levels) {
+			Level_Record record{level.width, level.height, offset, level.size};
+			file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+			offset += level.size;
+		}
+		for (size_t level = 0; level < image.levels.size(); level++) {
+			std::span<const std::byte> data = image.level_data(level);
+			file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+		}
+
+		if (!file) {
+			std::cerr << "WARNING: could not write texture cache '" << temp_path << "'" << std::endl;
+			return false;
+		}
+	}
+
+	// rename last so a crash mid-write never leaves a truncated cache behind
+	std::filesystem::rename(temp_path, path, error);
+	if (error) {
+		std::filesystem::remove(temp_path, error);
+		return false;
+	}
+
+	return true;
+}
+
+std::optional<texture_container::Container> texture_cache::read_cubemap(std::span<const std::filesystem::path> faces) {
+	std::filesystem::path path = cubemap_path_for(faces);
+	std::error_code error;
+	if (!std::filesystem::exists(path, error)) {
+		return std::nullopt;
+	}
+
+	std::optional<texture_container::Container> container = texture_container::Container::open(path);
+	if (!container || container->target != GL_TEXTURE_CUBE_MAP ||
+		container->find_value(CUBEMAP_SOURCE_KEY) != cubemap_source_key(faces)) {
+		return std::nullopt;
+	}
+
+	return container;
+}
+
+std::optional<texture_container::Container> texture_cache::write_cubemap(std::span<const std::filesystem::path> faces,
+																		 std::span<const Compressed_Image> images) {
+	std::string source_key = cubemap_source_key(faces);
+	std::pair<std::string_view, std::string_view> key_values[] = {{"KTXwriter", "LearnOpenGL"},
+																  {CUBEMAP_SOURCE_KEY, source_key}};
+
+	std::filesystem::path path = cubemap_path_for(faces);
+	if (!texture_container::write_ktx2(path, images, key_values)) {
+		return std::nullopt;
+	}
+
+	return texture_container::Container::open(path);
+}
+
+std::optional<texture_cache::Environment_File> texture_cache::read_environment(
+	const std::filesystem::path& source,
+	const environment_map::Options& options) {
+	std::filesystem::path path = environment_path_for(source);
+	std::error_code error;
+	if (!std::filesystem::exists(path, error)) {
+		return std::nullopt;
+	}
+
+	std::optional<texture_container::Container> container = texture_container::Container::open(path);
+	if (!container || container->target != GL_TEXTURE_CUBE_MAP || container->internal_format != GL_RGBA16F ||
+		container->levels.size() != environment_map::LEVELS ||
+		container->find_value(CUBEMAP_SOURCE_KEY) != environment_source_key(source, options)) {
+		return std::nullopt;
+	}
+	std::optional<std::string_view> irradiance_text = container->find_value(IRRADIANCE_KEY);
+	std::optional<environment_map::Irradiance> irradiance =
+		irradiance_text ? parse_irradiance(*irradiance_text) : std::nullopt;
+	if (!irradiance) {
+		return std::nullopt;
+	}
+
+	return Environment_File{std::move(*container), *irradiance};
+}
+
+bool texture_cache::write_environment(const std::filesystem::path& source,
+									  const environment_map::Options& options,
+									  const environment_map::Baked& baked) {
+	std::string source_key = environment_source_key(source, options);
+	std::string irradiance = format_irradiance(baked.irradiance);
+	std::pair<std::string_view, std::string_view> key_values[] = {
+		{"KTXwriter", "LearnOpenGL"}, {CUBEMAP_SOURCE_KEY, source_key}, {IRRADIANCE_KEY, irradiance}};
+
+	return texture_container::write_ktx2_cubemap(environment_path_for(source), baked.face_size, baked.levels,
+												 key_values);
+}
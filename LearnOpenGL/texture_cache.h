@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "block_compression.h"
+#include "environment_map.h"
+#include "mipmap.h"
+#include "texture.h"
+#include "texture_container.h"
+
+// On-disk cache of block-compressed mip chains, so warm loads skip both the image decode and the encoder.
+//
+// Like the mesh cache, a file is named after the source path and validated against the hash of the source file's
+// contents, with the source's size and write time stored so a warm load only hashes a source that was touched. It is
+// a local build artifact in native byte order.
+namespace texture_cache {
+
+// bump whenever the file layout or the encoder's output changes
+constexpr uint32_t VERSION = 3;
+
+// What a texture file turned into on the CPU, exactly one of these is set: a mapped DDS/KTX2 container, compressed
+// blocks if the context can use them, or plain pixels.
+struct Texture_Source {
+	std::optional<texture_container::Container> container;
+	Image image;
+	// the rest of `image`'s mip chain, level 1 first
+	std::vector<mipmap::Level> mips;
+	block_compression::Compressed_Image compressed;
+};
+
+// Containers are only mapped. For images, returns the cached mip chain if it is current and was built the way `type`
+// and `filter` call for; otherwise decodes the source, then compresses and caches it. Without `support`, or if no
+// block format suits the image, it stays as plain pixels with CPU-built mips. CPU only.
+Texture_Source load(const std::filesystem::path& source,
+					std::string_view type,
+					const block_compression::Support* support,
+					mipmap::Filter filter = mipmap::Filter::kaiser);
+
+// Returns nothing usable if there is no cache for `source`, or it is stale, corrupt or built with other mip options.
+// The blocks aren't copied, the image keeps the file mapped.
+block_compression::Compressed_Image read(const std::filesystem::path& source, const mipmap::Options& mip_options);
+
+// returns false if the cache couldn't be written, which is never fatal
+bool write(const std::filesystem::path& source,
+		   const block_compression::Compressed_Image& image,
+		   const mipmap::Options& mip_options);
+
+// The six faces of a cube map baked into one KTX2 file. read_cubemap returns nothing if the file is missing or any face
+// has changed since. write_cubemap returns the written file opened again, or nothing if it couldn't be written.
+std::optional<texture_container::Container> read_cubemap(std::span<const std::filesystem::path> faces);
+std::optional<texture_container::Container> write_cubemap(std::span<const std::filesystem::path> faces,
+														  std::span<const block_compression::Compressed_Image> images);
+
+// An environment_map bake as a half float KTX2 cube map, with the irradiance coefficients in its key/value data.
+struct Environment_File {
+	texture_container::Container container;
+	environment_map::Irradiance irradiance{};
+};
+
+// Returns nothing if `source` wasn't baked with `options`, or has changed since.
+std::optional<Environment_File> read_environment(const std::filesystem::path& source,
+												 const environment_map::Options& options);
+// returns false if the cache couldn't be written, which is never fatal
+bool write_environment(const std::filesystem::path& source,
+					   const environment_map::Options& options,
+					   const environment_map::Baked& baked);
+
+}
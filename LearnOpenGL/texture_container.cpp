@@ -0,0 +1,927 @@
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <system_error>
+
+#include "texture_container.h"
+
+using block_compression::Block_Format;
+
+namespace {
+
+struct Format {
+	GLenum internal_format;
+	GLenum format;
+	GLenum type;
+	// per 4x4 block for compressed formats, per texel otherwise
+	uint32_t bytes;
+	bool compressed;
+	int num_chans;
+};
+
+constexpr Format compressed_format(GLenum internal_format, uint32_t block_bytes, int num_chans) {
+	return {internal_format, 0, 0, block_bytes, true, num_chans};
+}
+
+constexpr Format plain_format(GLenum internal_format, GLenum format, GLenum type, uint32_t bytes, int num_chans) {
+	return {internal_format, format, type, bytes, false, num_chans};
+}
+
+// the DXGI_FORMAT values of the DX10 header
+std::optional<Format> dxgi_format(uint32_t dxgi_format) {
+	using namespace block_compression;
+	switch (dxgi_format) {
+		case 2:
+			return plain_format(GL_RGBA32F, GL_RGBA, GL_FLOAT, 16, 4);
+		case 10:
+			return plain_format(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, 8, 4);
+		case 28:
+			return plain_format(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, 4);
+		case 29:
+			return plain_format(GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, 4);
+		case 49:
+			return plain_format(GL_RG8, GL_RG, GL_UNSIGNED_BYTE, 2, 2);
+		case 61:
+			return plain_format(GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, 1);
+		case 87:
+			return plain_format(GL_RGBA8, GL_BGRA, GL_UNSIGNED_BYTE, 4, 4);
+		case 91:
+			return plain_format(GL_SRGB8_ALPHA8, GL_BGRA, GL_UNSIGNED_BYTE, 4, 4);
+		case 71:
+			return compressed_format(COMPRESSED_RGBA_S3TC_DXT1, 8, 4);
+		case 72:
+			return compressed_format(COMPRESSED_SRGB_ALPHA_S3TC_DXT1, 8, 4);
+		case 74:
+			return compressed_format(COMPRESSED_RGBA_S3TC_DXT3, 16, 4);
+		case 75:
+			return compressed_format(COMPRESSED_SRGB_ALPHA_S3TC_DXT3, 16, 4);
+		case 77:
+			return compressed_format(COMPRESSED_RGBA_S3TC_DXT5, 16, 4);
+		case 78:
+			return compressed_format(COMPRESSED_SRGB_ALPHA_S3TC_DXT5, 16, 4);
+		case 80:
+			return compressed_format(GL_COMPRESSED_RED_RGTC1, 8, 1);
+		case 83:
+			return compressed_format(GL_COMPRESSED_RG_RGTC2, 16, 2);
+		case 95:
+			return compressed_format(GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, 16, 3);
+		case 96:
+			return compressed_format(GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT, 16, 3);
+		case 98:
+			return compressed_format(GL_COMPRESSED_RGBA_BPTC_UNORM, 16, 4);
+		case 99:
+			return compressed_format(GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, 16, 4);
+	}
+
+	return std::nullopt;
+}
+
+// the VkFormat values KTX2 files are tagged with
+std::optional<Format> vulkan_format(uint32_t vk_format) {
+	using namespace block_compression;
+	switch (vk_format) {
+		case 9:
+			return plain_format(GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, 1);
+		case 16:
+			return plain_format(GL_RG8, GL_RG, GL_UNSIGNED_BYTE, 2, 2);
+		case 23:
+			return plain_format(GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE, 3, 3);
+		case 29:
+			return plain_format(GL_SRGB8, GL_RGB, GL_UNSIGNED_BYTE, 3, 3);
+		case 37:
+			return plain_format(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, 4);
+		case 43:
+			return plain_format(GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, 4);
+		case 44:
+			return plain_format(GL_RGBA8, GL_BGRA, GL_UNSIGNED_BYTE, 4, 4);
+		case 50:
+			return plain_format(GL_SRGB8_ALPHA8, GL_BGRA, GL_UNSIGNED_BYTE, 4, 4);
+		case 97:
+			return plain_format(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, 8, 4);
+		case 109:
+			return plain_format(GL_RGBA32F, GL_RGBA, GL_FLOAT, 16, 4);
+		case 131:
+			return compressed_format(COMPRESSED_RGB_S3TC_DXT1, 8, 3);
+		case 132:
+			return compressed_format(COMPRESSED_SRGB_S3TC_DXT1, 8, 3);
+		case 133:
+			return compressed_format(COMPRESSED_RGBA_S3TC_DXT1, 8, 4);
+		case 134:
+			return compressed_format(COMPRESSED_SRGB_ALPHA_S3TC_DXT1, 8, 4);
+		case 135:
+			return compressed_format(COMPRESSED_RGBA_S3TC_DXT3, 16, 4);
+		case 136:
+			return compressed_format(COMPRESSED_SRGB_ALPHA_S3TC_DXT3, 16, 4);
+		case 137:
+			return compressed_format(COMPRESSED_RGBA_S3TC_DXT5, 16, 4);
+		case 138:
+			return compressed_format(COMPRESSED_SRGB_ALPHA_S3TC_DXT5, 16, 4);
+		case 139:
+			return compressed_format(GL_COMPRESSED_RED_RGTC1, 8, 1);
+		case 141:
+			return compressed_format(GL_COMPRESSED_RG_RGTC2, 16, 2);
+		case 143:
+			return compressed_format(GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, 16, 3);
+		case 144:
+			return compressed_format(GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT, 16, 3);
+		case 145:
+			return compressed_format(GL_COMPRESSED_RGBA_BPTC_UNORM, 16, 4);
+		case 146:
+			return compressed_format(GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, 16, 4);
+	}
+
+	return std::nullopt;
+}
+
+uint32_t vulkan_format_for(Block_Format format) {
+	switch (format) {
+		case Block_Format::bc1:
+			return 131;
+		case Block_Format::bc3:
+			return 137;
+		case Block_Format::bc5:
+			return 141;
+		case Block_Format::bc7:
+			return 145;
+	}
+
+	return 0;
+}
+
+uint64_t image_size(const Format& format, uint32_t width, uint32_t height) {
+	if (format.compressed) {
+		return uint64_t(block_compression::block_count(width)) * block_compression::block_count(height) * format.bytes;
+	}
+
+	return uint64_t(width) * height * format.bytes;
+}
+
+template <typename T>
+bool read_value(std::span<const std::byte> bytes, uint64_t offset, T& value) {
+	if (offset > bytes.size() || sizeof(T) > bytes.size() - offset) {
+		return false;
+	}
+
+	std::memcpy(&value, bytes.data() + offset, sizeof(T));
+	return true;
+}
+
+bool in_bounds(std::span<const std::byte> bytes, uint64_t offset, uint64_t size) {
+	return offset <= bytes.size() && size <= bytes.size() - offset;
+}
+
+// whether `image_count` images, each with a chain of `level_count` levels, fit in `bytes`; the sizes come from a header
+// that may be corrupt, so every step is checked against the file size by division before it could overflow
+bool chain_fits(std::span<const std::byte> bytes,
+				const Format& format,
+				uint32_t width,
+				uint32_t height,
+				uint32_t level_count,
+				uint64_t image_count) {
+	uint64_t chain_size = 0;
+	for (uint32_t level = 0; level < level_count; level++) {
+		uint32_t level_width = std::max(1u, width >> level);
+		uint32_t level_height = std::max(1u, height >> level);
+		uint64_t units = format.compressed ? uint64_t(block_compression::block_count(level_width)) *
+												 block_compression::block_count(level_height)
+										   : uint64_t(level_width) * level_height;
+		if (units > bytes.size() / format.bytes) {
+			return false;
+		}
+		chain_size += units * format.bytes;
+		if (chain_size > bytes.size()) {
+			return false;
+		}
+	}
+
+	return image_count <= bytes.size() / chain_size;
+}
+
+constexpr uint32_t four_cc(char a, char b, char c, char d) {
+	return uint32_t(uint8_t(a)) | uint32_t(uint8_t(b)) << 8 | uint32_t(uint8_t(c)) << 16 | uint32_t(uint8_t(d)) << 24;
+}
+
+uint64_t align_up(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+std::string lowercase_extension(const std::filesystem::path& path) {
+	std::string extension = path.extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(),
+				   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return extension;
+}
+
+void report(const std::filesystem::path& path, const char* problem) {
+	std::cerr << "ERROR::TEXTURE_CONTAINER\n" << "'" << path << "': " << problem << std::endl;
+}
+
+struct Dds_Pixel_Format {
+	uint32_t size;
+	uint32_t flags;
+	uint32_t four_cc;
+	uint32_t rgb_bit_count;
+	uint32_t r_mask;
+	uint32_t g_mask;
+	uint32_t b_mask;
+	uint32_t a_mask;
+};
+
+struct Dds_Header {
+	uint32_t size;
+	uint32_t flags;
+	uint32_t height;
+	uint32_t width;
+	uint32_t pitch_or_linear_size;
+	uint32_t depth;
+	uint32_t mip_map_count;
+	uint32_t reserved1[11];
+	Dds_Pixel_Format pixel_format;
+	uint32_t caps;
+	uint32_t caps2;
+	uint32_t caps3;
+	uint32_t caps4;
+	uint32_t reserved2;
+};
+
+struct Dds_Header_Dx10 {
+	uint32_t dxgi_format;
+	uint32_t resource_dimension;
+	uint32_t misc_flag;
+	uint32_t array_size;
+	uint32_t misc_flags2;
+};
+
+constexpr uint32_t DDS_MAGIC = four_cc('D', 'D', 'S', ' ');
+constexpr uint32_t DDPF_ALPHAPIXELS = 0x1;
+constexpr uint32_t DDPF_FOURCC = 0x4;
+constexpr uint32_t DDPF_RGB = 0x40;
+constexpr uint32_t DDSCAPS2_CUBEMAP = 0x200;
+constexpr uint32_t DDSCAPS2_CUBEMAP_ALL_FACES = 0xFC00;
+constexpr uint32_t DDSCAPS2_VOLUME = 0x200000;
+constexpr uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+constexpr uint32_t DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+constexpr uint8_t KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+// everything after the identifier up to the supercompression global data, which is never used here
+struct Ktx2_Header {
+	uint32_t vk_format;
+	uint32_t type_size;
+	uint32_t pixel_width;
+	uint32_t pixel_height;
+	uint32_t pixel_depth;
+	uint32_t layer_count;
+	uint32_t face_count;
+	uint32_t level_count;
+	uint32_t supercompression_scheme;
+	uint32_t dfd_byte_offset;
+	uint32_t dfd_byte_length;
+	uint32_t kvd_byte_offset;
+	uint32_t kvd_byte_length;
+};
+
+struct Ktx2_Level {
+	uint64_t byte_offset;
+	uint64_t byte_length;
+	uint64_t uncompressed_byte_length;
+};
+
+// identifier, header and the two 64-bit supercompression fields
+constexpr uint64_t KTX2_LEVEL_INDEX_OFFSET = 80;
+
+// The basic data format descriptor KTX2 requires, for the block formats the writer emits: one sample per 64-bit half
+// of the block, or one for the whole BC7 block.
+std::vector<uint32_t> basic_descriptor(Block_Format format) {
+	struct Sample {
+		uint32_t bit_offset;
+		uint32_t bit_length;
+		uint32_t channel;
+	};
+	constexpr uint32_t CHANNEL_RED = 0, CHANNEL_GREEN = 1, CHANNEL_ALPHA = 15;
+
+	uint32_t color_model = 0;
+	std::vector<Sample> samples;
+	switch (format) {
+		case Block_Format::bc1:
+			color_model = 128;
+			samples = {{0, 63, CHANNEL_RED}};
+			break;
+		case Block_Format::bc3:
+			color_model = 130;
+			samples = {{0, 63, CHANNEL_ALPHA}, {64, 63, CHANNEL_RED}};
+			break;
+		case Block_Format::bc5:
+			color_model = 132;
+			samples = {{0, 63, CHANNEL_RED}, {64, 63, CHANNEL_GREEN}};
+			break;
+		case Block_Format::bc7:
+			color_model = 134;
+			samples = {{0, 127, CHANNEL_RED}};
+			break;
+	}
+
+	uint32_t block_size = 24 + 16 * static_cast<uint32_t>(samples.size());
+	// BT.709 primaries, linear transfer, straight alpha, 4x4 texel blocks
+	std::vector<uint32_t> words = {4 + block_size,
+								   0,
+								   2 | block_size << 16,
+								   color_model | 1 << 8 | 1 << 16,
+								   3 | 3 << 8,
+								   static_cast<uint32_t>(block_compression::block_size(format)),
+								   0};
+	words.reserve(words.size() + 4 * samples.size());
+	for (const Sample& sample : samples) {
+		words.push_back(sample.bit_offset | sample.bit_length << 16 | sample.channel << 24);
+		words.push_back(0);
+		words.push_back(0);
+		words.push_back(UINT32_MAX);
+	}
+
+	return words;
+}
+
+// The descriptor for RGBA16F: one 16-bit float sample per channel, in -1..1 as the spec's float convention has it.
+std::vector<uint32_t> half_float_descriptor() {
+	constexpr uint32_t CHANNEL_ALPHA = 15;
+	constexpr uint32_t QUALIFIER_FLOAT_SIGNED = 0xC0;
+	constexpr uint32_t FLOAT_MINUS_ONE = 0xBF800000, FLOAT_ONE = 0x3F800000;
+
+	uint32_t block_size = 24 + 16 * 4;
+	// RGBSDA, BT.709 primaries, linear transfer, straight alpha, 1x1 texel blocks of 8 bytes
+	std::vector<uint32_t> words = {4 + block_size, 0, 2 | block_size << 16, 1 | 1 << 8 | 1 << 16, 0, 8, 0};
+	words.reserve(words.size() + 4 * 4);
+	for (uint32_t channel = 0; channel < 4; channel++) {
+		uint32_t id = channel == 3 ? CHANNEL_ALPHA : channel;
+		words.push_back(channel * 16 | 15 << 16 | (id | QUALIFIER_FLOAT_SIGNED) << 24);
+		words.push_back(0);
+		words.push_back(FLOAT_MINUS_ONE);
+		words.push_back(FLOAT_ONE);
+	}
+
+	return words;
+}
+
+// Writes a KTX2 file for `header`, which only needs the format, size, face and level counts filled in. `levels` holds
+// the images of every level, level 0 first; they are stored smallest level first, each aligned to `alignment`.
+bool write_ktx2_file(const std::filesystem::path& path,
+					 Ktx2_Header header,
+					 std::span<const uint32_t> descriptor,
+					 std::span<const std::pair<std::string_view, std::string_view>> key_values,
+					 std::span<const std::vector<std::span<const std::byte>>> levels,
+					 uint64_t alignment) {
+	// entries are sorted by key, each one NUL-terminated key, NUL-terminated value, padded to 4 bytes
+	std::vector<std::pair<std::string_view, std::string_view>> sorted(key_values.begin(), key_values.end());
+	std::sort(sorted.begin(), sorted.end());
+	std::string key_value_data;
+	for (const auto& [key, value] : sorted) {
+		uint32_t length = static_cast<uint32_t>(key.size() + value.size() + 2);
+		key_value_data.append(reinterpret_cast<const char*>(&length), sizeof(length));
+		key_value_data.append(key).append(1, '\0').append(value).append(1, '\0');
+		key_value_data.resize(align_up(key_value_data.size(), 4), '\0');
+	}
+
+	size_t level_count = levels.size();
+	header.level_count = static_cast<uint32_t>(level_count);
+	header.dfd_byte_offset = static_cast<uint32_t>(KTX2_LEVEL_INDEX_OFFSET + level_count * sizeof(Ktx2_Level));
+	header.dfd_byte_length = static_cast<uint32_t>(descriptor.size() * sizeof(uint32_t));
+	header.kvd_byte_offset = header.dfd_byte_offset + header.dfd_byte_length;
+	header.kvd_byte_length = static_cast<uint32_t>(key_value_data.size());
+
+	std::vector<Ktx2_Level> level_index(level_count);
+	uint64_t offset = header.kvd_byte_offset + header.kvd_byte_length;
+	for (size_t level = level_count; level-- > 0;) {
+		offset = align_up(offset, alignment);
+		uint64_t length = 0;
+		for (std::span<const std::byte> image : levels[level]) {
+			length += image.size();
+		}
+		level_index[level] = {offset, length, length};
+		offset += length;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(path.parent_path(), error);
+	std::filesystem::path temp_path = path;
+	temp_path += ".tmp";
+
+	{
+		std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			std::cerr << "WARNING: could not write texture '" << temp_path << "'" << std::endl;
+			return false;
+		}
+
+		auto write_bytes = [&file](const void* data, size_t size) {
+			file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+		};
+		auto pad_to = [&file](uint64_t target) {
+			while (static_cast<uint64_t>(file.tellp()) < target) {
+				file.put('\0');
+			}
+		};
+
+		uint64_t supercompression_data[2] = {0, 0};
+		write_bytes(KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+		write_bytes(&header, sizeof(header));
+		write_bytes(supercompression_data, sizeof(supercompression_data));
+		write_bytes(level_index.data(), level_index.size() * sizeof(Ktx2_Level));
+		write_bytes(descriptor.data(), descriptor.size() * sizeof(uint32_t));
+		write_bytes(key_value_data.data(), key_value_data.size());
+		for (size_t level = level_count; level-- > 0;) {
+			pad_to(level_index[level].byte_offset);
+			for (std::span<const std::byte> image : levels[level]) {
+				write_bytes(image.data(), image.size());
+			}
+		}
+
+		if (!file) {
+			std::cerr << "WARNING: could not write texture '" << temp_path << "'" << std::endl;
+			return false;
+		}
+	}
+
+	// rename last so a crash mid-write never leaves a truncated file behind
+	std::filesystem::rename(temp_path, path, error);
+	if (error) {
+		std::filesystem::remove(temp_path, error);
+		return false;
+	}
+
+	return true;
+}
+
+}  // namespace
+
+std::optional<texture_container::Container> texture_container::Container::open(const std::filesystem::path& path) {
+	Container container;
+	if (!container.m_file.open(path)) {
+		report(path, "can't be opened");
+		return std::nullopt;
+	}
+
+	bool parsed = lowercase_extension(path) == ".dds" ? container.parse_dds(path) : container.parse_ktx2(path);
+	if (!parsed) {
+		return std::nullopt;
+	}
+
+	return container;
+}
+
+std::optional<std::string_view> texture_container::Container::find_value(std::string_view key) const {
+	uint64_t offset = 0;
+	uint32_t length = 0;
+	while (read_value(m_key_values, offset, length) && in_bounds(m_key_values, offset + 4, length)) {
+		std::string_view entry(reinterpret_cast<const char*>(m_key_values.data() + offset + 4), length);
+		size_t separator = entry.find('\0');
+		if (separator != std::string_view::npos && entry.substr(0, separator) == key) {
+			std::string_view value = entry.substr(separator + 1);
+			if (!value.empty() && value.back() == '\0') {
+				value.remove_suffix(1);
+			}
+			return value;
+		}
+
+		offset = align_up(offset + 4 + length, 4);
+	}
+
+	return std::nullopt;
+}
+
+bool texture_container::Container::parse_dds(const std::filesystem::path& path) {
+	std::span<const std::byte> bytes = m_file.bytes();
+	uint32_t magic = 0;
+	Dds_Header header;
+	if (!read_value(bytes, 0, magic) || magic != DDS_MAGIC || !read_value(bytes, 4, header) ||
+		header.size != sizeof(Dds_Header)) {
+		report(path, "not a DDS file");
+		return false;
+	}
+	uint64_t offset = 4 + sizeof(Dds_Header);
+
+	const Dds_Pixel_Format& pixel_format = header.pixel_format;
+	std::optional<Format> format;
+	bool cube = (header.caps2 & DDSCAPS2_CUBEMAP) != 0;
+	if (pixel_format.flags & DDPF_FOURCC) {
+		using namespace block_compression;
+		switch (pixel_format.four_cc) {
+			case four_cc('D', 'X', '1', '0'): {
+				Dds_Header_Dx10 dx10;
+				if (!read_value(bytes, offset, dx10) || dx10.resource_dimension != DDS_DIMENSION_TEXTURE2D) {
+					report(path, "only 2D DDS textures are supported");
+					return false;
+				}
+				offset += sizeof(Dds_Header_Dx10);
+				format = dxgi_format(dx10.dxgi_format);
+				cube = (dx10.misc_flag & DDS_RESOURCE_MISC_TEXTURECUBE) != 0;
+				if (dx10.array_size == 0) {
+					report(path, "invalid array size");
+					return false;
+				}
+				layers = dx10.array_size;
+				break;
+			}
+			case four_cc('D', 'X', 'T', '1'):
+				format = compressed_format(COMPRESSED_RGBA_S3TC_DXT1, 8, 4);
+				break;
+			case four_cc('D', 'X', 'T', '3'):
+				format = compressed_format(COMPRESSED_RGBA_S3TC_DXT3, 16, 4);
+				break;
+			case four_cc('D', 'X', 'T', '5'):
+				format = compressed_format(COMPRESSED_RGBA_S3TC_DXT5, 16, 4);
+				break;
+			case four_cc('A', 'T', 'I', '1'):
+			case four_cc('B', 'C', '4', 'U'):
+				format = compressed_format(GL_COMPRESSED_RED_RGTC1, 8, 1);
+				break;
+			case four_cc('A', 'T', 'I', '2'):
+			case four_cc('B', 'C', '5', 'U'):
+				format = compressed_format(GL_COMPRESSED_RG_RGTC2, 16, 2);
+				break;
+		}
+	} else if (pixel_format.flags & DDPF_RGB) {
+		bool alpha = (pixel_format.flags & DDPF_ALPHAPIXELS) != 0;
+		bool bgr = pixel_format.r_mask == 0xff0000 && pixel_format.g_mask == 0xff00 && pixel_format.b_mask == 0xff;
+		bool rgb = pixel_format.r_mask == 0xff && pixel_format.g_mask == 0xff00 && pixel_format.b_mask == 0xff0000;
+		if (pixel_format.rgb_bit_count == 32 && (rgb || bgr)) {
+			// without alpha the fourth byte is padding and the GL format drops it
+			format = plain_format(alpha ? GL_RGBA8 : GL_RGB8, bgr ? GL_BGRA : GL_RGBA, GL_UNSIGNED_BYTE, 4,
+								  alpha ? 4 : 3);
+		} else if (pixel_format.rgb_bit_count == 24 && (rgb || bgr)) {
+			format = plain_format(GL_RGB8, bgr ? GL_BGR : GL_RGB, GL_UNSIGNED_BYTE, 3, 3);
+		}
+	}
+
+	if (!format) {
+		report(path, "unsupported DDS pixel format");
+		return false;
+	}
+	if (header.caps2 & DDSCAPS2_VOLUME) {
+		report(path, "3D textures aren't supported");
+		return false;
+	}
+	if (cube && !(pixel_format.four_cc == four_cc('D', 'X', '1', '0')) &&
+		(header.caps2 & DDSCAPS2_CUBEMAP_ALL_FACES) != DDSCAPS2_CUBEMAP_ALL_FACES) {
+		report(path, "cube maps need all six faces");
+		return false;
+	}
+	if (cube && layers > 1) {
+		report(path, "cube map arrays aren't supported");
+		return false;
+	}
+	if (header.width == 0 || header.height == 0 || (cube && header.width != header.height)) {
+		report(path, "invalid dimensions");
+		return false;
+	}
+
+	// a 1x1 level ends the chain, anything past it (or past what the file can hold) is a corrupt header
+	uint32_t level_count = std::max(1u, header.mip_map_count);
+	if (level_count > static_cast<uint32_t>(std::bit_width(std::max(header.width, header.height)))) {
+		report(path, "too many mip levels");
+		return false;
+	}
+	if (!chain_fits(bytes.subspan(offset), *format, header.width, header.height, level_count,
+					uint64_t(layers) * (cube ? 6 : 1))) {
+		report(path, "file is truncated");
+		return false;
+	}
+
+	faces = cube ? 6 : 1;
+	target = cube ? GL_TEXTURE_CUBE_MAP : layers > 1 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+	internal_format = format->internal_format;
+	this->format = format->format;
+	type = format->type;
+	compressed = format->compressed;
+	num_chans = format->num_chans;
+
+	levels.resize(level_count);
+	for (uint32_t level = 0; level < level_count; level++) {
+		levels[level].width = std::max(1u, header.width >> level);
+		levels[level].height = std::max(1u, header.height >> level);
+		levels[level].images.resize(size_t(layers) * faces);
+	}
+
+	// DDS stores each layer and face with its whole mip chain before the next one
+	for (size_t image = 0; image < size_t(layers) * faces; image++) {
+		for (Level& level : levels) {
+			uint64_t size = image_size(*format, level.width, level.height);
+			if (!in_bounds(bytes, offset, size)) {
+				report(path, "file is truncated");
+				return false;
+			}
+			level.images[image] = bytes.subspan(offset, size);
+			offset += size;
+		}
+	}
+
+	return true;
+}
+
+bool texture_container::Container::parse_ktx2(const std::filesystem::path& path) {
+	std::span<const std::byte> bytes = m_file.bytes();
+	Ktx2_Header header;
+	if (bytes.size() < sizeof(KTX2_IDENTIFIER) ||
+		std::memcmp(bytes.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0 ||
+		!read_value(bytes, sizeof(KTX2_IDENTIFIER), header)) {
+		report(path, "not a KTX2 file");
+		return false;
+	}
+
+	std::optional<Format> format = vulkan_format(header.vk_format);
+	if (!format) {
+		report(path, "unsupported KTX2 format");
+		return false;
+	}
+	if (header.supercompression_scheme != 0) {
+		report(path, "supercompressed KTX2 files aren't supported");
+		return false;
+	}
+	if (header.pixel_depth > 0 || header.pixel_height == 0) {
+		report(path, "only 2D KTX2 textures are supported");
+		return false;
+	}
+	if (header.face_count != 1 && header.face_count != 6) {
+		report(path, "invalid face count");
+		return false;
+	}
+	if (header.face_count == 6 && header.layer_count > 0) {
+		report(path, "cube map arrays aren't supported");
+		return false;
+	}
+	if (header.pixel_width == 0 || (header.face_count == 6 && header.pixel_width != header.pixel_height)) {
+		report(path, "invalid dimensions");
+		return false;
+	}
+
+	layers = std::max(1u, header.layer_count);
+	faces = header.face_count;
+	target = faces == 6 ? GL_TEXTURE_CUBE_MAP : header.layer_count > 0 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+	internal_format = format->internal_format;
+	this->format = format->format;
+	type = format->type;
+	compressed = format->compressed;
+	num_chans = format->num_chans;
+
+	// a level count of zero asks the loader to build the chain, which only works for formats GL can render to
+	generate_mips = header.level_count == 0;
+	if (generate_mips && compressed) {
+		report(path, "compressed textures need a stored mip chain");
+		return false;
+	}
+
+	uint32_t level_count = std::max(1u, header.level_count);
+	if (level_count > static_cast<uint32_t>(std::bit_width(std::max(header.pixel_width, header.pixel_height)))) {
+		report(path, "too many mip levels");
+		return false;
+	}
+	if (!chain_fits(bytes, *format, header.pixel_width, header.pixel_height, level_count, uint64_t(layers) * faces)) {
+		report(path, "file is truncated");
+		return false;
+	}
+
+	levels.resize(level_count);
+	for (uint32_t level = 0; level < level_count; level++) {
+		Ktx2_Level record;
+		if (!read_value(bytes, KTX2_LEVEL_INDEX_OFFSET + level * sizeof(Ktx2_Level), record)) {
+			report(path, "file is truncated");
+			return false;
+		}
+
+		Level& mip = levels[level];
+		mip.width = std::max(1u, header.pixel_width >> level);
+		mip.height = std::max(1u, header.pixel_height >> level);
+		uint64_t size = image_size(*format, mip.width, mip.height);
+		if (record.byte_length != size * layers * faces || !in_bounds(bytes, record.byte_offset, record.byte_length)) {
+			report(path, "level size doesn't match its format");
+			return false;
+		}
+
+		// within a level the images are ordered by layer, then face
+		for (size_t image = 0; image < size_t(layers) * faces; image++) {
+			mip.images.push_back(bytes.subspan(record.byte_offset + image * size, size));
+		}
+	}
+
+	if (in_bounds(bytes, header.kvd_byte_offset, header.kvd_byte_length)) {
+		m_key_values = bytes.subspan(header.kvd_byte_offset, header.kvd_byte_length);
+	}
+
+	return true;
+}
+
+bool texture_container::is_container(const std::filesystem::path& path) {
+	std::string extension = lowercase_extension(path);
+	return extension == ".dds" || extension == ".ktx2";
+}
+
+GLuint texture_container::create(const Container& container) {
+	GLuint id = 0;
+	glGenTextures(1, &id);
+	glBindTexture(container.target, id);
+
+	bool mipmapped = container.levels.size() > 1 || container.generate_mips;
+	glTexParameteri(container.target, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(container.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	if (!container.generate_mips) {
+		glTexParameteri(container.target, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(container.levels.size() - 1));
+	}
+
+	return id;
+}
+
+void texture_container::upload_level(const Container& container, size_t level) {
+	const Level& mip = container.levels[level];
+	GLint gl_level = static_cast<GLint>(level);
+	GLsizei width = static_cast<GLsizei>(mip.width);
+	GLsizei height = static_cast<GLsizei>(mip.height);
+	// rows of tightly packed 1 and 3 byte texels aren't 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	if (container.target == GL_TEXTURE_2D_ARRAY) {
+		// DDS arrays aren't contiguous per level, so allocate the level and fill it a layer at a time
+		GLsizei layers = static_cast<GLsizei>(mip.images.size());
+		GLsizei size = static_cast<GLsizei>(mip.images[0].size());
+		if (container.compressed) {
+			glCompressedTexImage3D(container.target, gl_level, container.internal_format, width, height, layers, 0,
+								   size * layers, nullptr);
+		} else {
+			glTexImage3D(container.target, gl_level, static_cast<GLint>(container.internal_format), width, height,
+						 layers, 0, container.format, container.type, nullptr);
+		}
+
+		for (GLsizei layer = 0; layer < layers; layer++) {
+			const std::byte* data = mip.images[layer].data();
+			if (container.compressed) {
+				glCompressedTexSubImage3D(container.target, gl_level, 0, 0, layer, width, height, 1,
+										  container.internal_format, size, data);
+			} else {
+				glTexSubImage3D(container.target, gl_level, 0, 0, layer, width, height, 1, container.format,
+								container.type, data);
+			}
+		}
+	} else {
+		for (size_t face = 0; face < mip.images.size(); face++) {
+			GLenum face_target = container.target == GL_TEXTURE_CUBE_MAP
+									 ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + static_cast<GLenum>(face)
+									 : GL_TEXTURE_2D;
+			std::span<const std::byte> image = mip.images[face];
+			if (container.compressed) {
+				glCompressedTexImage2D(face_target, gl_level, container.internal_format, width, height, 0,
+									   static_cast<GLsizei>(image.size()), image.data());
+			} else {
+				glTexImage2D(face_target, gl_level, static_cast<GLint>(container.internal_format), width, height, 0,
+							 container.format, container.type, image.data());
+			}
+		}
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void texture_container::allocate_level(const Container& container, size_t level) {
+	const Level& mip = container.levels[level];
+	GLint gl_level = static_cast<GLint>(level);
+	GLsizei width = static_cast<GLsizei>(mip.width);
+	GLsizei height = static_cast<GLsizei>(mip.height);
+	GLsizei size = static_cast<GLsizei>(mip.images[0].size());
+
+	if (container.target == GL_TEXTURE_2D_ARRAY) {
+		GLsizei layers = static_cast<GLsizei>(mip.images.size());
+		if (container.compressed) {
+			glCompressedTexImage3D(container.target, gl_level, container.internal_format, width, height, layers, 0,
+								   size * layers, nullptr);
+		} else {
+			glTexImage3D(container.target, gl_level, static_cast<GLint>(container.internal_format), width, height,
+						 layers, 0, container.format, container.type, nullptr);
+		}
+		return;
+	}
+
+	for (size_t face = 0; face < mip.images.size(); face++) {
+		GLenum face_target = container.target == GL_TEXTURE_CUBE_MAP
+								 ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + static_cast<GLenum>(face)
+								 : GL_TEXTURE_2D;
+		if (container.compressed) {
+			glCompressedTexImage2D(face_target, gl_level, container.internal_format, width, height, 0, size, nullptr);
+		} else {
+			glTexImage2D(face_target, gl_level, static_cast<GLint>(container.internal_format), width, height, 0,
+						 container.format, container.type, nullptr);
+		}
+	}
+}
+
+void texture_container::upload_rows(const Container& container,
+									size_t level,
+									size_t image,
+									uint32_t first_row,
+									uint32_t row_count,
+									const void* data) {
+	const Level& mip = container.levels[level];
+	GLint gl_level = static_cast<GLint>(level);
+	GLsizei width = static_cast<GLsizei>(mip.width);
+	GLsizei size = static_cast<GLsizei>(row_count * row_size(container, level));
+	// the last row of blocks may reach past the edge of the level, which the sub-image can't
+	GLint y = static_cast<GLint>(container.compressed ? first_row * 4 : first_row);
+	GLsizei height = static_cast<GLsizei>(row_count);
+	if (container.compressed) {
+		height = std::min(static_cast<GLsizei>(row_count * 4), static_cast<GLsizei>(mip.height) - y);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	if (container.target == GL_TEXTURE_2D_ARRAY) {
+		GLint layer = static_cast<GLint>(image);
+		if (container.compressed) {
+			glCompressedTexSubImage3D(container.target, gl_level, 0, y, layer, width, height, 1,
+									  container.internal_format, size, data);
+		} else {
+			glTexSubImage3D(container.target, gl_level, 0, y, layer, width, height, 1, container.format,
+							container.type, data);
+		}
+	} else {
+		GLenum face_target = container.target == GL_TEXTURE_CUBE_MAP
+								 ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + static_cast<GLenum>(image)
+								 : GL_TEXTURE_2D;
+		if (container.compressed) {
+			glCompressedTexSubImage2D(face_target, gl_level, 0, y, width, height, container.internal_format, size,
+									  data);
+		} else {
+			glTexSubImage2D(face_target, gl_level, 0, y, width, height, container.format, container.type, data);
+		}
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+uint32_t texture_container::row_count(const Container& container, size_t level) {
+	uint32_t height = container.levels[level].height;
+	return container.compressed ? (height + 3) / 4 : height;
+}
+
+size_t texture_container::row_size(const Container& container, size_t level) {
+	return container.levels[level].images[0].size() / row_count(container, level);
+}
+
+bool texture_container::write_ktx2(const std::filesystem::path& path,
+								   std::span<const block_compression::Compressed_Image> images,
+								   std::span<const std::pair<std::string_view, std::string_view>> key_values) {
+	if ((images.size() != 1 && images.size() != 6) || !images[0]) {
+		return false;
+	}
+	const block_compression::Compressed_Image& first = images[0];
+	for (const block_compression::Compressed_Image& image : images) {
+		if (image.format != first.format || image.levels.size() != first.levels.size() ||
+			image.levels[0].width != first.levels[0].width || image.levels[0].height != first.levels[0].height) {
+			return false;
+		}
+	}
+
+	Ktx2_Header header{};
+	header.vk_format = vulkan_format_for(first.format);
+	header.type_size = 1;
+	header.pixel_width = first.levels[0].width;
+	header.pixel_height = first.levels[0].height;
+	header.face_count = static_cast<uint32_t>(images.size());
+
+	std::vector<std::vector<std::span<const std::byte>>> levels(first.levels.size());
+	for (size_t level = 0; level < levels.size(); level++) {
+		for (const block_compression::Compressed_Image& image : images) {
+			levels[level].push_back(image.level_data(level));
+		}
+	}
+
+	// each level aligned to a whole block
+	return write_ktx2_file(path, header, basic_descriptor(first.format), key_values, levels,
+						   block_compression::block_size(first.format));
+}
+
+bool texture_container::write_ktx2_cubemap(const std::filesystem::path& path,
+										   uint32_t face_size,
+										   std::span<const std::vector<uint16_t>> levels,
+										   std::span<const std::pair<std::string_view, std::string_view>> key_values) {
+	if (face_size == 0 || levels.empty()) {
+		return false;
+	}
+
+	std::vector<std::vector<std::span<const std::byte>>> images(levels.size());
+	for (size_t level = 0; level < levels.size(); level++) {
+		uint64_t level_size = std::max(1u, face_size >> level);
+		if (levels[level].size() != level_size * level_size * 4 * 6) {
+			return false;
+		}
+		images[level].push_back(std::as_bytes(std::span(levels[level])));
+	}
+
+	// VK_FORMAT_R16G16B16A16_SFLOAT
+	Ktx2_Header header{};
+	header.vk_format = 97;
+	header.type_size = 2;
+	header.pixel_width = face_size;
+	header.pixel_height = face_size;
+	header.face_count = 6;
+
+	return write_ktx2_file(path, header, half_float_descriptor(), key_values, images, 8);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "block_compression.h"
+#include "fs_util.h"
+
+// DDS and KTX2 files: textures whose mip chain (and block compression) was built ahead of time.
+//
+// A container is memory mapped and every level is handed to GL straight from the mapping. Nothing is decoded and no
+// mips are generated at load time. 2D, cube and 2D array textures are supported; 3D textures, cube map arrays and
+// supercompressed KTX2 files are rejected.
+namespace texture_container {
+
+struct Level {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	// one per array layer and cube face, layer major
+	std::vector<std::span<const std::byte>> images;
+};
+
+class Container {
+   public:
+	// GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP or GL_TEXTURE_2D_ARRAY
+	GLenum target = GL_TEXTURE_2D;
+	GLenum internal_format = 0;
+	// only used by uncompressed formats
+	GLenum format = 0;
+	GLenum type = 0;
+	bool compressed = false;
+	int num_chans = 0;
+	uint32_t layers = 1;
+	uint32_t faces = 1;
+	std::vector<Level> levels;
+	// a KTX2 file without a stored mip chain asks for one to be generated
+	bool generate_mips = false;
+
+	// returns nothing (and reports why) if the file isn't a container this loader understands
+	static std::optional<Container> open(const std::filesystem::path& path);
+
+	// the value stored under `key` in a KTX2 file's key/value data, if there is one
+	std::optional<std::string_view> find_value(std::string_view key) const;
+
+   private:
+	fs_util::Mapped_File m_file;
+	std::span<const std::byte> m_key_values;
+
+	bool parse_dds(const std::filesystem::path& path);
+	bool parse_ktx2(const std::filesystem::path& path);
+};
+
+// by file extension, so callers can skip the image decoder
+bool is_container(const std::filesystem::path& path);
+
+// generates and binds a texture for `container` with its filtering and level range set, but no images yet
+GLuint create(const Container& container);
+// specifies every image of `level` on the bound texture
+void upload_level(const Container& container, size_t level);
+// The same a slice at a time, for uploads that have to fit a frame budget: allocate_level() specifies the level's
+// images without data, and upload_rows() fills rows of one image (array layer or cube face) from `data`, which holds
+// them as they are in the file. Rows of compressed levels are rows of 4x4 blocks.
+void allocate_level(const Container& container, size_t level);
+void upload_rows(const Container& container,
+				 size_t level,
+				 size_t image,
+				 uint32_t first_row,
+				 uint32_t row_count,
+				 const void* data);
+// the number of rows of each image of `level`, and the bytes in one
+uint32_t row_count(const Container& container, size_t level);
+size_t row_size(const Container& container, size_t level);
+
+// Writes block-compressed mip chains as a KTX2 file, as a 2D texture for one image or a cube map for six. Every
+// image needs the same format and size. `key_values` end up in the file's key/value data.
+bool write_ktx2(const std::filesystem::path& path,
+				std::span<const block_compression::Compressed_Image> images,
+				std::span<const std::pair<std::string_view, std::string_view>> key_values = {});
+// Writes an RGBA16F cube map as a KTX2 file. Every one of `levels` (level 0 first, halving in size) holds the six
+// faces back to back in GL face order.
+bool write_ktx2_cubemap(const std::filesystem::path& path,
+						uint32_t face_size,
+						std::span<const std::vector<uint16_t>> levels,
+						std::span<const std::pair<std::string_view, std::string_view>> key_values = {});
+
+}
@@ -0,0 +1,192 @@
+#include <iostream>
+
+#include "bindless_textures.h"
+#include "config.h"
+#include "texture_registry.h"
+
+Texture_Registry::Texture_Registry(size_t budget_bytes) : m_budget_bytes(budget_bytes) {}
+
+Texture_Registry& Texture_Registry::shared() {
+	static Texture_Registry registry(constants::TEXTURE_BUDGET_MB * 1024 * 1024);
+	return registry;
+}
+
+Texture_Registry::Handle Texture_Registry::acquire(const std::filesystem::path& path) {
+	std::lock_guard lock(m_mutex);
+	auto it = m_handles.find(path);
+	if (it == m_handles.end()) {
+		return INVALID_HANDLE;
+	}
+
+	reference(m_entries[it->second]);
+	return it->second;
+}
+
+Texture_Registry::Handle Texture_Registry::add(const std::filesystem::path& path, const Texture& texture) {
+	std::lock_guard lock(m_mutex);
+	if (auto it = m_handles.find(path); it != m_handles.end()) {
+		glDeleteTextures(1, &texture.id);
+		reference(m_entries[it->second]);
+		return it->second;
+	}
+
+	Handle handle;
+	if (!m_free_handles.empty()) {
+		handle = m_free_handles.back();
+		m_free_handles.pop_back();
+	} else {
+		handle = static_cast<Handle>(m_entries.size());
+		m_entries.emplace_back();
+	}
+
+	Entry& entry = m_entries[handle];
+	entry.path = path;
+	entry.texture = texture;
+	entry.references = 1;
+	m_handles.emplace(path, handle);
+	m_resident_bytes += texture.memory_size;
+
+	evict_over_budget();
+	return handle;
+}
+
+Texture_Registry::Handle Texture_Registry::fallback() {
+	// not a path any file can have
+	static const std::filesystem::path FALLBACK_PATH = "<fallback>";
+	if (Handle handle = acquire(FALLBACK_PATH); handle != INVALID_HANDLE) {
+		return handle;
+	}
+
+	Texture texture;
+	texture.width = 1;
+	texture.height = 1;
+	texture.num_chans = 4;
+	texture.prebuilt_mips = true;
+	texture.memory_size = 4;
+
+	const unsigned char white[4] = {255, 255, 255, 255};
+	glGenTextures(1, &texture.id);
+	glBindTexture(GL_TEXTURE_2D, texture.id);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+
+	return add(FALLBACK_PATH, texture);
+}
+
+void Texture_Registry::retain(Handle handle) {
+	if (handle == INVALID_HANDLE) {
+		return;
+	}
+
+	std::lock_guard lock(m_mutex);
+	reference(m_entries[handle]);
+}
+
+void Texture_Registry::release(Handle handle) {
+	if (handle == INVALID_HANDLE) {
+		return;
+	}
+
+	std::lock_guard lock(m_mutex);
+	Entry& entry = m_entries[handle];
+	if (--entry.references == 0) {
+		entry.lru = m_unreferenced.insert(m_unreferenced.end(), handle);
+		evict_over_budget();
+	}
+}
+
+Texture Texture_Registry::get(Handle handle) const {
+	if (handle == INVALID_HANDLE) {
+		return {};
+	}
+
+	std::lock_guard lock(m_mutex);
+	return m_entries[handle].texture;
+}
+
+bool Texture_Registry::contains(const std::filesystem::path& path) const {
+	std::lock_guard lock(m_mutex);
+	return m_handles.contains(path);
+}
+
+void Texture_Registry::set_memory_size(Handle handle, GLuint texture, size_t memory_size) {
+	std::lock_guard lock(m_mutex);
+	Entry& entry = m_entries[handle];
+	if (entry.texture.id != texture) {
+		return;
+	}
+
+	m_resident_bytes = m_resident_bytes - entry.texture.memory_size + memory_size;
+	entry.texture.memory_size = memory_size;
+	evict_over_budget();
+}
+
+void Texture_Registry::set_budget(size_t budget_bytes) {
+	std::lock_guard lock(m_mutex);
+	m_budget_bytes = budget_bytes;
+	evict_over_budget();
+}
+
+Texture_Registry::Stats Texture_Registry::stats() const {
+	std::lock_guard lock(m_mutex);
+	return {m_handles.size(), m_unreferenced.size(), m_resident_bytes, m_budget_bytes, m_evictions};
+}
+
+void Texture_Registry::set_eviction_listener(std::function<void(Handle)> listener) {
+	std::lock_guard lock(m_mutex);
+	m_eviction_listener = std::move(listener);
+}
+
+void Texture_Registry::delete_evicted() {
+	std::vector<GLuint> evicted;
+	{
+		std::lock_guard lock(m_mutex);
+		if (m_evicted.empty()) {
+			return;
+		}
+		evicted.swap(m_evicted);
+	}
+
+	for (GLuint texture : evicted) {
+		Bindless_Textures::shared().release(texture);
+	}
+	glDeleteTextures(static_cast<GLsizei>(evicted.size()), evicted.data());
+}
+
+void Texture_Registry::evict_over_budget() {
+	size_t evicted_bytes = 0;
+	size_t evicted_count = 0;
+	while (m_resident_bytes > m_budget_bytes && !m_unreferenced.empty()) {
+		Handle handle = m_unreferenced.front();
+		m_unreferenced.pop_front();
+
+		Entry& entry = m_entries[handle];
+		m_evicted.push_back(entry.texture.id);
+		m_resident_bytes -= entry.texture.memory_size;
+		evicted_bytes += entry.texture.memory_size;
+		evicted_count++;
+
+		m_handles.erase(entry.path);
+		entry = {};
+		m_free_handles.push_back(handle);
+		if (m_eviction_listener) {
+			m_eviction_listener(handle);
+		}
+	}
+
+	m_evictions += evicted_count;
+	if constexpr (constants::DEBUG) {
+		if (evicted_count > 0) {
+			std::cout << "TEXTURE_REGISTRY evicted " << evicted_count << " textures (" << evicted_bytes / 1024
+					  << " KiB), " << m_resident_bytes / 1024 << " of " << m_budget_bytes / 1024 << " KiB resident"
+					  << std::endl;
+		}
+	}
+}
+
+void Texture_Registry::reference(Entry& entry) {
+	if (entry.references++ == 0) {
+		m_unreferenced.erase(entry.lru);
+	}
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "texture.h"
+
+// Owns every texture loaded from a file, keyed by path, and hands out small integer handles to them.
+//
+// Handles are reference counted. A texture nobody references stays resident so reloading it is free, until the
+// textures in VRAM exceed the budget; then the least recently released ones are evicted. Referenced textures are never
+// evicted, so the budget can be overshot while they alone exceed it.
+//
+// The bookkeeping is safe to use from any thread. GL objects are only created and deleted on the context thread:
+// add() takes a texture that was uploaded there, and evicted textures wait for delete_evicted().
+class Texture_Registry {
+   public:
+	using Handle = uint32_t;
+	static constexpr Handle INVALID_HANDLE = UINT32_MAX;
+
+	struct Stats {
+		size_t texture_count = 0;
+		// of which no handle is held
+		size_t unreferenced_count = 0;
+		size_t resident_bytes = 0;
+		size_t budget_bytes = 0;
+		uint64_t evictions = 0;
+	};
+
+	explicit Texture_Registry(size_t budget_bytes);
+	Texture_Registry(const Texture_Registry&) = delete;
+	Texture_Registry& operator=(const Texture_Registry&) = delete;
+	// leaves the GL objects to the context, which is gone by the time the shared registry is destroyed
+	~Texture_Registry() = default;
+
+	// the registry every model loads through, with a budget of constants::TEXTURE_BUDGET_MB
+	static Texture_Registry& shared();
+
+	// a new reference to the texture loaded from `path`, or INVALID_HANDLE if it isn't resident
+	Handle acquire(const std::filesystem::path& path);
+	// Takes ownership of `texture` and returns the first reference to it. If another load registered `path` in the
+	// meantime, `texture` is deleted and a reference to the existing one is returned instead. Context thread only.
+	Handle add(const std::filesystem::path& path, const Texture& texture);
+	// A reference to a shared 1x1 white texture, bound in place of textures that couldn't be loaded. Created on first
+	// use, and again if it was evicted. Context thread only.
+	Handle fallback();
+	// both ignore INVALID_HANDLE
+	void retain(Handle handle);
+	void release(Handle handle);
+
+	// a copy, only valid while a reference is held; an empty texture for INVALID_HANDLE
+	Texture get(Handle handle) const;
+	bool contains(const std::filesystem::path& path) const;
+
+	// for textures whose resident levels change after add(), see Texture_Streamer; ignored if `texture` was evicted
+	// from `handle` in the meantime
+	void set_memory_size(Handle handle, GLuint texture, size_t memory_size);
+	void set_budget(size_t budget_bytes);
+	Stats stats() const;
+
+	// Called with every evicted handle before it can be reused. It runs under the registry's lock, on whichever thread
+	// caused the eviction, so it must not call back into the registry.
+	void set_eviction_listener(std::function<void(Handle)> listener);
+
+	// frees the GL objects of evicted textures, call once per frame on the context thread
+	void delete_evicted();
+
+   private:
+	struct Entry {
+		std::filesystem::path path;
+		Texture texture;
+		uint32_t references = 0;
+		// position in m_unreferenced while references == 0
+		std::list<Handle>::iterator lru;
+	};
+
+	mutable std::mutex m_mutex;
+	// a deque so entries never move when more are added
+	std::deque<Entry> m_entries;
+	std::vector<Handle> m_free_handles;
+	std::unordered_map<std::filesystem::path, Handle> m_handles;
+	// unreferenced textures, least recently released first
+	std::list<Handle> m_unreferenced;
+	std::vector<GLuint> m_evicted;
+	std::function<void(Handle)> m_eviction_listener;
+	size_t m_resident_bytes = 0;
+	size_t m_budget_bytes;
+	uint64_t m_evictions = 0;
+
+	// both expect m_mutex to be held
+	void evict_over_budget();
+	void reference(Entry& entry);
+};
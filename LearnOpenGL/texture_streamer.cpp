@@ -0,0 +1,383 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <utility>
+
+#include "bindless_textures.h"
+#include "block_compression.h"
+#include "config.h"
+#include "texture_container.h"
+#include "texture_streamer.h"
+#include "thread_pool.h"
+#include "upload_queue.h"
+
+// keeps a single upload job well under a millisecond on typical hardware, like the model loader's slices
+static constexpr size_t UPLOAD_SLICE_BYTES = 1024 * 1024;
+
+namespace {
+
+// one level on its way to VRAM, copied out of its source
+struct Staged_Level {
+	bool compressed = true;
+	GLenum internal_format = 0;
+	GLenum format = 0;
+	GLenum type = 0;
+	GLint level = 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<std::byte> data;
+
+	// rows of 4x4 blocks for compressed levels, of texels otherwise
+	size_t row_count() const { return compressed ? block_compression::block_count(height) : height; }
+};
+
+// the first level no larger than RESIDENT_SIZE on either side, or the last one
+template <typename Levels>
+size_t first_level_within(const Levels& levels) {
+	for (size_t level = 0; level < levels.size(); level++) {
+		if (std::max(levels[level].width, levels[level].height) <= Texture_Streamer::RESIDENT_SIZE) {
+			return level;
+		}
+	}
+
+	return levels.size() - 1;
+}
+
+// cube maps and arrays aren't streamed, and neither is a chain the driver still has to generate
+bool is_streamable(const texture_container::Container& container) {
+	return container.target == GL_TEXTURE_2D && !container.generate_mips;
+}
+
+// specifies the level when the first slice arrives, the texture has to be bound
+void upload_slice(const Staged_Level& staged, size_t first_row, size_t row_count) {
+	GLsizei width = static_cast<GLsizei>(staged.width);
+	GLsizei height = static_cast<GLsizei>(staged.height);
+	size_t row_size = staged.data.size() / staged.row_count();
+	const std::byte* rows = staged.data.data() + first_row * row_size;
+	GLsizei size = static_cast<GLsizei>(row_count * row_size);
+
+	if (staged.compressed) {
+		if (first_row == 0) {
+			glCompressedTexImage2D(GL_TEXTURE_2D, staged.level, staged.internal_format, width, height, 0,
+								   static_cast<GLsizei>(staged.data.size()), nullptr);
+		}
+		// the last row of blocks may reach past the edge of the level, which the sub-image can't
+		GLint first_texel_row = static_cast<GLint>(first_row * 4);
+		GLsizei texel_rows = std::min(static_cast<GLsizei>(row_count * 4), height - first_texel_row);
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, staged.level, 0, first_texel_row, width, texel_rows,
+								  staged.internal_format, size, rows);
+		return;
+	}
+
+	// rows of tightly packed 1 and 3 byte texels aren't 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	if (first_row == 0) {
+		glTexImage2D(GL_TEXTURE_2D, staged.level, static_cast<GLint>(staged.internal_format), width, height, 0,
+					 staged.format, staged.type, nullptr);
+	}
+	glTexSubImage2D(GL_TEXTURE_2D, staged.level, 0, static_cast<GLint>(first_row), width,
+					static_cast<GLsizei>(row_count), staged.format, staged.type, rows);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+}  // namespace
+
+Texture_Streamer::Source Texture_Streamer::Source::from(texture_cache::Texture_Source&& source) {
+	Source result;
+	if (source.compressed) {
+		auto image = std::make_shared<const block_compression::Compressed_Image>(std::move(source.compressed));
+		result.internal_format = block_compression::gl_format(image->format);
+		for (size_t level = 0; level < image->levels.size(); level++) {
+			const block_compression::Mip_Level& mip = image->levels[level];
+			result.levels.push_back({mip.width, mip.height, image->level_data(level)});
+		}
+		result.owner = std::move(image);
+	} else if (source.container && is_streamable(*source.container)) {
+		auto container = std::make_shared<const texture_container::Container>(std::move(*source.container));
+		result.compressed = container->compressed;
+		result.internal_format = container->internal_format;
+		result.format = container->format;
+		result.type = container->type;
+		for (const texture_container::Level& level : container->levels) {
+			result.levels.push_back({level.width, level.height, level.images[0]});
+		}
+		result.owner = std::move(container);
+	}
+
+	return result;
+}
+
+size_t Texture_Streamer::Source::size(size_t first_level) const {
+	size_t size = 0;
+	for (size_t level = first_level; level < levels.size(); level++) {
+		size += levels[level].data.size();
+	}
+
+	return size;
+}
+
+Texture_Streamer::Texture_Streamer(Texture_Registry& registry, size_t budget_bytes)
+	: m_registry(registry), m_budget_bytes(budget_bytes) {
+	m_registry.set_eviction_listener([this](Handle handle) { forget(handle); });
+}
+
+Texture_Streamer::~Texture_Streamer() {
+	m_registry.set_eviction_listener(nullptr);
+}
+
+Texture_Streamer& Texture_Streamer::shared() {
+	static Texture_Streamer streamer(Texture_Registry::shared(), constants::TEXTURE_STREAM_BUDGET_MB * 1024 * 1024);
+	return streamer;
+}
+
+size_t Texture_Streamer::first_resident_level(const texture_cache::Texture_Source& source) {
+	if (source.compressed) {
+		return first_level_within(source.compressed.levels);
+	} else if (source.container && is_streamable(*source.container)) {
+		return first_level_within(source.container->levels);
+	}
+
+	return 0;
+}
+
+float Texture_Streamer::uv_per_pixel(const Bounding_Volume& bounds,
+									 const glm::vec3& center,
+									 float radius,
+									 const Render_View& view) {
+	// a camera inside the sphere always gets full detail
+	float distance = glm::length(center - view.position) - radius;
+	if (distance <= 0.0f) {
+		return 0.0f;
+	}
+
+	// a pixel spans distance / projection_scale world units, that over the mesh's scale in object units
+	float scale = bounds.sphere.radius > 0.0f ? radius / bounds.sphere.radius : 1.0f;
+	return bounds.uv_density * distance / (view.projection_scale * scale);
+}
+
+void Texture_Streamer::add(Handle handle, const Texture& texture, Source source) {
+	if (!source || handle == Texture_Registry::INVALID_HANDLE || m_registry.get(handle).id != texture.id) {
+		return;
+	}
+	size_t first_level = first_level_within(source.levels);
+	// a bindless handle froze the texture's base level
+	if (first_level == 0 || Bindless_Textures::shared().contains(texture.id)) {
+		return;
+	}
+
+	std::lock_guard lock(m_mutex);
+	auto [it, inserted] = m_textures.try_emplace(handle);
+	if (!inserted) {
+		return;
+	}
+
+	Streamed& streamed = it->second;
+	streamed.texture = texture.id;
+	streamed.serial = m_next_serial++;
+	streamed.source = std::move(source);
+	streamed.max_base_level = static_cast<uint32_t>(first_level);
+	streamed.base_level = streamed.max_base_level;
+	streamed.wanted_level = streamed.max_base_level;
+}
+
+bool Texture_Streamer::contains(Handle handle) const {
+	std::lock_guard lock(m_mutex);
+	return m_textures.contains(handle);
+}
+
+void Texture_Streamer::request(Handle handle, float uv_per_pixel) {
+	std::lock_guard lock(m_mutex);
+	auto it = m_textures.find(handle);
+	if (it == m_textures.end()) {
+		return;
+	}
+
+	Streamed& streamed = it->second;
+	if (streamed.last_requested != m_frame) {
+		streamed.last_requested = m_frame;
+		streamed.uv_per_pixel = uv_per_pixel;
+	} else {
+		streamed.uv_per_pixel = std::min(streamed.uv_per_pixel, uv_per_pixel);
+	}
+}
+
+void Texture_Streamer::update() {
+	std::vector<Memory_Update> updates;
+	{
+		std::lock_guard lock(m_mutex);
+
+		// the level each texture needs this frame: the one sampled where a texel covers about a pixel, or only the
+		// resident levels if it wasn't drawn
+		std::vector<std::pair<uint32_t, Handle>> missing;
+		for (auto& [handle, streamed] : m_textures) {
+			streamed.wanted_level = streamed.max_base_level;
+			if (streamed.last_requested == m_frame) {
+				const Level& top = streamed.source.levels[0];
+				float texels_per_pixel = streamed.uv_per_pixel * static_cast<float>(std::max(top.width, top.height));
+				streamed.wanted_level =
+					texels_per_pixel > 1.0f
+						? std::min(streamed.max_base_level, static_cast<uint32_t>(std::log2(texels_per_pixel)))
+						: 0;
+			}
+			if (!streamed.loading && streamed.wanted_level < streamed.base_level) {
+				missing.emplace_back(streamed.base_level - streamed.wanted_level, handle);
+			}
+		}
+
+		// a lowered budget is only enforced from here on
+		make_room(0, updates);
+
+		// the textures furthest from what they need go first, each moves one level closer per load
+		std::sort(missing.begin(), missing.end(), std::greater<>());
+		for (const auto& [shortfall, handle] : missing) {
+			if (m_loads_in_flight >= MAX_LOADS_IN_FLIGHT) {
+				break;
+			}
+
+			Streamed& streamed = m_textures.find(handle)->second;
+			if (make_room(streamed.source.levels[streamed.base_level - 1].data.size(), updates)) {
+				load_level(handle, streamed);
+			}
+		}
+
+		m_frame++;
+	}
+
+	apply(updates);
+}
+
+void Texture_Streamer::set_budget(size_t budget_bytes) {
+	std::lock_guard lock(m_mutex);
+	m_budget_bytes = budget_bytes;
+}
+
+Texture_Streamer::Stats Texture_Streamer::stats() const {
+	std::lock_guard lock(m_mutex);
+	return {m_textures.size(), m_streamed_bytes, m_budget_bytes, m_loads_in_flight, m_levels_loaded, m_levels_dropped};
+}
+
+void Texture_Streamer::forget(Handle handle) {
+	std::lock_guard lock(m_mutex);
+	auto it = m_textures.find(handle);
+	if (it == m_textures.end()) {
+		return;
+	}
+
+	// a level still on its way was counted as well, its upload jobs won't find the texture anymore
+	const Streamed& streamed = it->second;
+	uint32_t first_counted = streamed.loading ? streamed.base_level - 1 : streamed.base_level;
+	m_streamed_bytes -= streamed.source.size(first_counted) - streamed.source.size(streamed.max_base_level);
+	if (streamed.loading) {
+		m_loads_in_flight--;
+	}
+
+	m_textures.erase(it);
+}
+
+bool Texture_Streamer::make_room(size_t size, std::vector<Memory_Update>& updates) {
+	while (m_streamed_bytes + size > m_budget_bytes) {
+		// the finest level of whichever texture with levels to spare was drawn longest ago
+		Handle victim_handle = Texture_Registry::INVALID_HANDLE;
+		Streamed* victim = nullptr;
+		for (auto& [handle, streamed] : m_textures) {
+			if (!streamed.loading && streamed.base_level < streamed.wanted_level &&
+				(!victim || streamed.last_requested < victim->last_requested)) {
+				victim_handle = handle;
+				victim = &streamed;
+			}
+		}
+		if (!victim) {
+			return false;
+		}
+
+		drop_finest_level(victim_handle, *victim, updates);
+	}
+
+	return true;
+}
+
+void Texture_Streamer::drop_finest_level(Handle handle, Streamed& streamed, std::vector<Memory_Update>& updates) {
+	GLint level = static_cast<GLint>(streamed.base_level);
+	const Source& source = streamed.source;
+	glBindTexture(GL_TEXTURE_2D, streamed.texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1);
+	// respecifying the level as empty is what lets the driver free it
+	if (source.compressed) {
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, source.internal_format, 0, 0, 0, 0, nullptr);
+	} else {
+		glTexImage2D(GL_TEXTURE_2D, level, static_cast<GLint>(source.internal_format), 0, 0, 0, source.format,
+					 source.type, nullptr);
+	}
+
+	m_streamed_bytes -= source.levels[streamed.base_level].data.size();
+	m_levels_dropped++;
+	streamed.base_level++;
+	updates.push_back({handle, streamed.texture, source.size(streamed.base_level)});
+}
+
+void Texture_Streamer::load_level(Handle handle, Streamed& streamed) {
+	uint32_t level = streamed.base_level - 1;
+	streamed.loading = true;
+	m_streamed_bytes += streamed.source.levels[level].data.size();
+	m_loads_in_flight++;
+
+	// copying the level out of its mapping faults the pages in, which is why it happens on the pool
+	Thread_Pool::shared().submit([this, handle, serial = streamed.serial, source = streamed.source, level]() {
+		auto staged = std::make_shared<Staged_Level>();
+		const Level& mip = source.levels[level];
+		staged->compressed = source.compressed;
+		staged->internal_format = source.internal_format;
+		staged->format = source.format;
+		staged->type = source.type;
+		staged->level = static_cast<GLint>(level);
+		staged->width = mip.width;
+		staged->height = mip.height;
+		staged->data.assign(mip.data.begin(), mip.data.end());
+
+		Upload_Queue& queue = Upload_Queue::shared();
+		size_t rows = staged->row_count();
+		size_t rows_per_slice = std::max<size_t>(1, UPLOAD_SLICE_BYTES / (staged->data.size() / rows));
+		for (size_t first_row = 0; first_row < rows; first_row += rows_per_slice) {
+			size_t row_count = std::min(rows_per_slice, rows - first_row);
+			queue.push([this, handle, serial, staged, first_row, row_count]() {
+				std::lock_guard lock(m_mutex);
+				if (Streamed* streamed = find(handle, serial)) {
+					glBindTexture(GL_TEXTURE_2D, streamed->texture);
+					upload_slice(*staged, first_row, row_count);
+				}
+			});
+		}
+
+		// only now that the level is complete can sampling reach it
+		queue.push([this, handle, serial, level]() {
+			Memory_Update update;
+			{
+				std::lock_guard lock(m_mutex);
+				Streamed* streamed = find(handle, serial);
+				if (!streamed) {
+					return;
+				}
+
+				glBindTexture(GL_TEXTURE_2D, streamed->texture);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(level));
+				streamed->base_level = level;
+				streamed->loading = false;
+				m_loads_in_flight--;
+				m_levels_loaded++;
+				update = {handle, streamed->texture, streamed->source.size(level)};
+			}
+			apply({&update, 1});
+		});
+	});
+}
+
+Texture_Streamer::Streamed* Texture_Streamer::find(Handle handle, uint64_t serial) {
+	auto it = m_textures.find(handle);
+	return it != m_textures.end() && it->second.serial == serial ? &it->second : nullptr;
+}
+
+void Texture_Streamer::apply(std::span<const Memory_Update> updates) {
+	for (const Memory_Update& update : updates) {
+		m_registry.set_memory_size(update.handle, update.texture, update.memory_size);
+	}
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+#include "camera.h"
+#include "texture.h"
+#include "texture_cache.h"
+#include "texture_registry.h"
+
+// Keeps only the mip levels of a texture that the view actually needs in VRAM.
+//
+// A streamed texture is uploaded with its small levels only, those no larger than RESIDENT_SIZE, and
+// GL_TEXTURE_BASE_LEVEL clamped to the finest of them. Draws report how many texture coordinate units a pixel spans
+// on each mesh they drew (request()); once a frame, update() turns the finest request into the level a texture needs
+// and streams the next finer level in where it is missing. Levels are copied out of the source's mapping on the
+// thread pool and uploaded through the Upload_Queue in slices, so a frame never waits on them.
+//
+// Everything finer than the resident levels shares one budget. Levels are only dropped to make room: first from
+// textures drawn longest ago, and never ones a texture needs this frame. A texture that doesn't fit stays blurrier
+// until room frees up.
+//
+// Block-compressed images and 2D containers with a stored mip chain are streamed. Plain images aren't: there is no
+// copy of their levels on disk to stream from.
+class Texture_Streamer {
+   public:
+	using Handle = Texture_Registry::Handle;
+
+	// levels no larger than this on either side are uploaded with the texture and stay until it is evicted
+	static constexpr uint32_t RESIDENT_SIZE = 128;
+	// levels being copied or uploaded at once, which bounds the staging memory
+	static constexpr size_t MAX_LOADS_IN_FLIGHT = 4;
+
+	struct Level {
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::span<const std::byte> data;
+	};
+
+	// a streamed texture's whole mip chain in system memory, usually a file mapping that `owner` keeps alive
+	struct Source {
+		std::shared_ptr<const void> owner;
+		bool compressed = true;
+		GLenum internal_format = 0;
+		// only used by uncompressed formats
+		GLenum format = 0;
+		GLenum type = 0;
+		std::vector<Level> levels;
+
+		// takes over the compressed image or container of `source`, empty for anything that can't be streamed
+		static Source from(texture_cache::Texture_Source&& source);
+		explicit operator bool() const { return !levels.empty(); }
+		// the size of every level from `first_level` down
+		size_t size(size_t first_level) const;
+	};
+
+	struct Stats {
+		size_t texture_count = 0;
+		// levels finer than the resident ones, including those still being uploaded
+		size_t streamed_bytes = 0;
+		size_t budget_bytes = 0;
+		size_t loads_in_flight = 0;
+		uint64_t levels_loaded = 0;
+		uint64_t levels_dropped = 0;
+	};
+
+	// listens for evictions from `registry`, which has to outlive the streamer
+	Texture_Streamer(Texture_Registry& registry, size_t budget_bytes);
+	Texture_Streamer(const Texture_Streamer&) = delete;
+	Texture_Streamer& operator=(const Texture_Streamer&) = delete;
+	~Texture_Streamer();
+
+	// the streamer for the shared Texture_Registry, with a budget of constants::TEXTURE_STREAM_BUDGET_MB
+	static Texture_Streamer& shared();
+
+	// the level to upload `source` from so the streamer can take over, 0 if it isn't streamed
+	static size_t first_resident_level(const texture_cache::Texture_Source& source);
+	// Texture coordinate units per pixel on a mesh with object-space `bounds`, whose bounding sphere is placed at
+	// `center` with `radius` in the world. Measured at the closest point of the sphere, so it errs on the sharp side.
+	static float uv_per_pixel(const Bounding_Volume& bounds,
+							  const glm::vec3& center,
+							  float radius,
+							  const Render_View& view);
+
+	// Starts streaming the texture at `handle`, which was uploaded from first_resident_level() down. Does nothing if
+	// the registry handed out another texture for the same path instead. Context thread only.
+	void add(Handle handle, const Texture& texture, Source source);
+	// whether the texture at `handle` is streamed, which rules out anything that needs its levels to stay put
+	bool contains(Handle handle) const;
+	// a mesh using the texture is drawn where a pixel spans `uv_per_pixel` units, 0 asks for full detail; the finest
+	// request of a frame wins and anything that isn't streamed is ignored
+	void request(Handle handle, float uv_per_pixel);
+	// turns this frame's requests into loads, call once per frame on the context thread
+	void update();
+
+	void set_budget(size_t budget_bytes);
+	Stats stats() const;
+
+   private:
+	struct Streamed {
+		GLuint texture = 0;
+		// tells this texture apart from a later one at the same handle, for loads that outlive an eviction
+		uint64_t serial = 0;
+		Source source;
+		// GL_TEXTURE_BASE_LEVEL never goes above this, the levels from here down stay resident
+		uint32_t max_base_level = 0;
+		// the finest level resident
+		uint32_t base_level = 0;
+		// the finest level this frame's requests need, and the frame the texture was last requested in
+		uint32_t wanted_level = 0;
+		uint64_t last_requested = 0;
+		float uv_per_pixel = 0.0f;
+		bool loading = false;
+	};
+
+	// a resident size for the registry, passed on once m_mutex is released
+	struct Memory_Update {
+		Handle handle;
+		GLuint texture;
+		size_t memory_size;
+	};
+
+	Texture_Registry& m_registry;
+	mutable std::mutex m_mutex;
+	std::unordered_map<Handle, Streamed> m_textures;
+	uint64_t m_frame = 1;
+	uint64_t m_next_serial = 1;
+	size_t m_streamed_bytes = 0;
+	size_t m_budget_bytes;
+	size_t m_loads_in_flight = 0;
+	uint64_t m_levels_loaded = 0;
+	uint64_t m_levels_dropped = 0;
+
+	void forget(Handle handle);
+	// these expect m_mutex to be held
+	bool make_room(size_t size, std::vector<Memory_Update>& updates);
+	void drop_finest_level(Handle handle, Streamed& streamed, std::vector<Memory_Update>& updates);
+	void load_level(Handle handle, Streamed& streamed);
+	// the streamed texture at `handle` if it is still the one a load started for
+	Streamed* find(Handle handle, uint64_t serial);
+	void apply(std::span<const Memory_Update> updates);
+};
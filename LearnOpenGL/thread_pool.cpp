@@ -0,0 +1,63 @@
+#include <algorithm>
+
+#include "thread_pool.h"
+
+Thread_Pool::Thread_Pool(size_t thread_count) {
+	m_workers.reserve(thread_count);
+	for (size_t i = 0; i < thread_count; i++) {
+		m_workers.emplace_back([this]() { worker_loop(); });
+	}
+}
+
+Thread_Pool::~Thread_Pool() {
+	{
+		std::lock_guard lock(m_mutex);
+		m_stopping = true;
+	}
+	m_task_available.notify_all();
+
+	for (std::thread& worker : m_workers) {
+		worker.join();
+	}
+}
+
+static size_t& shared_thread_count() {
+	// leave one core for the render thread
+	static size_t thread_count = std::max(2u, std::thread::hardware_concurrency()) - 1;
+	return thread_count;
+}
+
+Thread_Pool& Thread_Pool::shared() {
+	static Thread_Pool pool(shared_thread_count());
+	return pool;
+}
+
+void Thread_Pool::set_shared_thread_count(size_t thread_count) {
+	shared_thread_count() = std::max<size_t>(1, thread_count);
+}
+
+void Thread_Pool::enqueue(std::function<void()> task) {
+	{
+		std::lock_guard lock(m_mutex);
+		m_tasks.push(std::move(task));
+	}
+	m_task_available.notify_one();
+}
+
+void Thread_Pool::worker_loop() {
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock lock(m_mutex);
+			m_task_available.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+			if (m_stopping && m_tasks.empty()) {
+				return;
+			}
+
+			task = std::move(m_tasks.front());
+			m_tasks.pop();
+		}
+
+		task();
+	}
+}
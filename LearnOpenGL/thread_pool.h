@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// fixed-size pool of worker threads for CPU-side loading work; never touches GL
+class Thread_Pool {
+   public:
+	explicit Thread_Pool(size_t thread_count);
+	Thread_Pool(const Thread_Pool&) = delete;
+	Thread_Pool& operator=(const Thread_Pool&) = delete;
+	~Thread_Pool();
+
+	// pool shared by all loaders, sized to the machine unless set_shared_thread_count() came first
+	static Thread_Pool& shared();
+	// only has an effect before the first call to shared(). Clamped to at least one worker: submit() only queues, and
+	// running its tasks on the calling thread instead could block the context thread on a full Upload_Queue.
+	static void set_shared_thread_count(size_t thread_count);
+
+	size_t thread_count() const { return m_workers.size(); }
+
+	template <typename F>
+	std::future<std::invoke_result_t<F>> submit(F&& task) {
+		using Result = std::invoke_result_t<F>;
+		auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+		std::future<Result> result = packaged->get_future();
+		enqueue([packaged]() { (*packaged)(); });
+		return result;
+	}
+
+	// calls body(i) for every i in [0, count) and returns once all of them are done. The calling thread takes part in
+	// the work, so this is safe to call from inside a pool task.
+	template <typename F>
+	void parallel_for(size_t count, F&& body) {
+		if (count == 0) {
+			return;
+		}
+
+		struct State {
+			std::atomic<size_t> next = 0;
+			std::atomic<size_t> done = 0;
+			std::mutex mutex;
+			std::condition_variable finished;
+		};
+		auto state = std::make_shared<State>();
+		auto run = [state, count, &body]() {
+			size_t i;
+			while ((i = state->next.fetch_add(1)) < count) {
+				body(i);
+				if (state->done.fetch_add(1) + 1 == count) {
+					std::lock_guard lock(state->mutex);
+					state->finished.notify_all();
+				}
+			}
+		};
+
+		size_t helpers = std::min(count - 1, thread_count());
+		for (size_t i = 0; i < helpers; i++) {
+			// helpers that start after the work ran out return without touching `body`
+			enqueue([state, count, run]() {
+				if (state->next.load() < count) {
+					run();
+				}
+			});
+		}
+		run();
+
+		std::unique_lock lock(state->mutex);
+		state->finished.wait(lock, [&]() { return state->done.load() == count; });
+	}
+
+   private:
+	std::vector<std::thread> m_workers;
+	std::queue<std::function<void()>> m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_task_available;
+	bool m_stopping = false;
+
+	void enqueue(std::function<void()> task);
+	void worker_loop();
+};
@@ -0,0 +1,46 @@
+#include "upload_queue.h"
+
+static constexpr size_t SHARED_QUEUE_CAPACITY = 256;
+
+Upload_Queue::Upload_Queue(size_t capacity) : m_capacity(capacity) {}
+
+Upload_Queue& Upload_Queue::shared() {
+	static Upload_Queue queue(SHARED_QUEUE_CAPACITY);
+	return queue;
+}
+
+void Upload_Queue::push(std::function<void()> job) {
+	std::unique_lock lock(m_mutex);
+	m_space_available.wait(lock, [this]() { return m_jobs.size() < m_capacity; });
+	m_jobs.push_back(std::move(job));
+}
+
+size_t Upload_Queue::drain(std::chrono::duration<double, std::milli> budget) {
+	using Clock = std::chrono::steady_clock;
+	auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(budget);
+
+	size_t jobs_run = 0;
+	while (Clock::now() < deadline) {
+		std::function<void()> job;
+		{
+			std::lock_guard lock(m_mutex);
+			if (m_jobs.empty()) {
+				break;
+			}
+
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+		}
+		m_space_available.notify_one();
+
+		job();
+		jobs_run++;
+	}
+
+	return jobs_run;
+}
+
+size_t Upload_Queue::size() const {
+	std::lock_guard lock(m_mutex);
+	return m_jobs.size();
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// Bounded queue of GL work produced by loader threads and run on the context thread under a per-frame time budget.
+//
+// Producers block while the queue is full, which keeps decoded-but-not-uploaded data from piling up in memory when
+// loading outpaces the budget. Jobs should be small enough that a single one never blows the frame budget on its
+// own, e.g. one slice of a texture rather than the whole image.
+class Upload_Queue {
+   public:
+	explicit Upload_Queue(size_t capacity);
+
+	static Upload_Queue& shared();
+
+	// blocks while the queue is full, so it must never be called from the context thread
+	void push(std::function<void()> job);
+
+	// runs queued jobs on the calling (context) thread until the queue is empty or `budget` is used up, returns the
+	// number of jobs run
+	size_t drain(std::chrono::duration<double, std::milli> budget);
+
+	size_t size() const;
+
+   private:
+	size_t m_capacity;
+	std::deque<std::function<void()>> m_jobs;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_space_available;
+};
@@ -0,0 +1,102 @@
+#include <cmath>
+
+#include <glm/gtc/packing.hpp>
+
+#include "vertex_format.h"
+
+namespace {
+
+// maps a unit vector onto the octahedron and unfolds it into [-1, 1]^2
+glm::vec2 encode_octahedral(glm::vec3 normal) {
+	float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+	if (length == 0.0f) {
+		return glm::vec2(0.0f);
+	}
+
+	normal /= length;
+	glm::vec2 encoded(normal.x, normal.y);
+	if (normal.z < 0.0f) {
+		glm::vec2 sign(encoded.x >= 0.0f ? 1.0f : -1.0f, encoded.y >= 0.0f ? 1.0f : -1.0f);
+		encoded = (1.0f - glm::abs(glm::vec2(encoded.y, encoded.x))) * sign;
+	}
+
+	return encoded;
+}
+
+}
+
+size_t vertex_format::stride(Vertex_Format format) {
+	return format == Vertex_Format::packed ? sizeof(Packed_Vertex) : sizeof(Vertex);
+}
+
+Quantization_Bounds vertex_format::calculate_bounds(std::span<const Vertex> vertices) {
+	Quantization_Bounds bounds;
+	if (vertices.empty()) {
+		return bounds;
+	}
+
+	glm::vec3 min = vertices[0].position;
+	glm::vec3 max = vertices[0].position;
+	for (const Vertex& vertex : vertices) {
+		min = glm::min(min, vertex.position);
+		max = glm::max(max, vertex.position);
+	}
+
+	bounds.min = min;
+	bounds.extent = max - min;
+	return bounds;
+}
+
+std::vector<Packed_Vertex> vertex_format::pack(std::span<const Vertex> vertices, const Quantization_Bounds& bounds) {
+	// a flat axis quantizes everything to 0, which decodes back to bounds.min
+	glm::vec3 inverse_extent(bounds.extent.x > 0.0f ? 1.0f / bounds.extent.x : 0.0f,
+							 bounds.extent.y > 0.0f ? 1.0f / bounds.extent.y : 0.0f,
+							 bounds.extent.z > 0.0f ? 1.0f / bounds.extent.z : 0.0f);
+
+	std::vector<Packed_Vertex> packed(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++) {
+		const Vertex& vertex = vertices[i];
+		Packed_Vertex& out = packed[i];
+
+		glm::vec3 position = (vertex.position - bounds.min) * inverse_extent;
+		out.position[0] = glm::packUnorm1x16(position.x);
+		out.position[1] = glm::packUnorm1x16(position.y);
+		out.position[2] = glm::packUnorm1x16(position.z);
+		out.position[3] = 0;
+
+		glm::vec2 normal = encode_octahedral(vertex.normal);
+		out.normal[0] = static_cast<int16_t>(glm::packSnorm1x16(normal.x));
+		out.normal[1] = static_cast<int16_t>(glm::packSnorm1x16(normal.y));
+
+		out.tex_coords[0] = glm::packHalf1x16(vertex.tex_coords.x);
+		out.tex_coords[1] = glm::packHalf1x16(vertex.tex_coords.y);
+	}
+
+	return packed;
+}
+
+void vertex_format::setup_attributes(Vertex_Format format) {
+	if (format == Vertex_Format::packed) {
+		GLsizei stride = sizeof(Packed_Vertex);
+		// vertex positions
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offsetof(Packed_Vertex, position));
+		// vertex normals
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void*)offsetof(Packed_Vertex, normal));
+		// vertex texture coords
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(Packed_Vertex, tex_coords));
+		return;
+	}
+
+	// vertex positions
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+	// vertex normals
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+	// vertex texture coords
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tex_coords));
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+struct Vertex {
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 tex_coords;
+};
+
+// Quantized vertex at half the size of Vertex, decoded in shaders/model_packed.vert:
+// positions are unorm16 within the mesh's bounds, normals are octahedral encoded snorm16, uvs are half floats.
+struct Packed_Vertex {
+	uint16_t position[4];  // w is padding
+	int16_t normal[2];
+	uint16_t tex_coords[2];
+};
+static_assert(sizeof(Packed_Vertex) * 2 == sizeof(Vertex));
+
+enum class Vertex_Format {
+	full,
+	packed,
+};
+
+// the box packed positions are quantized to
+struct Quantization_Bounds {
+	glm::vec3 min = glm::vec3(0.0f);
+	glm::vec3 extent = glm::vec3(0.0f);
+};
+
+namespace vertex_format {
+
+size_t stride(Vertex_Format format);
+
+Quantization_Bounds calculate_bounds(std::span<const Vertex> vertices);
+std::vector<Packed_Vertex> pack(std::span<const Vertex> vertices, const Quantization_Bounds& bounds);
+
+// sets up attributes 0-2 (position, normal, uv) of the currently bound VAO for the buffer bound to GL_ARRAY_BUFFER
+void setup_attributes(Vertex_Format format);
+
+}
@@ -0,0 +1,54 @@
+#version 430 core
+#extension GL_ARB_bindless_texture : enable
+#extension GL_NV_gpu_shader5 : enable
+
+// fragment shader for Indirect_Draw_List, samples the diffuse texture through its bindless handle where there is one,
+// else out of the Texture_Atlas where it was packed
+out vec4 FragColor;
+
+in vec3 Normal;
+in vec3 Position;
+in vec2 TexCoords;
+flat in uint DiffuseLayer;
+flat in uvec2 DiffuseHandle;
+flat in vec4 DiffuseUvTransform;
+
+struct Material {
+    sampler2D texture_diffuse1;
+    sampler2DArray texture_diffuse_array;
+};
+
+uniform Material material;
+
+#if defined(GL_ARB_bindless_texture) && !defined(GL_NV_gpu_shader5)
+// the handle per draw isn't dynamically uniform, so bindless draws come batched by handle and it is set here instead
+layout(bindless_sampler) uniform sampler2D batchDiffuse;
+#endif
+
+const uint NO_LAYER = 0xffffffffu;
+
+vec4 sampleDiffuse() {
+#ifdef GL_ARB_bindless_texture
+    if (DiffuseHandle != uvec2(0)) {
+#ifdef GL_NV_gpu_shader5
+        return texture(sampler2D(DiffuseHandle), TexCoords);
+#else
+        return texture(batchDiffuse, TexCoords);
+#endif
+    }
+#endif
+    if (DiffuseLayer == NO_LAYER) {
+        return texture(material.texture_diffuse1, TexCoords);
+    }
+
+    // fract() stands in for GL_REPEAT inside the cell, the gradients of the unwrapped uv keep the mip level from
+    // jumping at the seam
+    vec2 scale = DiffuseUvTransform.zw;
+    vec2 uv = DiffuseUvTransform.xy + fract(TexCoords) * scale;
+    return textureGrad(material.texture_diffuse_array, vec3(uv, float(DiffuseLayer)), dFdx(TexCoords) * scale,
+                       dFdy(TexCoords) * scale);
+}
+
+void main() {
+    FragColor = vec4(sampleDiffuse().rgb, 1.0);
+}
@@ -0,0 +1,60 @@
+#version 430 core
+
+// vertex shader for Indirect_Draw_List, handles both full and packed vertices (see vertex_format.h)
+layout (location = 0) in vec3 aPos;       // unorm16 relative to the mesh bounds when packed
+layout (location = 1) in vec3 aNormal;    // octahedral in .xy when packed
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in uint aDrawId;    // per-draw, fed from the command's baseInstance
+
+struct DrawData {
+    mat4 model;
+    vec4 boundsMin;
+    vec4 boundsExtent;
+    uint diffuseLayer;        // 0xffffffff when the diffuse texture isn't in the atlas
+    uint padding;
+    uvec2 diffuseHandle;      // bindless handle, 0 when the texture is in the atlas or bound
+    vec4 diffuseUvTransform;  // offset in .xy, scale in .zw
+};
+
+layout (std430, binding = 0) readonly buffer DrawDataBuffer {
+    DrawData draws[];
+};
+
+out vec3 Normal;
+out vec3 Position;
+out vec2 TexCoords;
+flat out uint DiffuseLayer;
+flat out uvec2 DiffuseHandle;
+flat out vec4 DiffuseUvTransform;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform bool packedVertices;
+
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) {
+        vec2 s = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+        n.xy = (1.0 - abs(n.yx)) * s;
+    }
+    return normalize(n);
+}
+
+void main() {
+    DrawData draw = draws[aDrawId];
+
+    vec3 localPos = aPos;
+    vec3 localNormal = aNormal;
+    if (packedVertices) {
+        localPos = draw.boundsMin.xyz + aPos * draw.boundsExtent.xyz;
+        localNormal = decodeOctahedral(aNormal.xy);
+    }
+
+    Normal = mat3(transpose(inverse(draw.model))) * localNormal;
+    Position = vec3(draw.model * vec4(localPos, 1.0));
+    TexCoords = aTexCoords;
+    DiffuseLayer = draw.diffuseLayer;
+    DiffuseHandle = draw.diffuseHandle;
+    DiffuseUvTransform = draw.diffuseUvTransform;
+    gl_Position = projection * view * vec4(Position, 1.0);
+}
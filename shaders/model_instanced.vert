@@ -0,0 +1,44 @@
+#version 330 core
+
+// vertex shader for Model::draw_instanced, handles both full and packed vertices (see vertex_format.h)
+layout (location = 0) in vec3 aPos;       // unorm16 relative to the mesh bounds when packed
+layout (location = 1) in vec3 aNormal;    // octahedral in .xy when packed
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 4) in mat4 aInstanceModel;  // per-instance, see instance_buffer.h
+layout (location = 8) in mat3 aInstanceNormal;
+
+out vec3 Normal;
+out vec3 Position;
+out vec2 TexCoords;
+
+// the mesh's node transform, the instance transform is applied on top of it
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+uniform bool packedVertices;
+uniform vec3 meshBoundsMin;
+uniform vec3 meshBoundsExtent;
+
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) {
+        vec2 s = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+        n.xy = (1.0 - abs(n.yx)) * s;
+    }
+    return normalize(n);
+}
+
+void main() {
+    vec3 localPos = aPos;
+    vec3 localNormal = aNormal;
+    if (packedVertices) {
+        localPos = meshBoundsMin + aPos * meshBoundsExtent;
+        localNormal = decodeOctahedral(aNormal.xy);
+    }
+
+    Normal = aInstanceNormal * (mat3(transpose(inverse(model))) * localNormal);
+    Position = vec3(aInstanceModel * model * vec4(localPos, 1.0));
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * vec4(Position, 1.0);
+}
@@ -0,0 +1,35 @@
+#version 330 core
+
+// decodes Packed_Vertex, see vertex_format.h
+layout (location = 0) in vec3 aPos;       // unorm16, relative to the mesh bounds
+layout (location = 1) in vec2 aNormal;    // octahedral, snorm16
+layout (location = 2) in vec2 aTexCoords; // half float
+
+out vec3 Normal;
+out vec3 Position;
+out vec2 TexCoords;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+uniform vec3 meshBoundsMin;
+uniform vec3 meshBoundsExtent;
+
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) {
+        vec2 s = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+        n.xy = (1.0 - abs(n.yx)) * s;
+    }
+    return normalize(n);
+}
+
+void main() {
+    vec3 localPos = meshBoundsMin + aPos * meshBoundsExtent;
+
+    Normal = mat3(transpose(inverse(model))) * decodeOctahedral(aNormal);
+    Position = vec3(model * vec4(localPos, 1.0));
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * vec4(Position, 1.0);
+}
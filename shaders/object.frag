@@ -1,4 +1,5 @@
 #version 330 core
+#extension GL_ARB_bindless_texture : enable
 
 out vec4 FragColor;
 
@@ -6,11 +7,43 @@ in vec3 Normal;
 in vec3 Position;
 
 uniform vec3 cameraPos;
+// frosted glass, 0 refracts a sharp image and 1 scatters the light evenly
+uniform float roughness;
+// the skybox's prefiltered level for roughness 1, see environment_map.h
+uniform float maxLod;
+// the skybox's irradiance as spherical harmonics coefficients, in the order of environment_map::Irradiance
+uniform vec3 irradianceSH[9];
+// above 0 the skybox is HDR radiance and gets tone mapped, at 0 it is passed through as it is
+uniform float exposure;
+// set once through a bindless handle where supported, see Bindless_Textures
+#ifdef GL_ARB_bindless_texture
+layout(bindless_sampler) uniform samplerCube skybox;
+#else
 uniform samplerCube skybox;
+#endif
+
+vec3 irradiance(vec3 n) {
+    return irradianceSH[0] * 0.282095
+         + irradianceSH[1] * 0.488603 * n.y
+         + irradianceSH[2] * 0.488603 * n.z
+         + irradianceSH[3] * 0.488603 * n.x
+         + irradianceSH[4] * 1.092548 * n.x * n.y
+         + irradianceSH[5] * 1.092548 * n.y * n.z
+         + irradianceSH[6] * 0.315392 * (3.0 * n.z * n.z - 1.0)
+         + irradianceSH[7] * 1.092548 * n.x * n.z
+         + irradianceSH[8] * 0.546274 * (n.x * n.x - n.y * n.y);
+}
+
+vec3 toneMap(vec3 color) {
+    return exposure > 0.0 ? vec3(1.0) - exp(-color * exposure) : color;
+}
 
 void main() {
     float ratio = 1.00 / 1.52;
     vec3 I = normalize(Position - cameraPos);
     vec3 R = refract(I, normalize(Normal), ratio);
-    FragColor = vec4(texture(skybox, R).rgb, 1.0);
-}
\ No newline at end of file
+    vec3 transmitted = textureLod(skybox, R, roughness * maxLod).rgb;
+    // fully scattered, the light leaving along R is the cosine weighted average around it
+    vec3 scattered = max(irradiance(R), vec3(0.0)) / 3.14159265;
+    FragColor = vec4(toneMap(mix(transmitted, scattered, roughness * roughness)), 1.0);
+}
@@ -1,11 +1,22 @@
 #version 330 core
+#extension GL_ARB_bindless_texture : enable
 
 out vec4 FragColor;
 
 in vec3 TexCoords;
 
+// set once through a bindless handle where supported, see Bindless_Textures
+#ifdef GL_ARB_bindless_texture
+layout(bindless_sampler) uniform samplerCube skybox;
+#else
 uniform samplerCube skybox;
+#endif
+// see object.frag
+uniform float exposure;
 
 void main() {
-    FragColor = texture(skybox, TexCoords);
+    // the coarser levels are blurred for rough lookups, the background is always the sharpest
+    vec3 color = textureLod(skybox, TexCoords, 0.0).rgb;
+    FragColor = vec4(exposure > 0.0 ? vec3(1.0) - exp(-color * exposure) : color, 1.0);
 }
+